@@ -0,0 +1,77 @@
+#version 450
+
+layout(local_size_x = 64) in;
+
+struct Object {
+    vec4 sphere;
+    uint mesh;
+    uint pad0;
+    uint pad1;
+    uint pad2;
+};
+
+struct Mesh {
+    uint indexCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint pad;
+};
+
+struct DrawCommand {
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Objects {
+    Object objects[];
+};
+layout(std430, set = 0, binding = 1) readonly buffer Meshes {
+    Mesh meshes[];
+};
+layout(std430, set = 0, binding = 2) writeonly buffer Draws {
+    DrawCommand draws[];
+};
+layout(std430, set = 0, binding = 3) buffer DrawCount {
+    uint drawCount;
+};
+
+layout(push_constant) uniform Cull {
+    vec4 planes[6];
+    uint objectCount;
+    uint compact;
+} cull;
+
+void main() {
+    uint id = gl_GlobalInvocationID.x;
+    if (id >= cull.objectCount) {
+        return;
+    }
+
+    Object obj = objects[id];
+    bool visible = true;
+    for (int i = 0; i < 6; i++) {
+        vec4 plane = cull.planes[i];
+        visible = visible && dot(plane.xyz, obj.sphere.xyz) + plane.w > -obj.sphere.w;
+    }
+
+    Mesh mesh = meshes[obj.mesh];
+    // objects of removed meshes point at an empty entry
+    visible = visible && mesh.indexCount != 0u;
+    DrawCommand cmd;
+    cmd.indexCount = mesh.indexCount;
+    cmd.instanceCount = visible ? 1u : 0u;
+    cmd.firstIndex = mesh.firstIndex;
+    cmd.vertexOffset = mesh.vertexOffset;
+    cmd.firstInstance = id;
+
+    if (cull.compact != 0u) {
+        if (visible) {
+            draws[atomicAdd(drawCount, 1u)] = cmd;
+        }
+    } else {
+        draws[id] = cmd;
+    }
+}
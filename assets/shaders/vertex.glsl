@@ -2,10 +2,17 @@
 
 layout(location = 0) in vec2 inPosition; 
 layout(location = 1) in vec3 inColor;
+// per instance, vertex binding 1
+layout(location = 2) in mat4 inModel;
+layout(location = 6) in vec4 inInstanceColor;
 
 layout(location = 0) out vec3 fragColor;
 
+layout(set = 0, binding = 0) uniform Camera {
+    mat4 viewProj;
+} camera;
+
 void main() {
-    gl_Position = vec4(inPosition, 0.0, 1.0);
-    fragColor = inColor;
+    gl_Position = camera.viewProj * inModel * vec4(inPosition, 0.0, 1.0);
+    fragColor = inColor * inInstanceColor.rgb;
 }
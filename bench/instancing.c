@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "vk/vk_engine.h"
+
+// Draws the same mesh N times, once as N single-instance draws and once as
+// one N-instance draw, and reports the average frame time of each.
+
+#define BENCH_WIDTH 1280
+#define BENCH_HEIGHT 720
+#define WARMUP_FRAMES 30
+#define MEASURE_FRAMES 300
+
+static const vertex TRIANGLE_VERTICES[3] = {
+	{ { 0.0f, -0.5f }, { 1.0f, 0.0f, 0.0f } },
+	{ { 0.5f, 0.5f }, { 0.0f, 1.0f, 0.0f } },
+	{ { -0.5f, 0.5f }, { 0.0f, 0.0f, 1.0f } },
+};
+static const Uint32 TRIANGLE_INDICES[3] = { 0, 1, 2 };
+
+static const Uint32 INSTANCE_COUNTS[] = { 100, 1000, 10000, 40000 };
+
+// a square grid covering clip space
+static void fill_grid(instance_data *instances, Uint32 count)
+{
+	Uint32 side = (Uint32)ceilf(sqrtf((float)count));
+	float cell = 2.0f / side;
+	for (Uint32 i = 0; i < count; i++) {
+		instance_data *instance = &instances[i];
+		glm_mat4_identity(instance->model);
+		instance->model[0][0] = cell;
+		instance->model[1][1] = cell;
+		instance->model[3][0] = -1.0f + cell * (i % side + 0.5f);
+		instance->model[3][1] = -1.0f + cell * (i / side + 0.5f);
+		instance->color[0] = (float)(i % side) / side;
+		instance->color[1] = (float)(i / side) / side;
+		instance->color[2] = 1.0f;
+		instance->color[3] = 1.0f;
+	}
+}
+
+// average milliseconds per frame
+static double run(vulkan_engine *engine, Uint32 mesh, instance_data *instances,
+		  Uint32 count, bool instanced)
+{
+	Uint64 start = 0;
+	for (int frame = 0; frame < WARMUP_FRAMES + MEASURE_FRAMES; frame++) {
+		if (frame == WARMUP_FRAMES) {
+			start = SDL_GetPerformanceCounter();
+		}
+		SDL_PumpEvents();
+		if (instanced) {
+			vulkan_engine_draw_mesh_instanced(engine, mesh, instances, count);
+		} else {
+			for (Uint32 i = 0; i < count; i++) {
+				vulkan_engine_draw_mesh_instanced(engine, mesh,
+								  &instances[i], 1);
+			}
+		}
+		vulkan_engine_draw_frame(engine);
+	}
+	vkDeviceWaitIdle(engine->log_dev);
+	Uint64 elapsed = SDL_GetPerformanceCounter() - start;
+
+	return (double)elapsed * 1000.0 / SDL_GetPerformanceFrequency() /
+	       MEASURE_FRAMES;
+}
+
+int main(int argc, char *argv[])
+{
+	SDL_Init(SDL_INIT_VIDEO);
+	SDL_Window *win = SDL_CreateWindow("Instancing bench", SDL_WINDOWPOS_UNDEFINED,
+					   SDL_WINDOWPOS_UNDEFINED, BENCH_WIDTH,
+					   BENCH_HEIGHT, SDL_WINDOW_VULKAN);
+
+	vulkan_engine engine;
+	vulkan_engine_init(&engine, win);
+
+	Uint32 triangle = vulkan_engine_add_mesh(&engine, TRIANGLE_VERTICES, 3,
+						 TRIANGLE_INDICES, 3);
+
+	printf("%10s %14s %14s %8s\n", "instances", "separate ms", "instanced ms",
+	       "speedup");
+	for (Uint32 i = 0; i < sizeof(INSTANCE_COUNTS) / sizeof(Uint32); i++) {
+		Uint32 count = INSTANCE_COUNTS[i];
+		instance_data *instances = malloc(sizeof(instance_data) * count);
+		fill_grid(instances, count);
+
+		double separate = run(&engine, triangle, instances, count, false);
+		double instanced = run(&engine, triangle, instances, count, true);
+		printf("%10u %14.3f %14.3f %7.1fx\n", count, separate, instanced,
+		       separate / instanced);
+
+		free(instances);
+	}
+
+	vulkan_engine_cleanup(&engine);
+	SDL_DestroyWindow(win);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,330 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "vk/vk_engine.h"
+
+// Renders fixed scenes headless for a set number of frames and prints one JSON
+// document with frame rate, CPU and GPU time per frame and peak memory, so runs
+// can be diffed across commits. Usage: bench [-frames N] [scene...]
+//
+// Each scene runs in its own process, so its peak memory is its own and not
+// the high-water mark of every scene before it.
+
+#define WARMUP_FRAMES 60
+#define MEASURE_FRAMES 600
+// pipelines compile in the background; give up waiting after this many frames
+#define MAX_COMPILE_FRAMES 2000
+
+typedef struct {
+	const char *name;
+	Uint32 triangles; // per mesh
+	Uint32 draws;
+	Uint32 instances; // per draw
+	Uint32 pipelines; // draws cycle through them, at most 12 distinct
+	Uint32 width;
+	Uint32 height;
+} bench_scene;
+
+// instances per frame stay within one frame ring slice
+static const bench_scene SCENES[] = {
+	{ "baseline", 1, 1, 1, 1, 1280, 720 },
+	{ "triangles", 200000, 1, 1, 1, 1280, 720 },
+	{ "draw_calls", 2, 10000, 1, 1, 1280, 720 },
+	{ "instances", 2, 1, 40000, 1, 1280, 720 },
+	{ "pipelines", 2, 4096, 1, 12, 1280, 720 },
+	{ "resolution", 2, 1000, 1, 1, 3840, 2160 },
+	{ "dense", 32, 4000, 10, 6, 1920, 1080 },
+};
+
+typedef struct {
+	double fps;
+	double frame_ms;
+	double cpu_ms; // draw_frame minus its wait for a free frame slot
+	double cpu_p95_ms;
+	double gpu_ms; // the profiler's "frame" scope
+	Uint32 gpu_samples;
+	VkDeviceSize peak_gpu_bytes;
+	VkDeviceSize frame_ring_bytes; // most of a frame ring slice used
+	long peak_rss_kb; // of the scene's process
+} bench_result;
+
+// tiny triangles on a grid over [-1, 1], no shared vertices
+static Uint32 add_grid_mesh(vulkan_engine *engine, Uint32 triangles)
+{
+	Uint32 side = (Uint32)ceilf(sqrtf((float)triangles));
+	float cell = 2.0f / side;
+	vertex *vertices = calloc(triangles * 3, sizeof(vertex));
+	Uint32 *indices = malloc(sizeof(Uint32) * triangles * 3);
+	for (Uint32 i = 0; i < triangles; i++) {
+		float x = -1.0f + cell * (i % side);
+		float y = -1.0f + cell * (i / side);
+		vertex *v = &vertices[i * 3];
+		v[0].pos[0] = x;
+		v[0].pos[1] = y;
+		v[1].pos[0] = x + cell;
+		v[1].pos[1] = y;
+		v[2].pos[0] = x;
+		v[2].pos[1] = y + cell;
+		for (Uint32 j = 0; j < 3; j++) {
+			v[j].color[j] = 1.0f;
+			indices[i * 3 + j] = i * 3 + j;
+		}
+	}
+
+	Uint32 mesh = vulkan_engine_add_mesh(engine, vertices, triangles * 3, indices,
+					     triangles * 3);
+	free(vertices);
+	free(indices);
+	return mesh;
+}
+
+// a square grid covering clip space
+static void fill_grid(instance_data *instances, Uint32 count)
+{
+	Uint32 side = (Uint32)ceilf(sqrtf((float)count));
+	float cell = 2.0f / side;
+	for (Uint32 i = 0; i < count; i++) {
+		instance_data *instance = &instances[i];
+		glm_mat4_identity(instance->model);
+		instance->model[0][0] = cell * 0.5f;
+		instance->model[1][1] = cell * 0.5f;
+		instance->model[3][0] = -1.0f + cell * (i % side + 0.5f);
+		instance->model[3][1] = -1.0f + cell * (i / side + 0.5f);
+		glm_vec4_one(instance->color);
+	}
+}
+
+// distinct fixed-function state per index, so each one is its own pipeline
+static void pipeline_variant(vulkan_engine *engine, Uint32 i, vk_pipeline_desc *rdesc)
+{
+	static const vk_blend_mode blends[] = { VK_BLEND_MODE_OPAQUE, VK_BLEND_MODE_ALPHA,
+						VK_BLEND_MODE_ADDITIVE };
+	vulkan_engine_default_pipeline_desc(engine, rdesc);
+	rdesc->blend = blends[i % 3];
+	rdesc->cull_mode = (i / 3) % 2 ? VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_NONE;
+	rdesc->front_face = (i / 6) % 2 ? VK_FRONT_FACE_COUNTER_CLOCKWISE
+					: VK_FRONT_FACE_CLOCKWISE;
+}
+
+static void queue_scene(vulkan_engine *engine, const bench_scene *scene, Uint32 mesh,
+			const vk_pipeline_desc *pipelines, const instance_data *instances)
+{
+	for (Uint32 i = 0; i < scene->draws; i++) {
+		if (scene->pipelines > 1) {
+			vulkan_engine_use_pipeline(engine, &pipelines[i % scene->pipelines]);
+		}
+		vulkan_engine_draw_mesh_instanced(engine, mesh, &instances[i * scene->instances],
+						  scene->instances);
+	}
+}
+
+static VkDeviceSize gpu_bytes_used(vulkan_engine *engine)
+{
+	vk_mem_stats stats;
+	vulkan_engine_get_mem_stats(engine, &stats);
+	VkDeviceSize used = 0;
+	for (Uint32 i = 0; i < stats.heap_count; i++) {
+		used += stats.heaps[i].used_bytes;
+	}
+	return used;
+}
+
+static void run_scene(const bench_scene *scene, Uint32 frames, bench_result *rresult)
+{
+	memset(rresult, 0, sizeof(bench_result));
+
+	vulkan_engine engine;
+	vulkan_engine_init_headless(&engine, scene->width, scene->height);
+
+	Uint32 mesh = add_grid_mesh(&engine, scene->triangles);
+	Uint32 pipeline_count = scene->pipelines > 12 ? 12 : scene->pipelines;
+	vk_pipeline_desc pipelines[12];
+	for (Uint32 i = 0; i < pipeline_count; i++) {
+		pipeline_variant(&engine, i, &pipelines[i]);
+	}
+	Uint32 instance_count = scene->draws * scene->instances;
+	instance_data *instances = malloc(sizeof(instance_data) * instance_count);
+	fill_grid(instances, instance_count);
+
+	// measure only once every variant is compiled, not the fallback
+	for (Uint32 frame = 0; frame < MAX_COMPILE_FRAMES; frame++) {
+		vk_pipeline_stats stats;
+		vulkan_engine_get_pipeline_stats(&engine, &stats);
+		if (frame >= WARMUP_FRAMES && stats.pending == 0) {
+			break;
+		}
+		queue_scene(&engine, scene, mesh, pipelines, instances);
+		vulkan_engine_draw_frame(&engine);
+	}
+	frame_stats_init(&engine.stats);
+
+	double gpu_total = 0.0;
+	Uint64 last_gpu_frame = engine.profiler.result_frame;
+	Uint64 start = SDL_GetPerformanceCounter();
+	for (Uint32 frame = 0; frame < frames; frame++) {
+		queue_scene(&engine, scene, mesh, pipelines, instances);
+		vulkan_engine_draw_frame(&engine);
+
+		VkDeviceSize used = gpu_bytes_used(&engine);
+		if (used > rresult->peak_gpu_bytes) {
+			rresult->peak_gpu_bytes = used;
+		}
+		const vk_profiler_result *timings;
+		Uint32 timing_count = vulkan_engine_get_gpu_timings(&engine, &timings);
+		if (engine.profiler.result_frame == last_gpu_frame) {
+			continue;
+		}
+		last_gpu_frame = engine.profiler.result_frame;
+		for (Uint32 i = 0; i < timing_count; i++) {
+			if (strcmp(timings[i].name, "frame") == 0) {
+				gpu_total += timings[i].ms;
+				rresult->gpu_samples++;
+			}
+		}
+	}
+	vkDeviceWaitIdle(engine.log_dev);
+	Uint64 elapsed = SDL_GetPerformanceCounter() - start;
+
+	vk_frame_ring_stats ring;
+	vulkan_engine_get_frame_ring_stats(&engine, &ring);
+	rresult->frame_ring_bytes = ring.high_water;
+
+	double total_ms = (double)elapsed * 1000.0 / SDL_GetPerformanceFrequency();
+	rresult->frame_ms = total_ms / frames;
+	rresult->fps = frames * 1000.0 / total_ms;
+	frame_stat_summary cpu;
+	frame_stat_summary wait;
+	vulkan_engine_get_frame_stats(&engine, FRAME_STAT_CPU, &cpu);
+	vulkan_engine_get_frame_stats(&engine, FRAME_STAT_WAIT, &wait);
+	rresult->cpu_ms = cpu.mean - wait.mean;
+	rresult->cpu_p95_ms = cpu.p95;
+	if (rresult->gpu_samples > 0) {
+		rresult->gpu_ms = gpu_total / rresult->gpu_samples;
+	}
+	free(instances);
+	vulkan_engine_cleanup(&engine);
+}
+
+static bool read_all(int fd, void *buf, size_t size)
+{
+	char *dst = buf;
+	while (size > 0) {
+		ssize_t got = read(fd, dst, size);
+		if (got <= 0) {
+			return false;
+		}
+		dst += got;
+		size -= (size_t)got;
+	}
+	return true;
+}
+
+// Runs the scene in a child and reads its result back through a pipe.
+static bool run_scene_process(const bench_scene *scene, Uint32 frames,
+			      bench_result *rresult)
+{
+	int fds[2];
+	if (pipe(fds) != 0) {
+		perror("bench: pipe");
+		return false;
+	}
+
+	pid_t pid = fork();
+	if (pid < 0) {
+		perror("bench: fork");
+		close(fds[0]);
+		close(fds[1]);
+		return false;
+	}
+	if (pid == 0) {
+		close(fds[0]);
+		SDL_Init(0);
+		run_scene(scene, frames, rresult);
+		SDL_Quit();
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		rresult->peak_rss_kb = usage.ru_maxrss;
+		bool written = write(fds[1], rresult, sizeof(bench_result)) ==
+			       (ssize_t)sizeof(bench_result);
+		close(fds[1]);
+		_exit(written ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	close(fds[1]);
+	bool ok = read_all(fds[0], rresult, sizeof(bench_result));
+	close(fds[0]);
+	int status;
+	waitpid(pid, &status, 0);
+	if (!ok || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+		fprintf(stderr, "bench: scene %s failed\n", scene->name);
+		return false;
+	}
+	return true;
+}
+
+static bool scene_selected(const bench_scene *scene, int argc, char *argv[], int first)
+{
+	if (first >= argc) {
+		return true;
+	}
+	for (int i = first; i < argc; i++) {
+		if (strcmp(argv[i], scene->name) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+int main(int argc, char *argv[])
+{
+	Uint32 frames = MEASURE_FRAMES;
+	int first = 1;
+	if (argc > 2 && strcmp(argv[1], "-frames") == 0) {
+		frames = (Uint32)atoi(argv[2]);
+		first = 3;
+	}
+	if (frames == 0) {
+		fprintf(stderr, "Error: -frames needs a positive count\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("{\"frames\":%u,\"scenes\":[", frames);
+	// the children inherit stdout, nothing may sit in its buffer
+	fflush(stdout);
+	bool first_scene = true;
+	bool failed = false;
+	for (Uint32 i = 0; i < sizeof(SCENES) / sizeof(bench_scene); i++) {
+		const bench_scene *scene = &SCENES[i];
+		if (!scene_selected(scene, argc, argv, first)) {
+			continue;
+		}
+		fprintf(stderr, "bench: %s\n", scene->name);
+
+		bench_result result;
+		if (!run_scene_process(scene, frames, &result)) {
+			failed = true;
+			continue;
+		}
+		printf("%s\n{\"name\":\"%s\",\"triangles\":%u,\"draws\":%u,"
+		       "\"instances\":%u,\"pipelines\":%u,\"width\":%u,\"height\":%u,"
+		       "\"fps\":%.2f,\"frame_ms\":%.4f,\"cpu_ms\":%.4f,"
+		       "\"cpu_p95_ms\":%.4f,\"gpu_ms\":%.4f,\"gpu_samples\":%u,"
+		       "\"peak_gpu_bytes\":%llu,\"frame_ring_bytes\":%llu,"
+		       "\"peak_rss_kb\":%ld}",
+		       first_scene ? "" : ",", scene->name, scene->triangles, scene->draws,
+		       scene->instances, scene->pipelines, scene->width, scene->height,
+		       result.fps, result.frame_ms, result.cpu_ms, result.cpu_p95_ms,
+		       result.gpu_ms, result.gpu_samples,
+		       (unsigned long long)result.peak_gpu_bytes,
+		       (unsigned long long)result.frame_ring_bytes, result.peak_rss_kb);
+		fflush(stdout);
+		first_scene = false;
+	}
+	printf("\n]}\n");
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
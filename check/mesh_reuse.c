@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vk/vk_engine.h"
+
+// Removes a mesh that GPU culled objects still point at, lets its release go
+// through, then adds a mesh that takes over its id and ranges. The culling
+// pass's indirect commands are read back: the removed mesh's objects must
+// draw nothing, and every other object must draw its own mesh's ranges, the
+// reused ones included. Exits non-zero on failure.
+
+#define CHECK_WIDTH 320
+#define CHECK_HEIGHT 240
+#define OLD_OBJECTS 64
+#define KEEP_OBJECTS 16
+#define NEW_OBJECTS 32
+
+static const vertex QUAD_VERTICES[4] = {
+	{ { -0.5f, -0.5f }, { 1.0f, 0.0f, 0.0f } },
+	{ { 0.5f, -0.5f }, { 0.0f, 1.0f, 0.0f } },
+	{ { 0.5f, 0.5f }, { 0.0f, 0.0f, 1.0f } },
+	{ { -0.5f, 0.5f }, { 1.0f, 1.0f, 1.0f } },
+};
+static const Uint32 QUAD_INDICES[6] = { 0, 1, 2, 2, 3, 0 };
+static const Uint32 TRIANGLE_INDICES[3] = { 0, 1, 2 };
+
+static void draw_frames(vulkan_engine *engine, Uint32 frames)
+{
+	for (Uint32 i = 0; i < frames; i++) {
+		vulkan_engine_draw_frame(engine);
+	}
+}
+
+static bool check(bool ok, const char *what)
+{
+	if (!ok) {
+		fprintf(stderr, "mesh_reuse: %s\n", what);
+	}
+	return ok;
+}
+
+static void add_objects(vulkan_engine *engine, Uint32 mesh, Uint32 count)
+{
+	// at the origin, inside the identity camera's frustum
+	instance_data instance;
+	glm_mat4_identity(instance.model);
+	glm_vec4_one(instance.color);
+	for (Uint32 i = 0; i < count; i++) {
+		vulkan_engine_add_object(engine, mesh, &instance, 1.0f);
+	}
+}
+
+// Copies `size` bytes of a device local buffer to `dst`. The device is idle.
+static bool read_buffer(vulkan_engine *engine, VkBuffer src, VkDeviceSize size, void *dst)
+{
+	VkBufferCreateInfo buf_info;
+	memset(&buf_info, 0, sizeof(VkBufferCreateInfo));
+	buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buf_info.size = size;
+	buf_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VkBuffer readback;
+	vk_mem_allocation alloc;
+	if (vk_mem_create_buffer(&engine->allocator, &buf_info,
+				 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+					 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				 0, &readback, &alloc) != VK_SUCCESS) {
+		return false;
+	}
+
+	VkCommandBufferAllocateInfo cmd_info;
+	memset(&cmd_info, 0, sizeof(VkCommandBufferAllocateInfo));
+	cmd_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	cmd_info.commandPool = engine->command_pool;
+	cmd_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	cmd_info.commandBufferCount = 1;
+	VkCommandBuffer cmd;
+	vkAllocateCommandBuffers(engine->log_dev, &cmd_info, &cmd);
+
+	VkCommandBufferBeginInfo begin_info;
+	memset(&begin_info, 0, sizeof(VkCommandBufferBeginInfo));
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(cmd, &begin_info);
+
+	VkMemoryBarrier barrier;
+	memset(&barrier, 0, sizeof(VkMemoryBarrier));
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			     VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, NULL, 0,
+			     NULL);
+	VkBufferCopy region = { .srcOffset = 0, .dstOffset = 0, .size = size };
+	vkCmdCopyBuffer(cmd, src, readback, 1, &region);
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			     VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, NULL, 0, NULL);
+	vkEndCommandBuffer(cmd);
+
+	VkSubmitInfo submit_info;
+	memset(&submit_info, 0, sizeof(VkSubmitInfo));
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &cmd;
+	bool ok = vkQueueSubmit(engine->graphics_queue, 1, &submit_info, VK_NULL_HANDLE) ==
+		  VK_SUCCESS;
+	vkQueueWaitIdle(engine->graphics_queue);
+	if (ok) {
+		memcpy(dst, alloc.mapped, size);
+	}
+
+	vkFreeCommandBuffers(engine->log_dev, engine->command_pool, 1, &cmd);
+	vk_mem_destroy_buffer(&engine->allocator, readback, &alloc);
+	return ok;
+}
+
+static bool draws_mesh(const VkDrawIndexedIndirectCommand *draw, const vk_mesh *mesh)
+{
+	return draw->instanceCount == 1 && draw->indexCount == mesh->index_count &&
+	       draw->firstIndex == mesh->first_index &&
+	       draw->vertexOffset == mesh->vertex_offset;
+}
+
+// Each object must have exactly one visible command drawing `expected` for
+// it, or none at all where `expected` is NULL.
+static bool check_draws(vulkan_engine *engine, Uint32 first_object,
+			const vk_mesh *old_mesh, const vk_mesh *keep_mesh,
+			const vk_mesh *new_mesh)
+{
+	vk_cull *cull = &engine->cull;
+	Uint32 count = cull->object_count;
+	if (cull->draw_indirect_count &&
+	    !read_buffer(engine, cull->count_buffer, sizeof(Uint32), &count)) {
+		return check(false, "could not read the draw count back");
+	}
+	if (!check(count <= cull->object_count, "more draws than objects")) {
+		return false;
+	}
+
+	VkDrawIndexedIndirectCommand *draws =
+		malloc(sizeof(VkDrawIndexedIndirectCommand) * (count ? count : 1));
+	Uint32 *seen = calloc(cull->object_count, sizeof(Uint32));
+	bool ok = count == 0 ||
+		  read_buffer(engine, cull->draw_buffer,
+			      sizeof(VkDrawIndexedIndirectCommand) * count, draws);
+	ok = check(ok, "could not read the indirect draws back");
+
+	Uint32 keep_first = first_object + OLD_OBJECTS;
+	Uint32 new_first = keep_first + KEEP_OBJECTS;
+	for (Uint32 i = 0; i < count && ok; i++) {
+		VkDrawIndexedIndirectCommand *draw = &draws[i];
+		Uint32 object = draw->firstInstance;
+		if (draw->instanceCount == 0 || object < first_object) {
+			continue;
+		}
+		if (!check(object < cull->object_count, "a draw past the objects")) {
+			ok = false;
+			break;
+		}
+		seen[object]++;
+		if (object < keep_first) {
+			ok = check(false, draws_mesh(draw, old_mesh)
+						  ? "a removed mesh's object draws the reused ranges"
+						  : "a removed mesh's object is still drawn");
+		} else if (object < new_first) {
+			ok = check(draws_mesh(draw, keep_mesh),
+				   "a kept object draws the wrong ranges");
+		} else {
+			ok = check(draws_mesh(draw, new_mesh),
+				   "an object of the reused mesh draws the wrong ranges");
+		}
+	}
+	for (Uint32 i = keep_first; i < cull->object_count && ok; i++) {
+		ok = check(seen[i] == 1, "a visible object has no single draw");
+	}
+
+	free(seen);
+	free(draws);
+	return ok;
+}
+
+int main(void)
+{
+	SDL_Init(0);
+	vulkan_engine engine;
+	vulkan_engine_init_headless(&engine, CHECK_WIDTH, CHECK_HEIGHT);
+	if (!engine.multi_draw_indirect) {
+		vulkan_engine_cleanup(&engine);
+		SDL_Quit();
+		printf("mesh_reuse: skipped, no multiDrawIndirect\n");
+		return EXIT_SUCCESS;
+	}
+	mat4 identity;
+	glm_mat4_identity(identity);
+	vulkan_engine_set_camera(&engine, identity);
+
+	Uint32 old_id = vulkan_engine_add_mesh(&engine, QUAD_VERTICES, 4, QUAD_INDICES, 6);
+	vk_mesh old_mesh = *vk_mesh_pool_get(&engine.meshes, old_id);
+	// allocated after the old mesh so its ranges are not the freed ones
+	Uint32 keep_id =
+		vulkan_engine_add_mesh(&engine, QUAD_VERTICES, 3, TRIANGLE_INDICES, 3);
+	vk_mesh keep_mesh = *vk_mesh_pool_get(&engine.meshes, keep_id);
+
+	Uint32 first_object = engine.cull.object_count;
+	add_objects(&engine, old_id, OLD_OBJECTS);
+	add_objects(&engine, keep_id, KEEP_OBJECTS);
+	draw_frames(&engine, 4);
+
+	vulkan_engine_remove_mesh(&engine, old_id);
+	// every frame that could still draw it has retired
+	draw_frames(&engine, MAX_FRAMES_IN_FLIGHT + 2);
+
+	Uint32 new_id = vulkan_engine_add_mesh(&engine, QUAD_VERTICES, 4, QUAD_INDICES, 6);
+	vk_mesh *new_ranges = vk_mesh_pool_get(&engine.meshes, new_id);
+	bool ok = check(new_ranges != NULL, "the new mesh was not added");
+	vk_mesh new_mesh;
+	memset(&new_mesh, 0, sizeof(vk_mesh));
+	if (ok) {
+		new_mesh = *new_ranges;
+		ok = check(new_id == old_id, "the removed id was not reused");
+		ok = check(new_mesh.first_index == old_mesh.first_index &&
+				   new_mesh.vertex_offset == old_mesh.vertex_offset,
+			   "the freed ranges were not reused") &&
+		     ok;
+		add_objects(&engine, new_id, NEW_OBJECTS);
+		draw_frames(&engine, 4);
+	}
+
+	vkDeviceWaitIdle(engine.log_dev);
+	if (ok) {
+		ok = check_draws(&engine, first_object, &old_mesh, &keep_mesh, &new_mesh);
+	}
+
+	vulkan_engine_cleanup(&engine);
+	SDL_Quit();
+	printf("mesh_reuse: %s\n", ok ? "ok" : "FAILED");
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
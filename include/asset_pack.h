@@ -0,0 +1,60 @@
+#ifndef _ASSET_PACK_H_
+#define _ASSET_PACK_H_
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+#include "file.h"
+
+// Read-only archive mapped once with mmap. Layout:
+//   asset_pack_header
+//   blobs, each starting on ASSET_PACK_ALIGN
+//   asset_pack_entry[entry_count], sorted by path hash
+// Lookups are a binary search and return views into the mapping, so data
+// goes to vkCreateShaderModule or the staging ring without a copy.
+#define ASSET_PACK_MAGIC 0x4b434150 // "PACK"
+#define ASSET_PACK_VERSION 1
+#define ASSET_PACK_ALIGN 64
+
+typedef enum {
+	ASSET_TYPE_RAW,
+	ASSET_TYPE_SPIRV,
+	ASSET_TYPE_MESH,
+	ASSET_TYPE_TEXTURE,
+} asset_type;
+
+typedef struct {
+	Uint32 magic;
+	Uint32 version;
+	Uint32 entry_count;
+	Uint32 pad;
+	Uint64 toc_offset;
+	Uint64 file_size;
+} asset_pack_header;
+
+typedef struct {
+	Uint64 hash; // asset_pack_hash of the path
+	Uint64 offset;
+	Uint64 size;
+	Uint32 type; // asset_type
+	Uint32 pad;
+} asset_pack_entry;
+
+typedef struct {
+	Uint8 *base;
+	Uint64 size;
+	const asset_pack_header *header;
+	const asset_pack_entry *entries;
+} asset_pack;
+
+Uint64 asset_pack_hash(const char *path);
+
+// Returns false and leaves the pack empty when the file is missing or
+// malformed; lookups then fall back to the filesystem.
+bool asset_pack_open(asset_pack *self, const char *path);
+void asset_pack_close(asset_pack *self);
+const asset_pack_entry *asset_pack_find(const asset_pack *self, const char *path);
+
+// A view into the pack when `path` is packed, otherwise read_file. Release
+// with loaded_file_destroy either way. `self` may be NULL.
+loaded_file asset_pack_load(const asset_pack *self, const char *path);
+
+#endif // !_ASSET_PACK_H_
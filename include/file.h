@@ -1,10 +1,12 @@
 #ifndef _FILE_H_
 #define _FILE_H_
+#include <stdbool.h>
 #include <SDL2/SDL.h>
 
 typedef struct {
 	Uint64 size;
-	char *buf;
+	char *buf; // NULL when the read failed
+	bool mapped; // points into an asset pack, not owned
 } loaded_file;
 
 loaded_file read_file(const char *file_name);
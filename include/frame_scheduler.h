@@ -0,0 +1,54 @@
+#ifndef _FRAME_SCHEDULER_H_
+#define _FRAME_SCHEDULER_H_
+#include <stdbool.h>
+#include <stdio.h>
+#include <SDL2/SDL.h>
+
+// Decides when the render loop draws and blocks on its wake semaphore in
+// between, so an idle or minimized window costs no CPU. Time spent blocked is
+// counted as idle, time spent spinning for a precise deadline is counted apart.
+typedef enum {
+	FRAME_SCHED_UNCAPPED, // draw as fast as possible, never block
+	FRAME_SCHED_FIXED, // draw at a fixed rate: sleep, then spin the last stretch
+	FRAME_SCHED_EVENT, // draw only after an event or a redraw request
+} frame_sched_mode;
+
+typedef struct {
+	Uint64 frames;
+	double wall_ms;
+	double idle_ms; // blocked waiting for events
+	double spin_ms; // busy waiting for the next deadline
+} frame_sched_stats;
+
+typedef struct {
+	frame_sched_mode mode;
+	Uint64 freq;
+	Uint64 period; // counter ticks per frame in fixed mode
+	Uint64 spin; // ticks before a deadline that are spun instead of slept
+	Uint64 deadline; // of the next frame in fixed mode
+	bool redraw; // event mode: draw at the next chance
+	Uint64 start;
+	Uint64 frames;
+	Uint64 idle;
+	Uint64 spinning;
+} frame_scheduler;
+
+// `fps` is only used by FRAME_SCHED_FIXED.
+void frame_scheduler_init(frame_scheduler *self, frame_sched_mode mode, double fps);
+void frame_scheduler_set_mode(frame_scheduler *self, frame_sched_mode mode, double fps);
+// Parses "uncapped", "event" or a frame rate, as given in an environment variable.
+bool frame_scheduler_parse(const char *str, frame_sched_mode *rmode, double *rfps);
+
+// Returns true once `wake` is posted, e.g. after pushing the render thread
+// commands, blocking for as long as nothing needs to be drawn, or false when
+// it is time to draw. While `can_draw` is false, e.g. minimized, it only
+// returns with a wake up. Each post is one wake up and requests a redraw.
+bool frame_scheduler_next_wake(frame_scheduler *self, SDL_sem *wake, bool can_draw);
+// For animations and scene changes that arrive without an event.
+void frame_scheduler_request_redraw(frame_scheduler *self);
+void frame_scheduler_frame_done(frame_scheduler *self);
+
+void frame_scheduler_get_stats(frame_scheduler *self, frame_sched_stats *rstats);
+void frame_scheduler_write(frame_scheduler *self, FILE *file);
+
+#endif // !_FRAME_SCHEDULER_H_
@@ -0,0 +1,63 @@
+#ifndef _FRAME_STATS_H_
+#define _FRAME_STATS_H_
+#include <stdbool.h>
+#include <stdio.h>
+#include <SDL2/SDL.h>
+
+// Rolling CPU timings of the last FRAME_STATS_WINDOW frames per stage, with
+// percentiles computed on demand and an optional periodic dump as JSON lines.
+#define FRAME_STATS_WINDOW 1024
+
+typedef enum {
+	FRAME_STAT_WAIT, // frame timeline wait for a free slot
+	// profiler readback, deferred deletions, captures and shader reloads
+	FRAME_STAT_HOUSEKEEPING,
+	FRAME_STAT_ACQUIRE, // vkAcquireNextImageKHR alone
+	FRAME_STAT_RECORD,
+	FRAME_STAT_SUBMIT,
+	FRAME_STAT_PRESENT,
+	FRAME_STAT_CPU, // all of draw_frame
+	FRAME_STAT_FRAME, // start to start of consecutive frames
+	FRAME_STAT_COUNT,
+} frame_stat;
+
+typedef struct {
+	double p50;
+	double p95;
+	double p99;
+	double max;
+	double mean;
+	Uint32 samples;
+} frame_stat_summary;
+
+typedef struct {
+	float ms[FRAME_STATS_WINDOW]; // ring
+	Uint32 next;
+	Uint32 count;
+} frame_stat_window;
+
+typedef struct {
+	frame_stat_window windows[FRAME_STAT_COUNT];
+	Uint64 frames;
+	FILE *dump;
+	bool dump_owned; // opened by us, stdout otherwise
+	double dump_interval_ms;
+	double last_dump_ms;
+} frame_stats;
+
+void frame_stats_init(frame_stats *self);
+void frame_stats_destroy(frame_stats *self);
+
+const char *frame_stat_name(frame_stat stat);
+void frame_stats_add(frame_stats *self, frame_stat stat, double ms);
+void frame_stats_summary(frame_stats *self, frame_stat stat,
+			 frame_stat_summary *rsummary);
+
+// Append a line every `interval_ms` to `path`, or stdout when NULL. An
+// interval of 0 stops dumping.
+bool frame_stats_dump_to(frame_stats *self, const char *path, double interval_ms);
+// Call once per frame; dumps when the interval has passed.
+void frame_stats_end_frame(frame_stats *self, double now_ms);
+void frame_stats_write(frame_stats *self, FILE *file);
+
+#endif // !_FRAME_STATS_H_
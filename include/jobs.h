@@ -0,0 +1,51 @@
+#ifndef _JOBS_H_
+#define _JOBS_H_
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+
+// Fixed pool of worker threads draining one FIFO of jobs. Jobs must not
+// touch per-frame engine state; they hand results back through their data.
+typedef void (*job_fn)(void *data);
+
+// Counts the unfinished jobs of one batch, so a caller can wait for its own
+// jobs without waiting for everything else in the queue.
+typedef struct {
+	Uint32 pending;
+} job_group;
+
+typedef struct {
+	job_fn fn;
+	void *data;
+	job_group *group;
+} job;
+
+typedef struct {
+	SDL_Thread **threads;
+	Uint32 thread_count;
+	SDL_mutex *lock;
+	SDL_cond *has_work;
+	SDL_cond *idle;
+	SDL_cond *group_done;
+	job *queue; // ring buffer
+	Uint32 head;
+	Uint32 count;
+	Uint32 cap;
+	Uint32 active; // jobs currently running
+	bool quit;
+} job_system;
+
+// 0 threads uses one per core minus the main thread.
+void job_system_init(job_system *self, Uint32 thread_count);
+// Runs whatever is still queued, then joins the workers.
+void job_system_destroy(job_system *self);
+void job_system_push(job_system *self, job_fn fn, void *data);
+// Blocks until the queue is empty and no job is running.
+void job_system_wait(job_system *self);
+// Group jobs go to the front of the queue since someone is blocked on them.
+// `group` must be zeroed before the first push of a batch.
+void job_system_push_group(job_system *self, job_group *group, job_fn fn, void *data);
+// Runs the group's jobs no worker has started on the calling thread, then
+// waits for the rest, so it never waits behind unrelated long jobs.
+void job_system_wait_group(job_system *self, job_group *group);
+
+#endif // !_JOBS_H_
@@ -0,0 +1,12 @@
+#ifndef _RADIX_SORT_H_
+#define _RADIX_SORT_H_
+#include <SDL2/SDL.h>
+
+// Stable LSD radix sort of 64-bit keys carrying a 32-bit payload, one byte
+// per pass. Passes where every key has the same byte are skipped, so keys
+// that only use a few bits cost only a few passes. The tmp arrays must hold
+// `count` entries; the result ends up in `keys` and `values`.
+void radix_sort_u64(Uint64 *keys, Uint32 *values, Uint64 *tmp_keys,
+		    Uint32 *tmp_values, Uint32 count);
+
+#endif // !_RADIX_SORT_H_
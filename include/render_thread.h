@@ -0,0 +1,57 @@
+#ifndef _RENDER_THREAD_H_
+#define _RENDER_THREAD_H_
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+#include "vk/vk_engine.h"
+#include "frame_scheduler.h"
+#include "spsc_queue.h"
+
+// Runs vulkan_engine_draw_frame on its own thread so a slow acquire or
+// present never holds up the SDL event loop, and the reverse. Once started the
+// thread owns the engine: the event thread only talks to it through commands
+// on a lock-free queue, and a semaphore wakes it up when it is idle.
+#define RENDER_QUEUE_SIZE 256
+
+typedef enum {
+	RENDER_CMD_RESIZE,
+	RENDER_CMD_MINIMIZED,
+	RENDER_CMD_RESTORED,
+	RENDER_CMD_INPUT, // an input or expose event, forces a redraw
+	RENDER_CMD_CALL, // runs `call.fn` on the render thread, for scene updates
+	RENDER_CMD_QUIT,
+} render_cmd_type;
+
+typedef void (*render_call_fn)(vulkan_engine *engine, void *data);
+
+typedef struct {
+	render_cmd_type type;
+	union {
+		SDL_Event event;
+		struct {
+			render_call_fn fn;
+			void *data;
+		} call;
+	};
+} render_cmd;
+
+typedef struct {
+	vulkan_engine *engine;
+	frame_scheduler sched;
+	spsc_queue commands;
+	SDL_sem *wake;
+	SDL_Thread *thread;
+	// render thread only
+	bool minimized;
+	bool quit;
+} render_thread;
+
+void render_thread_start(render_thread *self, vulkan_engine *engine,
+			 frame_sched_mode mode, double fps);
+// Sends QUIT and joins; the engine belongs to the caller again afterwards.
+void render_thread_stop(render_thread *self);
+// From one thread only. Waits only while the queue is full.
+void render_thread_send(render_thread *self, const render_cmd *cmd);
+// Translates window and input events; returns false for events it ignores.
+bool render_thread_send_event(render_thread *self, const SDL_Event *event);
+
+#endif // !_RENDER_THREAD_H_
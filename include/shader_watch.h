@@ -0,0 +1,47 @@
+#ifndef _SHADER_WATCH_H_
+#define _SHADER_WATCH_H_
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+#include "jobs.h"
+
+// Watches a shader source directory with inotify and recompiles changed
+// sources with glslc on the job system. Outputs are written beside the
+// target and renamed over it, so readers never see a partial SPIR-V file.
+typedef struct {
+	const char *source; // file name inside the watched directory
+	const char *stage; // glslc -fshader-stage value
+	const char *output; // SPIR-V path
+} shader_source;
+
+struct shader_watch;
+
+typedef struct {
+	struct shader_watch *owner;
+	const shader_source *source;
+	bool busy; // a compile job is queued or running
+	bool again; // changed while busy
+} shader_compile;
+
+typedef struct shader_watch {
+	int fd;
+	const char *dir;
+	job_system *jobs;
+	shader_compile *compiles; // one per source
+	Uint32 source_count;
+	SDL_mutex *lock;
+	const shader_source **done; // compiled since the last poll
+	Uint32 done_count;
+} shader_watch;
+
+// Returns false when watching is unavailable; the watch is then inert.
+bool shader_watch_init(shader_watch *self, const char *dir,
+		       const shader_source *sources, Uint32 source_count,
+		       job_system *jobs);
+// Expects the job system to be drained.
+void shader_watch_destroy(shader_watch *self);
+// Non-blocking. Queues recompiles for changed sources and returns up to
+// `max` sources whose output has been rebuilt since the last call.
+Uint32 shader_watch_poll(shader_watch *self, const shader_source **rchanged,
+			 Uint32 max);
+
+#endif // !_SHADER_WATCH_H_
@@ -0,0 +1,32 @@
+#ifndef _SPSC_QUEUE_H_
+#define _SPSC_QUEUE_H_
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+
+// Bounded lock-free queue of fixed-size items between exactly one producer
+// thread and one consumer thread. Neither side ever blocks: push fails when
+// full and pop when empty, so waiting is up to the caller.
+#define SPSC_CACHE_LINE 64
+
+typedef struct {
+	// written by the consumer, on its own cache line
+	SDL_atomic_t tail;
+	char pad0[SPSC_CACHE_LINE - sizeof(SDL_atomic_t)];
+	// written by the producer
+	SDL_atomic_t head;
+	char pad1[SPSC_CACHE_LINE - sizeof(SDL_atomic_t)];
+	Uint32 mask;
+	Uint32 item_size;
+	Uint8 *items;
+} spsc_queue;
+
+// `capacity` is rounded up to a power of two; one slot always stays empty.
+void spsc_queue_init(spsc_queue *self, Uint32 item_size, Uint32 capacity);
+void spsc_queue_destroy(spsc_queue *self);
+
+// producer side
+bool spsc_queue_push(spsc_queue *self, const void *item);
+// consumer side
+bool spsc_queue_pop(spsc_queue *self, void *ritem);
+
+#endif // !_SPSC_QUEUE_H_
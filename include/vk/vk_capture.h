@@ -0,0 +1,102 @@
+#ifndef _VK_CAPTURE_H_
+#define _VK_CAPTURE_H_
+
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+#include "vk/vk_types.h"
+#include "vk/vk_mem.h"
+#include "jobs.h"
+
+// Frames are copied into a ring of host-visible buffers by a small command
+// buffer submitted right after the frame's own. A slot is handed to the
+// encoder thread once the frame timeline passes its frame, and becomes free
+// again when the PNG is written, so capturing never waits on the GPU or the
+// encoder. With every slot busy the frame is dropped, not waited for.
+#define VK_CAPTURE_SLOTS 8
+#define VK_CAPTURE_PATH_LEN 256
+
+// Runs on the encoder thread. `pixels` is tightly packed RGBA8, only valid
+// for the duration of the call.
+typedef void (*vk_capture_fn)(void *user, Uint64 frame, const Uint8 *pixels,
+			      Uint32 width, Uint32 height);
+
+typedef enum {
+	VK_CAPTURE_FREE,
+	VK_CAPTURE_IN_FLIGHT, // copy submitted, frame not complete yet
+	VK_CAPTURE_ENCODING, // owned by the encoder thread
+} vk_capture_state;
+
+struct vk_capture;
+
+typedef struct {
+	struct vk_capture *owner;
+	VkBuffer buffer;
+	vk_mem_allocation alloc;
+	VkDeviceSize size;
+	Uint32 width;
+	Uint32 height;
+	bool bgra; // swapchains are usually BGRA, swizzled on the encoder
+	Uint64 frame;
+	char path[VK_CAPTURE_PATH_LEN]; // empty: callback only
+	SDL_atomic_t state;
+} vk_capture_slot;
+
+typedef struct {
+	Uint64 requested;
+	Uint64 dropped; // every slot was busy
+	Uint64 written;
+	Uint64 failed;
+} vk_capture_stats;
+
+typedef struct vk_capture {
+	VkDevice log_dev;
+	vk_mem_allocator *allocator;
+	job_system encoder;
+	VkCommandPool command_pool;
+	VkCommandBuffer *cmds; // per frame slot
+	vk_capture_slot slots[VK_CAPTURE_SLOTS];
+	Uint32 next_slot;
+	// one-shot request for the next frame
+	bool requested;
+	char request_path[VK_CAPTURE_PATH_LEN];
+	// every frame while set; the caller's pattern rebuilt with a single
+	// %llu, so it is safe to format with
+	char sequence[VK_CAPTURE_PATH_LEN];
+	vk_capture_fn fn;
+	void *user;
+	Uint64 requests;
+	Uint64 dropped;
+	SDL_atomic_t written;
+	SDL_atomic_t failed;
+} vk_capture;
+
+void vk_capture_init(vk_capture *self, vk_mem_allocator *allocator, VkDevice log_dev,
+		     Uint32 queue_family, Uint32 frame_slots);
+// Waits for the encoder; call after the device is idle and vk_capture_poll.
+void vk_capture_destroy(vk_capture *self);
+
+// Capture the next frame into `path`, or NULL to only call the callback.
+void vk_capture_request(vk_capture *self, const char *path);
+// Capture every frame until called with NULL, e.g. "frames/%06llu.png". The
+// pattern takes exactly one integer conversion, with an optional zero flag
+// and width, and %% for a literal percent. Returns false and leaves the
+// sequence off for anything else.
+bool vk_capture_sequence(vk_capture *self, const char *pattern);
+void vk_capture_set_callback(vk_capture *self, vk_capture_fn fn, void *user);
+
+// Returns the command buffer to submit after the frame, or VK_NULL_HANDLE
+// when nothing is captured. `layout` is the image's layout after the frame
+// and is restored after the copy.
+VkCommandBuffer vk_capture_record(vk_capture *self, Uint32 frame_slot, VkImage image,
+				  VkFormat format, VkExtent2D extent,
+				  VkImageLayout layout, Uint64 frame);
+// Hands finished copies to the encoder; never blocks.
+void vk_capture_poll(vk_capture *self, Uint64 frames_completed);
+// The copy recorded for `frame` was never submitted: frees its slot and
+// counts it as failed.
+void vk_capture_cancel(vk_capture *self, Uint64 frame);
+// Copies in flight or being encoded.
+Uint32 vk_capture_pending(vk_capture *self);
+void vk_capture_get_stats(vk_capture *self, vk_capture_stats *rstats);
+
+#endif // !_VK_CAPTURE_H_
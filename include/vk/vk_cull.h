@@ -0,0 +1,113 @@
+#ifndef _VK_CULL_H_
+#define _VK_CULL_H_
+
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+#include "vk/vk_types.h"
+#include "vk/vk_mem.h"
+#include "vk/vk_upload.h"
+#include "vk/vk_mesh.h"
+#include "vk/vk_pipelines.h"
+#include "asset_pack.h"
+#include "jobs.h"
+#include <cglm/cglm.h>
+
+// GPU driven drawing: objects live in a storage buffer, a compute pass culls
+// them against the frustum and writes one VkDrawIndexedIndirectCommand per
+// visible object, and a single indirect draw consumes the result. The CPU
+// cost per frame does not depend on the object count.
+#define VK_CULL_MAX_OBJECTS (1024 * 1024)
+#define VK_CULL_MAX_MESHES 65536
+// an empty table entry past the real ones, for objects whose mesh is gone
+#define VK_CULL_NULL_MESH VK_CULL_MAX_MESHES
+#define VK_CULL_GROUP_SIZE 64
+
+// std430 layouts of the buffers read by build/cull.spv
+typedef struct {
+	vec4 sphere; // xyz center, w radius
+	Uint32 mesh;
+	Uint32 pad[3];
+} gpu_object;
+
+typedef struct {
+	Uint32 index_count;
+	Uint32 first_index;
+	Sint32 vertex_offset;
+	Uint32 pad;
+} gpu_mesh;
+
+typedef struct {
+	vec4 planes[6];
+	Uint32 object_count;
+	Uint32 compact;
+} gpu_cull_constants;
+
+typedef struct {
+	VkDevice log_dev;
+	vk_mem_allocator *allocator;
+	// with drawIndirectCount the shader compacts visible draws and the
+	// count buffer drives the draw, otherwise every object keeps its slot
+	// and culled ones get instanceCount = 0
+	bool draw_indirect_count;
+	VkBuffer object_buffer;
+	vk_mem_allocation object_alloc;
+	VkBuffer mesh_buffer;
+	vk_mem_allocation mesh_alloc;
+	VkBuffer draw_buffer;
+	vk_mem_allocation draw_alloc;
+	VkBuffer count_buffer;
+	vk_mem_allocation count_alloc;
+	// per-object vertex binding 1 data, fetched through firstInstance
+	Uint32 instance_stride;
+	VkBuffer instance_buffer;
+	vk_mem_allocation instance_alloc;
+	VkDescriptorSetLayout set_layout;
+	VkDescriptorPool descriptor_pool;
+	VkDescriptorSet descriptor_set;
+	VkPipelineCache pipeline_cache;
+	VkPipelineLayout pipeline_layout;
+	VkPipeline pipeline;
+	// shader reloads compile on the job system next to the live pipeline
+	job_system *jobs;
+	VkPipeline next_pipeline;
+	SDL_atomic_t reload; // vk_pipeline_reload
+	bool reload_again; // the source changed again while compiling
+	Uint32 object_count;
+	// mesh of each object, to find the ones a removed mesh leaves behind
+	Uint32 *object_meshes;
+	Uint32 object_cap;
+} vk_cull;
+
+void vk_cull_init(vk_cull *self, vk_mem_allocator *allocator, VkDevice log_dev,
+		  VkPipelineCache pipeline_cache, const asset_pack *assets,
+		  Uint32 instance_stride, bool draw_indirect_count);
+void vk_cull_destroy(vk_cull *self);
+// Rebuild the compute pipeline from build/cull.spv on `jobs`. The live
+// pipeline keeps culling until vk_cull_update swaps the new one in.
+void vk_cull_reload(vk_cull *self, job_system *jobs);
+// Call at a frame boundary. Returns the replaced pipeline, which in-flight
+// frames may still use, or VK_NULL_HANDLE when nothing was swapped.
+VkPipeline vk_cull_update(vk_cull *self);
+
+// Mirror a mesh pool entry so culled draws can reference it by id.
+void vk_cull_set_mesh(vk_cull *self, vk_upload_ring *upload, Uint32 id,
+		      const vk_mesh *mesh);
+// Empties the entry and points the objects drawing it at VK_CULL_NULL_MESH,
+// so they draw nothing even once the id and ranges are reused.
+void vk_cull_remove_mesh(vk_cull *self, vk_upload_ring *upload, Uint32 id);
+// Returns the object index, or UINT32_MAX when the buffer is full. The index
+// is also the draw's firstInstance. `instance` is instance_stride bytes. A
+// mesh id past the table is replaced with VK_CULL_NULL_MESH.
+Uint32 vk_cull_add_object(vk_cull *self, vk_upload_ring *upload,
+			  const gpu_object *object, const void *instance);
+void vk_cull_update_object(vk_cull *self, vk_upload_ring *upload, Uint32 index,
+			   const gpu_object *object, const void *instance);
+void vk_cull_clear_objects(vk_cull *self);
+
+// Record the culling dispatch. Must be outside a render pass.
+void vk_cull_dispatch(vk_cull *self, VkCommandBuffer cmd, mat4 view_proj);
+// Record the indirect draw. Expects the mesh pool buffers to be bound and
+// binds the instance buffer at binding 1.
+void vk_cull_draw(vk_cull *self, VkCommandBuffer cmd);
+
+#endif // !_VK_CULL_H_
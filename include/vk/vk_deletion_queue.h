@@ -0,0 +1,83 @@
+#ifndef _VK_DELETION_QUEUE_H_
+#define _VK_DELETION_QUEUE_H_
+
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+#include "vk/vk_types.h"
+#include "vk/vk_mem.h"
+
+// Objects that frames still in flight may use are queued here with the last
+// frame that can reference them and destroyed once the GPU has finished that
+// frame, so replacing them never waits on the device.
+typedef enum {
+	VK_DELETE_SWAPCHAIN,
+	VK_DELETE_IMAGE_VIEW,
+	VK_DELETE_FRAMEBUFFER,
+	VK_DELETE_COMMAND_BUFFER,
+	VK_DELETE_COMMAND_POOL,
+	VK_DELETE_PIPELINE,
+	VK_DELETE_PIPELINE_LAYOUT,
+	VK_DELETE_DESCRIPTOR_POOL,
+	VK_DELETE_DESCRIPTOR_SET_LAYOUT,
+	VK_DELETE_SAMPLER,
+	VK_DELETE_BUFFER, // through vk_mem
+	VK_DELETE_IMAGE, // through vk_mem
+	VK_DELETE_HOST_MEMORY,
+	VK_DELETE_CALLBACK, // for owners that keep their own bookkeeping
+} vk_deletion_type;
+
+typedef void (*vk_deletion_fn)(void *owner, Uint64 arg);
+
+typedef struct {
+	vk_deletion_type type;
+	Uint64 frame; // last frame that may use the object
+	union {
+		VkSwapchainKHR swap_chain;
+		VkImageView image_view;
+		VkFramebuffer framebuffer;
+		struct {
+			VkCommandPool pool;
+			VkCommandBuffer cmd;
+		} command_buffer;
+		VkCommandPool command_pool;
+		VkPipeline pipeline;
+		VkPipelineLayout pipeline_layout;
+		VkDescriptorPool descriptor_pool;
+		VkDescriptorSetLayout descriptor_set_layout;
+		VkSampler sampler;
+		struct {
+			vk_mem_allocator *allocator;
+			VkBuffer buffer;
+			vk_mem_allocation alloc;
+		} buffer;
+		struct {
+			vk_mem_allocator *allocator;
+			VkImage image;
+			vk_mem_allocation alloc;
+		} image;
+		void *host;
+		struct {
+			vk_deletion_fn fn;
+			void *owner;
+			Uint64 arg;
+		} callback;
+	};
+} vk_deletion;
+
+typedef struct {
+	VkDevice log_dev;
+	vk_deletion *entries; // in push order, so frames never decrease
+	Uint32 count;
+	Uint32 cap;
+} vk_deletion_queue;
+
+void vk_deletion_queue_init(vk_deletion_queue *self, VkDevice log_dev);
+// Destroys everything still queued. The caller guarantees the device is idle.
+void vk_deletion_queue_destroy(vk_deletion_queue *self);
+
+void vk_deletion_queue_push(vk_deletion_queue *self, const vk_deletion *deletion);
+// Destroys the entries of frames below `frames_completed`, the value of the
+// engine's frame timeline.
+void vk_deletion_queue_flush(vk_deletion_queue *self, Uint64 frames_completed);
+
+#endif // !_VK_DELETION_QUEUE_H_
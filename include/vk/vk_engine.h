@@ -4,9 +4,34 @@
 #include <stdbool.h>
 #include <SDL2/SDL.h>
 #include "vk/vk_types.h"
+#include "vk/vk_mem.h"
+#include "vk/vk_upload.h"
+#include "vk/vk_frame_ring.h"
+#include "vk/vk_mesh.h"
+#include "vk/vk_cull.h"
+#include "vk/vk_pipeline_cache.h"
+#include "vk/vk_pipelines.h"
+#include "vk/vk_deletion_queue.h"
+#include "vk/vk_profiler.h"
+#include "vk/vk_capture.h"
+#include "vk/vk_render_graph.h"
+#include "jobs.h"
+#include "frame_stats.h"
+#include "shader_watch.h"
+#include "asset_pack.h"
 #include <cglm/cglm.h>
 
-static const int MAX_FRAMES_IN_FLIGHT = 2;
+// Frames in flight is a runtime setting between 1 and MAX_FRAMES_IN_FLIGHT;
+// per-frame resources are sized for the maximum.
+static const Uint32 MAX_FRAMES_IN_FLIGHT = 4;
+static const Uint32 DEFAULT_FRAMES_IN_FLIGHT = 2;
+// Draw lists shorter than this are recorded inline on the main thread,
+// longer ones are split into slices of at least this many draws.
+static const Uint32 RECORD_DRAWS_PER_JOB = 2048;
+// a define, it sizes arrays
+#define MAX_RECORDERS 16
+static const Uint32 MESH_POOL_VERTICES = 1024 * 1024;
+static const Uint32 MESH_POOL_INDICES = 4 * 1024 * 1024;
 
 static VkResult
 CreateDebugUtilsMessengerEXT(VkInstance instance,
@@ -41,6 +66,25 @@ typedef struct {
 	vec3 color;
 } vertex;
 
+// per-instance attributes, vertex binding 1
+typedef struct {
+	mat4 model;
+	vec4 color;
+} instance_data;
+
+typedef struct {
+	Uint32 mesh;
+	bool translucent; // blended or no depth writes: drawn last, back to front
+	VkPipeline pipeline;
+	Uint32 first_instance; // into the frame's instance array
+	Uint32 instance_count;
+} draw_cmd;
+
+// std140 layout of set 0, binding 0
+typedef struct {
+	mat4 view_proj;
+} camera_data;
+
 typedef struct {
 	Uint32 graphics_family;
 	bool graphics_found;
@@ -56,31 +100,127 @@ typedef struct {
 	VkPresentModeKHR *present_modes;
 } swap_chain_support_details;
 
+typedef struct vulkan_engine vulkan_engine;
+
+// One slice of the draw list recorded into a secondary command buffer.
 typedef struct {
+	vulkan_engine *engine;
+	VkCommandPool pool;
+	VkCommandBuffer cmd;
+	Uint32 image_idx;
+	Uint32 first_draw;
+	Uint32 draw_count;
+	bool cull_draw; // also records the GPU culled indirect draw
+	Uint32 cull_at; // before this draw: the first translucent one
+	VkDeviceSize camera_offset;
+	VkDeviceSize instance_offset;
+	bool has_instances;
+} draw_recorder;
+
+// A primary command buffer kept across frames for one (frame slot, swapchain
+// image) pair. Only the frame ring offsets are baked in, the data behind them
+// is rewritten every frame.
+typedef struct {
+	VkCommandBuffer cmd;
+	Uint64 generation; // 0 never matches
+	VkDeviceSize camera_offset;
+	VkDeviceSize instance_offset;
+} static_recording;
+
+typedef struct vulkan_engine {
 	VkExtent2D swap_chain_extent;
 	VkFormat swap_chain_image_format;
-	Uint32 frame_num;
+	VkFormat depth_format;
+	// the frame's passes and targets; the depth buffer is a transient image
+	vk_render_graph graph;
+	Uint32 swap_chain_target;
+	Uint32 depth_target;
+	Uint32 main_pass;
+	Uint64 frame_num; // frame N signals frame_timeline to N + 1 when done
 	Uint32 swap_chain_images_size;
 	Uint32 current_frame;
+	Uint32 frames_in_flight;
 	bool initialized;
+	bool headless; // no window, surface or swapchain
 	bool fb_resized_flag;
-	VkPipeline graphics_pipeline;
+	VkPipeline graphics_pipeline; // default pipeline, also the fallback
+	VkPipeline draw_pipeline; // used by draws queued from now on
+	bool draw_translucent; // draw_pipeline blends or doesn't write depth
+	VkPipelineCache pipeline_cache;
+	vk_pipeline_desc default_pipeline_desc;
+	vk_pipelines pipelines;
+	job_system jobs;
+	asset_pack assets;
+	shader_watch shader_watch;
+	bool shader_reload;
+	// the main pass's, owned by the graph; VK_NULL_HANDLE with dynamic rendering
 	VkRenderPass render_pass;
 	VkCommandBuffer *command_buffers;
-	VkBuffer vertex_buffer;
+	// each recorder owns a pool and a secondary buffer per frame slot,
+	// indexed [slot * recorder_count + recorder]
+	Uint32 recorder_count;
+	VkCommandPool *record_pools;
+	VkCommandBuffer *record_buffers;
+	draw_recorder *recorders;
+	job_group record_jobs;
+	// static frames mode: recordings are reused while the scene is unchanged
+	bool static_frames;
+	bool static_dirty; // set by changes the draw list can't show
+	Uint64 static_generation;
+	static_recording *static_recordings; // [slot * swap_chain_images_size + image]
+	draw_cmd *static_draws; // draw list the current generation was recorded from
+	Uint32 static_draw_count;
+	Uint32 static_draw_cap;
+	Uint32 static_instance_count;
+	camera_data static_camera;
+	Uint64 reused_frames;
+	vk_mem_allocator allocator;
+	vk_upload_ring upload;
+	vk_frame_ring frame_ring;
+	camera_data camera;
+	VkDescriptorSetLayout descriptor_set_layout;
+	VkDescriptorPool descriptor_pool;
+	VkDescriptorSet frame_descriptor_set;
+	vk_mesh_pool meshes;
+	draw_cmd *draw_list; // draws queued for the next frame
+	Uint32 draw_count;
+	Uint32 draw_cap;
+	// the draw list is radix sorted by these before recording
+	bool sort_draws;
+	Uint64 *sort_keys; // and the sort's scratch, all sort_cap long
+	Uint32 *sort_order;
+	Uint64 *sort_tmp_keys;
+	Uint32 *sort_tmp_order;
+	draw_cmd *sorted_draws;
+	Uint32 sort_cap;
+	instance_data *instance_list;
+	Uint32 instance_count;
+	Uint32 instance_cap;
+	vk_cull cull;
+	bool multi_draw_indirect;
+	bool draw_indirect_count;
+	bool dynamic_rendering;
 	VkSemaphore *image_avail_sems;
 	VkSemaphore *rend_finished_sems;
-	VkFence *in_flight_fences;
+	VkSemaphore frame_timeline;
+	vk_deletion_queue deletions;
+	vk_profiler profiler;
+	vk_capture capture;
+	bool capture_supported; // target images allow transfer reads
+	frame_stats stats;
+	double last_frame_start_us;
 	VkPipelineLayout pipeline_layout;
 	VkSurfaceKHR sdl_surface;
 	VkQueue graphics_queue;
 	VkQueue present_queue;
 	VkInstance vk_instance;
 	VkSwapchainKHR swap_chain;
-	VkImage *swap_chain_images;
+	// a failed recreate retired it anyway, it can't be oldSwapchain again
+	bool swap_chain_retired;
+	VkImage *swap_chain_images; // engine-owned targets when headless
+	vk_mem_allocation *headless_allocs;
 	VkImageView *swap_chain_image_views;
 	VkCommandPool command_pool;
-	VkFramebuffer *swap_chain_frame_buffers;
 	VkPhysicalDevice phy_dev;
 	VkDevice log_dev;
 	VkDebugUtilsMessengerEXT debug_messenger;
@@ -89,7 +229,91 @@ typedef struct {
 } vulkan_engine;
 void vulkan_engine_draw_frame(vulkan_engine *self);
 void vulkan_engine_init(vulkan_engine *self, SDL_Window *window);
+// Renders into engine-owned images of the given size instead of a swapchain,
+// so it runs without a display and on devices that cannot present.
+void vulkan_engine_init_headless(vulkan_engine *self, Uint32 width, Uint32 height);
 void vulkan_engine_cleanup(vulkan_engine *self);
+// Does not wait for the device: the old swapchain is handed to the new one
+// and its resources are destroyed once the frames using them complete.
 void vulkan_engine_recreate_swap_chain(vulkan_engine *self);
+// Waits for the last submitted frame, so call it outside the hot path.
+// `count` is clamped to [1, MAX_FRAMES_IN_FLIGHT].
+void vulkan_engine_set_frames_in_flight(vulkan_engine *self, Uint32 count);
+// Reuse recorded command buffers while the queued draws, camera, meshes,
+// objects, pipelines and swapchain stay the same. Draws are recorded inline on
+// the main thread in this mode.
+void vulkan_engine_set_static_frames(vulkan_engine *self, bool enable);
+// Frames submitted with a cached recording instead of a fresh one.
+Uint64 vulkan_engine_reused_frames(vulkan_engine *self);
+// Destroy the object in `deletion` once the GPU is done with the frame being
+// recorded now, instead of waiting for the device. Sets deletion->frame.
+void vulkan_engine_defer_deletion(vulkan_engine *self, vk_deletion *deletion);
+// Number of frames the GPU has finished; frame N is done once this is > N.
+Uint64 vulkan_engine_frames_completed(vulkan_engine *self);
+void vulkan_engine_get_mem_stats(vulkan_engine *self, vk_mem_stats *rstats);
+void vulkan_engine_set_camera(vulkan_engine *self, mat4 view_proj);
+// Transient per-frame memory, valid until this frame slot comes around again.
+// `roffset` is relative to engine.frame_ring.buffer.
+void *vulkan_engine_frame_alloc(vulkan_engine *self, VkDeviceSize size,
+				VkDeviceSize alignment, VkDeviceSize *roffset);
+// Same, aligned for binding as a storage buffer.
+void *vulkan_engine_frame_alloc_storage(vulkan_engine *self, VkDeviceSize size,
+					VkDeviceSize *roffset);
+void vulkan_engine_get_frame_ring_stats(vulkan_engine *self, vk_frame_ring_stats *rstats);
+Uint32 vulkan_engine_add_mesh(vulkan_engine *self, const vertex *vertices,
+			      Uint32 vertex_count, const Uint32 *indices,
+			      Uint32 index_count);
+void vulkan_engine_remove_mesh(vulkan_engine *self, Uint32 mesh);
+// Queue a draw for the next vulkan_engine_draw_frame.
+void vulkan_engine_draw_mesh(vulkan_engine *self, Uint32 mesh);
+// One draw call for all instances. `instances` is copied.
+void vulkan_engine_draw_mesh_instanced(vulkan_engine *self, Uint32 mesh,
+				       const instance_data *instances,
+				       Uint32 instance_count);
+// Persistent objects, culled and drawn on the GPU every frame until cleared.
+// `radius` bounds the mesh around the model translation. Returns the object
+// index or UINT32_MAX when full.
+Uint32 vulkan_engine_add_object(vulkan_engine *self, Uint32 mesh,
+				const instance_data *instance, float radius);
+void vulkan_engine_clear_objects(vulkan_engine *self);
+// Starts from the engine's vertex layout, render pass and pipeline layout.
+void vulkan_engine_default_pipeline_desc(vulkan_engine *self, vk_pipeline_desc *rdesc);
+// Sort queued draws each frame: opaque ones grouped by pipeline and mesh and
+// front to back within, then blended or depth-write-free ones back to front,
+// equal depths in submission order. On by default; turn it off to keep
+// submission order across depths, e.g. for 2D layering.
+void vulkan_engine_set_draw_sorting(vulkan_engine *self, bool enable);
+// Draws queued after this call use `desc` (NULL for the default) until the
+// next frame. Variants still compiling draw with the default pipeline.
+void vulkan_engine_use_pipeline(vulkan_engine *self, const vk_pipeline_desc *desc);
+void vulkan_engine_get_pipeline_stats(vulkan_engine *self, vk_pipeline_stats *rstats);
+// Per-pass GPU times of the newest frame read back, frames_in_flight frames
+// behind the one being recorded.
+Uint32 vulkan_engine_get_gpu_timings(vulkan_engine *self,
+				     const vk_profiler_result **rresults);
+// Capture CPU and GPU scopes until vulkan_engine_write_trace, which saves them
+// as a Chrome trace.
+void vulkan_engine_start_trace(vulkan_engine *self);
+bool vulkan_engine_write_trace(vulkan_engine *self, const char *path);
+// CPU time per draw_frame stage over the last FRAME_STATS_WINDOW frames.
+void vulkan_engine_get_frame_stats(vulkan_engine *self, frame_stat stat,
+				   frame_stat_summary *rsummary);
+// Write all stage summaries as a JSON line every `interval_ms` to `path`
+// (appended) or stdout when NULL. 0 stops it.
+bool vulkan_engine_dump_frame_stats(vulkan_engine *self, const char *path,
+				    double interval_ms);
+// Save the next frame as a PNG, or with a NULL path only pass it to the
+// capture callback. Returns false when the targets can't be read back.
+bool vulkan_engine_capture(vulkan_engine *self, const char *path);
+// Save every frame to `pattern` with the frame number, e.g.
+// "frames/%06llu.png", until called with NULL. Frames are dropped, never
+// waited for, when encoding falls behind. Returns false for a pattern without
+// exactly one integer conversion.
+bool vulkan_engine_capture_sequence(vulkan_engine *self, const char *pattern);
+void vulkan_engine_set_capture_callback(vulkan_engine *self, vk_capture_fn fn,
+					void *user);
+// Captures still waiting for the GPU or the encoder.
+Uint32 vulkan_engine_captures_pending(vulkan_engine *self);
+void vulkan_engine_get_capture_stats(vulkan_engine *self, vk_capture_stats *rstats);
 
 #endif // !_VK_ENGINE_H_
@@ -0,0 +1,50 @@
+#ifndef _VK_FRAME_RING_H_
+#define _VK_FRAME_RING_H_
+
+#include <SDL2/SDL.h>
+#include "vk/vk_types.h"
+#include "vk/vk_mem.h"
+
+// One persistently mapped buffer split into a slice per frame in flight.
+// Per-frame data is bump allocated from the current slice and bound through
+// dynamic offsets, so nothing is created or destroyed per frame. A slice is
+// only rewritten once the frame that last used it has retired.
+#define VK_FRAME_RING_SLICE_SIZE (4ull * 1024 * 1024)
+
+typedef struct {
+	vk_mem_allocator *allocator;
+	VkBuffer buffer;
+	vk_mem_allocation alloc;
+	VkDeviceSize slice_size;
+	Uint32 slice_count;
+	VkDeviceSize uniform_alignment;
+	VkDeviceSize storage_alignment;
+	Uint32 slice;
+	VkDeviceSize cursor; // offset inside the current slice
+	VkDeviceSize high_water; // most bytes any slice has needed
+} vk_frame_ring;
+
+typedef struct {
+	VkDeviceSize slice_size;
+	VkDeviceSize used; // by the slice being filled
+	VkDeviceSize high_water;
+} vk_frame_ring_stats;
+
+void vk_frame_ring_init(vk_frame_ring *self, vk_mem_allocator *allocator,
+			VkPhysicalDevice phy_dev, Uint32 slice_count);
+void vk_frame_ring_destroy(vk_frame_ring *self);
+
+// Start filling `slice`. The caller guarantees the GPU is done with it.
+void vk_frame_ring_begin(vk_frame_ring *self, Uint32 slice);
+
+// Returns a mapped pointer and the offset of the allocation in `buffer`, or
+// NULL when the slice is exhausted. `alignment` must be a power of two, 0
+// uses the uniform buffer alignment.
+void *vk_frame_ring_alloc(vk_frame_ring *self, VkDeviceSize size,
+			  VkDeviceSize alignment, VkDeviceSize *roffset);
+// Same, aligned for binding as a storage buffer.
+void *vk_frame_ring_alloc_storage(vk_frame_ring *self, VkDeviceSize size,
+				  VkDeviceSize *roffset);
+void vk_frame_ring_get_stats(vk_frame_ring *self, vk_frame_ring_stats *rstats);
+
+#endif // !_VK_FRAME_RING_H_
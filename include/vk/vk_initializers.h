@@ -1,4 +1,8 @@
 #ifndef _VK_INITIALIZERS_H_
 #define _VK_INITIALIZERS_H_
 #include "vk/vk_types.h"
+#include "file.h"
+
+VkShaderModule create_shader_module(VkDevice log_dev, loaded_file *lf);
+
 #endif // !_VK_INITIALIZERS_H_
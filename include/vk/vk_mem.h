@@ -0,0 +1,109 @@
+#ifndef _VK_MEM_H_
+#define _VK_MEM_H_
+
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+#include "vk/vk_types.h"
+
+// Device memory is carved out of large blocks per memory type with a buddy
+// allocator. Allocations bigger than half a block (or that the driver asks
+// to be dedicated) get their own VkDeviceMemory.
+#define VK_MEM_BLOCK_SIZE (64ull * 1024 * 1024)
+#define VK_MEM_MIN_ORDER 8 // smallest buddy is 256 bytes
+
+// Linear (buffers) and optimal tiling (images) resources never share a block
+// so bufferImageGranularity never has to be honoured between neighbours.
+typedef enum {
+	VK_MEM_KIND_LINEAR,
+	VK_MEM_KIND_OPTIMAL,
+	VK_MEM_KIND_COUNT,
+} vk_mem_kind;
+
+typedef struct {
+	VkDeviceMemory memory;
+	VkDeviceSize size;
+	Uint32 levels;
+	// per buddy tree node: log2 of the largest free run in the subtree + 1,
+	// 0 when the subtree is fully allocated
+	Uint8 *longest;
+	void *mapped;
+	VkDeviceSize used;
+	Uint32 alloc_count;
+} vk_mem_block;
+
+typedef struct {
+	vk_mem_block **blocks;
+	Uint32 block_count;
+	Uint32 block_cap;
+} vk_mem_pool;
+
+typedef struct {
+	VkDeviceMemory memory;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	void *mapped; // NULL unless the memory type is host visible
+	vk_mem_block *block; // NULL for dedicated allocations
+	Uint32 type_idx;
+	Uint32 order;
+	vk_mem_kind kind;
+} vk_mem_allocation;
+
+typedef struct {
+	VkDeviceSize heap_size;
+	Uint32 block_count;
+	Uint32 dedicated_count;
+	Uint32 allocation_count;
+	VkDeviceSize reserved_bytes; // device memory owned by the allocator
+	VkDeviceSize used_bytes; // bytes handed out, buddy rounding included
+	VkDeviceSize largest_free; // biggest single allocation that still fits
+	float fragmentation; // share of free block memory outside largest runs
+} vk_mem_heap_stats;
+
+typedef struct {
+	Uint32 heap_count;
+	Uint32 device_allocations;
+	Uint32 max_device_allocations;
+	vk_mem_heap_stats heaps[VK_MAX_MEMORY_HEAPS];
+} vk_mem_stats;
+
+typedef struct {
+	VkDevice log_dev;
+	VkPhysicalDeviceMemoryProperties mem_props;
+	VkDeviceSize block_size[VK_MAX_MEMORY_TYPES];
+	vk_mem_pool pools[VK_MAX_MEMORY_TYPES][VK_MEM_KIND_COUNT];
+	Uint32 dedicated_count[VK_MAX_MEMORY_HEAPS];
+	VkDeviceSize dedicated_bytes[VK_MAX_MEMORY_HEAPS];
+	Uint32 device_allocations;
+	Uint32 max_device_allocations;
+} vk_mem_allocator;
+
+void vk_mem_allocator_init(vk_mem_allocator *self, VkPhysicalDevice phy_dev,
+			   VkDevice log_dev);
+void vk_mem_allocator_destroy(vk_mem_allocator *self);
+
+// returns UINT32_MAX when no memory type matches
+Uint32 vk_mem_find_type(vk_mem_allocator *self, Uint32 type_filter,
+			VkMemoryPropertyFlags props);
+
+// `preferred` flags are tried first and dropped if no memory type has them
+VkResult vk_mem_alloc(vk_mem_allocator *self, const VkMemoryRequirements *reqs,
+		      VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred,
+		      vk_mem_kind kind, bool dedicated, vk_mem_allocation *ralloc);
+void vk_mem_free(vk_mem_allocator *self, vk_mem_allocation *alloc);
+
+VkResult vk_mem_create_buffer(vk_mem_allocator *self, const VkBufferCreateInfo *info,
+			      VkMemoryPropertyFlags required,
+			      VkMemoryPropertyFlags preferred, VkBuffer *rbuffer,
+			      vk_mem_allocation *ralloc);
+void vk_mem_destroy_buffer(vk_mem_allocator *self, VkBuffer buffer,
+			   vk_mem_allocation *alloc);
+
+VkResult vk_mem_create_image(vk_mem_allocator *self, const VkImageCreateInfo *info,
+			     VkMemoryPropertyFlags required, VkImage *rimage,
+			     vk_mem_allocation *ralloc);
+void vk_mem_destroy_image(vk_mem_allocator *self, VkImage image,
+			  vk_mem_allocation *alloc);
+
+void vk_mem_get_stats(vk_mem_allocator *self, vk_mem_stats *rstats);
+
+#endif // !_VK_MEM_H_
@@ -0,0 +1,68 @@
+#ifndef _VK_MESH_H_
+#define _VK_MESH_H_
+
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+#include "vk/vk_types.h"
+#include "vk/vk_mem.h"
+#include "vk/vk_upload.h"
+
+// All meshes share one vertex buffer and one index buffer. A mesh is just a
+// range in each, so the buffers are bound once per frame and every draw is a
+// vkCmdDrawIndexed with offsets.
+#define VK_MESH_INVALID UINT32_MAX
+
+typedef struct {
+	Uint32 offset;
+	Uint32 count;
+} vk_mesh_range;
+
+typedef struct {
+	vk_mesh_range *ranges; // sorted by offset, never adjacent
+	Uint32 count;
+	Uint32 cap;
+} vk_mesh_free_list;
+
+typedef struct {
+	Uint32 first_index;
+	Uint32 index_count;
+	Sint32 vertex_offset;
+	Uint32 vertex_count;
+	bool live;
+	bool removed; // ranges and id held until released
+} vk_mesh;
+
+typedef struct {
+	vk_mem_allocator *allocator;
+	Uint32 vertex_stride;
+	VkBuffer vertex_buffer;
+	vk_mem_allocation vertex_alloc;
+	VkBuffer index_buffer;
+	vk_mem_allocation index_alloc;
+	vk_mesh_free_list free_vertices;
+	vk_mesh_free_list free_indices;
+	vk_mesh *meshes;
+	Uint32 mesh_count;
+	Uint32 mesh_cap;
+} vk_mesh_pool;
+
+void vk_mesh_pool_init(vk_mesh_pool *self, vk_mem_allocator *allocator,
+		       Uint32 vertex_stride, Uint32 vertex_capacity,
+		       Uint32 index_capacity);
+void vk_mesh_pool_destroy(vk_mesh_pool *self);
+
+// Returns the mesh id, or VK_MESH_INVALID when the pool is full. Data is
+// queued on `upload` and is ready once that ring's next flush completes.
+Uint32 vk_mesh_pool_add(vk_mesh_pool *self, vk_upload_ring *upload,
+			const void *vertices, Uint32 vertex_count,
+			const Uint32 *indices, Uint32 index_count);
+// Stops the mesh from being drawn. Its ranges and id stay reserved for the
+// frames still in flight until vk_mesh_pool_release.
+void vk_mesh_pool_remove(vk_mesh_pool *self, Uint32 mesh);
+// The caller guarantees no in-flight frame still draws the mesh.
+void vk_mesh_pool_release(vk_mesh_pool *self, Uint32 mesh);
+vk_mesh *vk_mesh_pool_get(vk_mesh_pool *self, Uint32 mesh);
+
+void vk_mesh_pool_bind(vk_mesh_pool *self, VkCommandBuffer cmd);
+
+#endif // !_VK_MESH_H_
@@ -0,0 +1,16 @@
+#ifndef _VK_PIPELINE_CACHE_H_
+#define _VK_PIPELINE_CACHE_H_
+
+#include "vk/vk_types.h"
+
+// VkPipelineCache persisted between runs. The file is only fed to the driver
+// when its header matches this device (vendor, device and cache UUID), and
+// it is replaced atomically so a crash mid-write never leaves a torn cache.
+
+// Returns a cache seeded from `path` when the file is usable, empty otherwise.
+VkPipelineCache vk_pipeline_cache_load(VkPhysicalDevice phy_dev, VkDevice log_dev,
+				       const char *path);
+void vk_pipeline_cache_save(VkDevice log_dev, VkPipelineCache cache,
+			    const char *path);
+
+#endif // !_VK_PIPELINE_CACHE_H_
@@ -0,0 +1,139 @@
+#ifndef _VK_PIPELINES_H_
+#define _VK_PIPELINES_H_
+
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+#include "vk/vk_types.h"
+#include "vk/vk_deletion_queue.h"
+#include "jobs.h"
+#include "asset_pack.h"
+
+// Graphics pipelines built on demand from a description and cached by its
+// hash. A miss queues the compile on the job system and the caller draws
+// with its fallback until the pipeline is ready, so new variants never
+// stall a frame.
+#define VK_PIPELINE_PATH_LEN 64
+#define VK_PIPELINE_MAX_BINDINGS 4
+#define VK_PIPELINE_MAX_ATTRIBUTES 16
+#define VK_PIPELINE_MAX_RELOADED 16 // distinct shader files hot reloaded
+
+typedef enum {
+	VK_BLEND_MODE_OPAQUE,
+	VK_BLEND_MODE_ALPHA,
+	VK_BLEND_MODE_ADDITIVE,
+} vk_blend_mode;
+
+// Hashed bytewise: start from vk_pipeline_desc_init so padding and unused
+// slots are zero, then assign fields.
+typedef struct {
+	char vert_path[VK_PIPELINE_PATH_LEN];
+	char frag_path[VK_PIPELINE_PATH_LEN];
+	VkPrimitiveTopology topology;
+	VkPolygonMode polygon_mode;
+	VkCullModeFlags cull_mode;
+	VkFrontFace front_face;
+	vk_blend_mode blend;
+	// blended draws and draws without depth writes are treated as
+	// translucent and sorted back to front
+	VkBool32 depth_test;
+	VkBool32 depth_write;
+	VkCompareOp depth_compare;
+	Uint32 binding_count;
+	VkVertexInputBindingDescription bindings[VK_PIPELINE_MAX_BINDINGS];
+	Uint32 attribute_count;
+	VkVertexInputAttributeDescription attributes[VK_PIPELINE_MAX_ATTRIBUTES];
+	VkPipelineLayout layout;
+	VkRenderPass render_pass; // VK_NULL_HANDLE for dynamic rendering
+	Uint32 subpass;
+	// dynamic rendering only: the one color attachment and the depth one
+	VkFormat color_format;
+	VkFormat depth_format;
+} vk_pipeline_desc;
+
+typedef enum {
+	VK_PIPELINE_PENDING,
+	VK_PIPELINE_READY,
+	VK_PIPELINE_FAILED,
+} vk_pipeline_state;
+
+struct vk_pipelines;
+
+typedef enum {
+	VK_RELOAD_IDLE,
+	VK_RELOAD_COMPILING,
+	VK_RELOAD_DONE, // next_pipeline is set, swapped at the next update
+} vk_pipeline_reload;
+
+typedef struct {
+	vk_pipeline_desc desc;
+	Uint64 hash;
+	VkPipeline pipeline;
+	SDL_atomic_t state; // vk_pipeline_state, set last by the compiling thread
+	double compile_ms;
+	struct vk_pipelines *owner;
+	// shader reloads compile next to the live pipeline
+	VkPipeline next_pipeline;
+	SDL_atomic_t reload; // vk_pipeline_reload
+	bool reload_again; // sources changed again while compiling
+} vk_pipeline_entry;
+
+typedef struct {
+	Uint64 hits;
+	Uint64 misses;
+	Uint64 fallbacks; // lookups answered with the fallback pipeline
+	Uint32 pending;
+	Uint32 compiled;
+	Uint32 failed;
+	double total_compile_ms;
+	double max_compile_ms;
+} vk_pipeline_stats;
+
+typedef struct vk_pipelines {
+	VkDevice log_dev;
+	VkPipelineCache cache;
+	job_system *jobs;
+	const asset_pack *assets;
+	vk_pipeline_entry **slots; // open addressing on hash
+	Uint32 slot_cap;
+	Uint32 entry_count;
+	SDL_mutex *stats_lock; // compile counters are written by workers
+	vk_pipeline_stats stats;
+	Uint32 reloads; // entries with a reload outstanding
+	bool reload_again; // some entry has reload_again set
+	vk_deletion_queue *deletions; // replaced pipelines go here
+	// shaders reloaded at least once, read from disk by every later build
+	// since the pack still holds the build-time code
+	SDL_mutex *reloaded_lock;
+	char reloaded[VK_PIPELINE_MAX_RELOADED][VK_PIPELINE_PATH_LEN];
+	Uint32 reloaded_count;
+} vk_pipelines;
+
+void vk_pipeline_desc_init(vk_pipeline_desc *desc);
+void vk_pipeline_desc_set_shaders(vk_pipeline_desc *desc, const char *vert_path,
+				  const char *frag_path);
+Uint64 vk_pipeline_desc_hash(const vk_pipeline_desc *desc);
+
+// Shaders are looked up in `assets` first (may be NULL).
+void vk_pipelines_init(vk_pipelines *self, VkDevice log_dev, VkPipelineCache cache,
+		       job_system *jobs, const asset_pack *assets,
+		       vk_deletion_queue *deletions);
+// Waits for in-flight compiles and destroys every pipeline.
+void vk_pipelines_destroy(vk_pipelines *self);
+
+// The cached pipeline when ready, otherwise `fallback`; a first lookup
+// queues the compile.
+VkPipeline vk_pipelines_get(vk_pipelines *self, const vk_pipeline_desc *desc,
+			    VkPipeline fallback);
+// Compiles on the calling thread if needed. For startup and fallbacks.
+VkPipeline vk_pipelines_get_blocking(vk_pipelines *self, const vk_pipeline_desc *desc);
+void vk_pipelines_get_stats(vk_pipelines *self, vk_pipeline_stats *rstats);
+
+// Recompile, in the background, every pipeline built from `spv_path`. The
+// live pipelines keep serving until vk_pipelines_update swaps them.
+void vk_pipelines_reload_shader(vk_pipelines *self, const char *spv_path);
+// Call at a frame boundary. Swaps in finished reloads and queues the old
+// pipelines for deletion after `frame`, the frame being recorded. Returns the
+// number of pipelines swapped.
+Uint32 vk_pipelines_update(vk_pipelines *self, Uint64 frame);
+
+#endif // !_VK_PIPELINES_H_
@@ -0,0 +1,85 @@
+#ifndef _VK_PROFILER_H_
+#define _VK_PROFILER_H_
+
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+#include "vk/vk_types.h"
+
+// GPU pass timings from timestamp queries, plus CPU scopes, exportable as a
+// Chrome trace (chrome://tracing, ui.perfetto.dev). Each frame slot owns a
+// range of queries that is read back when the slot comes around again, after
+// the frame timeline says the GPU is done with it, so nothing ever stalls.
+// Scope names must be string literals or otherwise outlive the profiler.
+#define VK_PROFILER_MAX_SCOPES 32
+#define VK_PROFILER_MAX_TRACE_EVENTS (64 * 1024)
+
+typedef struct {
+	const char *name;
+	double ms;
+} vk_profiler_result;
+
+typedef struct {
+	const char *name;
+	double ts_us;
+	double dur_us;
+	Uint32 tid; // 0 CPU, 1 GPU
+	Uint64 frame;
+} vk_trace_event;
+
+typedef struct {
+	Uint32 scope_count;
+	const char *names[VK_PROFILER_MAX_SCOPES];
+	Uint64 frame; // frame that last submitted the slot
+	double submit_us;
+	bool submitted;
+} vk_profiler_slot;
+
+typedef struct {
+	VkDevice log_dev;
+	bool enabled; // the graphics queue has timestamps
+	VkQueryPool query_pool;
+	double period_ns; // per timestamp tick
+	Uint64 valid_mask;
+	Uint32 slot_count;
+	vk_profiler_slot *slots;
+	Uint32 slot; // being recorded
+	Uint64 cpu_origin;
+	Uint64 cpu_freq;
+	// most recent frame read back
+	vk_profiler_result results[VK_PROFILER_MAX_SCOPES];
+	Uint32 result_count;
+	Uint64 result_frame;
+	bool capturing;
+	vk_trace_event *events;
+	Uint32 event_count;
+} vk_profiler;
+
+void vk_profiler_init(vk_profiler *self, VkPhysicalDevice phy_dev, VkDevice log_dev,
+		      Uint32 queue_family, Uint32 slot_count);
+void vk_profiler_destroy(vk_profiler *self);
+
+// Call once the GPU has finished the frame that last used `slot`: reads its
+// timestamps into the results and, while capturing, the trace.
+void vk_profiler_collect(vk_profiler *self, Uint32 slot);
+// Record at the start of a command buffer for `slot`, outside a render pass.
+// Recordings that are reused keep the scopes they were recorded with.
+void vk_profiler_reset(vk_profiler *self, VkCommandBuffer cmd, Uint32 slot);
+// Returns the scope id for vk_profiler_end, or UINT32_MAX when out of scopes.
+Uint32 vk_profiler_begin(vk_profiler *self, VkCommandBuffer cmd, const char *name);
+void vk_profiler_end(vk_profiler *self, VkCommandBuffer cmd, Uint32 scope);
+// GPU times of the slot are anchored at its CPU submit time.
+void vk_profiler_submit(vk_profiler *self, Uint32 slot, Uint64 frame);
+
+// Microseconds since vk_profiler_init, the trace's time base.
+double vk_profiler_now_us(vk_profiler *self);
+void vk_profiler_cpu_scope(vk_profiler *self, const char *name, double start_us,
+			   double end_us, Uint64 frame);
+
+// Collect trace events from now on, up to VK_PROFILER_MAX_TRACE_EVENTS.
+// Restarting drops the previous capture.
+void vk_profiler_start_capture(vk_profiler *self);
+void vk_profiler_stop_capture(vk_profiler *self);
+// Writes the captured events as Chrome trace-event JSON.
+bool vk_profiler_write_trace(vk_profiler *self, const char *path);
+
+#endif // !_VK_PROFILER_H_
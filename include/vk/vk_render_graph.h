@@ -0,0 +1,220 @@
+#ifndef _VK_RENDER_GRAPH_H_
+#define _VK_RENDER_GRAPH_H_
+
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+#include "vk/vk_types.h"
+#include "vk/vk_mem.h"
+#include "vk/vk_deletion_queue.h"
+
+// Passes declare the images they use and how; compiling the graph culls the
+// passes nothing depends on, works out every layout transition and barrier,
+// builds render passes and framebuffers, and places transient images whose
+// lifetimes don't overlap in the same memory. Passes run in declaration
+// order, so declare producers before consumers.
+//
+// Images are either transient, owned by the graph and sized with it, or
+// imported, like swapchain images, whose contents outlive the frame.
+//
+// With dynamic rendering graphics passes begin with vkCmdBeginRendering on
+// the image views directly, so there are no render passes or framebuffers
+// and a resize only rebuilds the transient images. Without it every pass
+// gets a render pass and a framebuffer per imported image.
+#define VK_RG_MAX_RESOURCES 32
+#define VK_RG_MAX_PASSES 32
+#define VK_RG_MAX_USES 8 // images per pass
+#define VK_RG_NAME_LEN 32
+
+typedef enum {
+	VK_RG_PASS_GRAPHICS, // renders to its attachments
+	VK_RG_PASS_COMPUTE,
+	VK_RG_PASS_TRANSFER,
+} vk_rg_pass_type;
+
+typedef enum {
+	VK_RG_COLOR_ATTACHMENT,
+	VK_RG_DEPTH_ATTACHMENT,
+	VK_RG_SAMPLED,
+	VK_RG_STORAGE_READ,
+	VK_RG_STORAGE_WRITE,
+	VK_RG_TRANSFER_SRC,
+	VK_RG_TRANSFER_DST,
+} vk_rg_usage;
+
+struct vk_render_graph;
+
+// What a pass records with. `frame` is the pointer given to
+// vk_render_graph_execute.
+typedef struct {
+	struct vk_render_graph *graph;
+	Uint32 pass;
+	VkCommandBuffer cmd;
+	Uint32 image_idx;
+	VkExtent2D extent;
+	void *frame;
+} vk_rg_context;
+
+typedef void (*vk_rg_record_fn)(void *data, const vk_rg_context *ctx);
+
+// What secondary buffers recorded inside a graphics pass inherit. Filled in
+// place: `info` points into the struct.
+typedef struct {
+	VkCommandBufferInheritanceInfo info;
+	VkCommandBufferInheritanceRenderingInfo rendering;
+	VkFormat color_formats[VK_RG_MAX_USES];
+} vk_rg_inheritance;
+
+typedef struct {
+	char name[VK_RG_NAME_LEN];
+	VkFormat format;
+	Uint32 width; // 0 for the graph's extent
+	Uint32 height;
+	bool imported;
+	// imported images, one per image_idx modulo image_count
+	VkImage *images;
+	VkImageView *views;
+	Uint32 image_count;
+	VkImageLayout initial_layout; // at the start of the graph
+	VkImageLayout final_layout; // left in after it
+	VkPipelineStageFlags initial_stages; // last touched by, e.g. an acquire wait
+	// filled in by compile
+	VkImageUsageFlags usage;
+	Sint32 first_pass; // first and last live pass using it, -1 when unused
+	Sint32 last_pass;
+	Uint32 slot; // memory shared with other transient images
+	VkDeviceSize size;
+} vk_rg_resource;
+
+typedef struct {
+	Uint32 resource;
+	vk_rg_usage usage;
+	VkAttachmentLoadOp load; // attachments only
+	VkClearValue clear;
+	bool stored; // a later pass or the caller reads what this pass leaves
+} vk_rg_use;
+
+typedef struct {
+	Uint32 resource;
+	VkImageLayout old_layout;
+	VkImageLayout new_layout;
+	VkAccessFlags src_access;
+	VkAccessFlags dst_access;
+} vk_rg_barrier;
+
+typedef struct {
+	char name[VK_RG_NAME_LEN];
+	vk_rg_pass_type type;
+	vk_rg_record_fn fn;
+	void *data;
+	bool keep; // has effects the graph can't see, never culled
+	bool live;
+	vk_rg_use uses[VK_RG_MAX_USES];
+	Uint32 use_count;
+	VkRenderPass render_pass;
+	VkExtent2D extent;
+	// recorded in one vkCmdPipelineBarrier before the pass
+	Uint32 first_barrier;
+	Uint32 barrier_count;
+	VkPipelineStageFlags src_stages;
+	VkPipelineStageFlags dst_stages;
+} vk_rg_pass;
+
+// Everything that depends on the extent, retired as a whole on resize.
+typedef struct {
+	VkDevice log_dev;
+	vk_mem_allocator *allocator;
+	VkImage images[VK_RG_MAX_RESOURCES]; // transient ones
+	VkImageView views[VK_RG_MAX_RESOURCES];
+	vk_mem_allocation slots[VK_RG_MAX_RESOURCES];
+	Uint32 slot_count;
+	VkFramebuffer *framebuffers[VK_RG_MAX_PASSES];
+	Uint32 framebuffer_counts[VK_RG_MAX_PASSES];
+} vk_rg_targets;
+
+typedef struct {
+	Uint32 passes;
+	Uint32 culled_passes;
+	Uint32 barriers; // image barriers recorded per frame
+	Uint32 transient_images;
+	VkDeviceSize transient_bytes; // what the images would take on their own
+	VkDeviceSize allocated_bytes; // what they take aliased
+} vk_rg_stats;
+
+typedef struct vk_render_graph {
+	VkDevice log_dev;
+	vk_mem_allocator *allocator;
+	bool dynamic_rendering;
+	vk_rg_resource resources[VK_RG_MAX_RESOURCES];
+	Uint32 resource_count;
+	vk_rg_pass passes[VK_RG_MAX_PASSES];
+	Uint32 pass_count;
+	bool compiled;
+	VkExtent2D extent;
+	vk_rg_targets *targets;
+	vk_rg_barrier *barriers;
+	Uint32 barrier_count;
+	Uint32 barrier_cap;
+	// imported images moved to their final layouts after the last pass
+	Uint32 first_final;
+	Uint32 final_count;
+	VkPipelineStageFlags final_stages;
+	vk_rg_stats stats;
+} vk_render_graph;
+
+// `dynamic_rendering` needs the Vulkan 1.3 feature enabled on the device.
+void vk_render_graph_init(vk_render_graph *self, vk_mem_allocator *allocator,
+			  VkDevice log_dev, bool dynamic_rendering);
+// The caller guarantees the device is done with the graph.
+void vk_render_graph_destroy(vk_render_graph *self);
+
+// A transient image, `width` and `height` 0 to follow the graph's extent.
+Uint32 vk_render_graph_image(vk_render_graph *self, const char *name, VkFormat format,
+			     Uint32 width, Uint32 height);
+// An image owned by the caller, bound with vk_render_graph_bind_images.
+// `stages` last touched it before the graph runs; semaphore waits on it must
+// target one of them.
+Uint32 vk_render_graph_import(vk_render_graph *self, const char *name,
+			      VkFormat format, VkImageLayout initial_layout,
+			      VkImageLayout final_layout, VkPipelineStageFlags stages);
+// `images` and `views` are copied. With several, image_idx picks one.
+void vk_render_graph_bind_images(vk_render_graph *self, Uint32 resource,
+				 const VkImage *images, const VkImageView *views,
+				 Uint32 count);
+
+Uint32 vk_render_graph_add_pass(vk_render_graph *self, const char *name,
+				vk_rg_pass_type type, vk_rg_record_fn fn, void *data);
+// For passes whose results leave the graph some other way.
+void vk_render_graph_keep(vk_render_graph *self, Uint32 pass);
+void vk_render_graph_color(vk_render_graph *self, Uint32 pass, Uint32 resource,
+			   VkAttachmentLoadOp load, const VkClearColorValue *clear);
+void vk_render_graph_depth(vk_render_graph *self, Uint32 pass, Uint32 resource,
+			   VkAttachmentLoadOp load, float clear);
+// Any other use: sampling, storage and transfers.
+void vk_render_graph_use(vk_render_graph *self, Uint32 pass, Uint32 resource,
+			 vk_rg_usage usage);
+
+// Call once every pass is declared. Imported images must be bound.
+bool vk_render_graph_compile(vk_render_graph *self, VkExtent2D extent);
+// Rebuilds the transient images and any framebuffers, e.g. with a new swapchain
+// bound. The old ones go through `deletions` after `frame`.
+void vk_render_graph_resize(vk_render_graph *self, VkExtent2D extent,
+			    vk_deletion_queue *deletions, Uint64 frame);
+
+void vk_render_graph_execute(vk_render_graph *self, VkCommandBuffer cmd,
+			     Uint32 image_idx, void *frame);
+// For graphics passes, around their draws. Pass
+// VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS to execute secondary buffers.
+void vk_render_graph_begin_pass(const vk_rg_context *ctx, VkSubpassContents contents);
+void vk_render_graph_end_pass(const vk_rg_context *ctx);
+
+// Pipelines of a graphics pass are made against its render pass, or with
+// dynamic rendering, which returns VK_NULL_HANDLE, its attachment formats.
+VkRenderPass vk_render_graph_render_pass(vk_render_graph *self, Uint32 pass);
+// VK_NULL_HANDLE with dynamic rendering.
+VkFramebuffer vk_render_graph_framebuffer(vk_render_graph *self, Uint32 pass,
+					  Uint32 image_idx);
+void vk_render_graph_inheritance(vk_render_graph *self, Uint32 pass, Uint32 image_idx,
+				 vk_rg_inheritance *rinherit);
+void vk_render_graph_get_stats(vk_render_graph *self, vk_rg_stats *rstats);
+
+#endif // !_VK_RENDER_GRAPH_H_
@@ -0,0 +1,82 @@
+#ifndef _VK_UPLOAD_H_
+#define _VK_UPLOAD_H_
+
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+#include "vk/vk_types.h"
+#include "vk/vk_mem.h"
+
+// Host data is staged through one persistently mapped ring buffer. Copies are
+// queued on the CPU and recorded into a single command buffer per flush, so a
+// frame pays for one extra submission no matter how many uploads it carries.
+#define VK_UPLOAD_RING_SIZE (32ull * 1024 * 1024)
+#define VK_UPLOAD_MAX_BATCHES 4
+
+typedef struct {
+	VkBuffer dst;
+	VkBufferCopy region;
+	Uint32 order; // queue position, later copies win where they overlap
+} vk_upload_buffer_copy;
+
+typedef struct {
+	VkImage dst;
+	VkImageLayout old_layout; // undefined for an image's first chunk
+	VkImageLayout final_layout;
+	VkBufferImageCopy region;
+	bool barrier; // first chunk of this image in the batch
+} vk_upload_image_copy;
+
+typedef struct {
+	VkCommandBuffer cmd;
+	VkFence fence;
+	Uint64 serial;
+	Uint64 ring_end; // ring head once this batch's data was written
+	bool pending;
+} vk_upload_batch;
+
+typedef struct {
+	VkDevice log_dev;
+	VkQueue queue;
+	vk_mem_allocator *allocator;
+	VkCommandPool command_pool;
+	VkBuffer staging;
+	vk_mem_allocation staging_alloc;
+	VkDeviceSize size;
+	VkDeviceSize alignment;
+	// monotonic byte counters, the ring position is counter % size
+	Uint64 head;
+	Uint64 tail;
+	vk_upload_batch batches[VK_UPLOAD_MAX_BATCHES];
+	Uint32 batch_idx;
+	Uint64 next_serial; // serial handed to copies queued right now
+	Uint64 completed_serial;
+	vk_upload_buffer_copy *buffer_copies;
+	Uint32 buffer_copy_count;
+	Uint32 buffer_copy_cap;
+	vk_upload_image_copy *image_copies;
+	Uint32 image_copy_count;
+	Uint32 image_copy_cap;
+} vk_upload_ring;
+
+void vk_upload_ring_init(vk_upload_ring *self, vk_mem_allocator *allocator,
+			 VkPhysicalDevice phy_dev, VkDevice log_dev, VkQueue queue,
+			 Uint32 queue_family);
+void vk_upload_ring_destroy(vk_upload_ring *self);
+
+// Queue a copy into `dst`. The returned serial completes once the data has
+// landed on the device and its staging space has been recycled.
+Uint64 vk_upload_buffer(vk_upload_ring *self, VkBuffer dst, VkDeviceSize dst_offset,
+			const void *data, VkDeviceSize size);
+// Whole-image upload of mip 0, streamed in row chunks of at most half the
+// ring; the image ends up in `final_layout`.
+Uint64 vk_upload_image(vk_upload_ring *self, VkImage dst, VkImageAspectFlags aspect,
+		       VkExtent3D extent, VkImageLayout final_layout, const void *data,
+		       VkDeviceSize size);
+
+// Record and submit every queued copy. Call once per frame before the frame's
+// own submission on the same queue.
+void vk_upload_flush(vk_upload_ring *self);
+bool vk_upload_is_complete(vk_upload_ring *self, Uint64 serial);
+void vk_upload_wait(vk_upload_ring *self, Uint64 serial);
+
+#endif // !_VK_UPLOAD_H_
@@ -0,0 +1,127 @@
+#include "asset_pack.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// FNV-1a
+Uint64 asset_pack_hash(const char *path)
+{
+	Uint64 hash = 14695981039346656037ull;
+	for (const char *c = path; *c != '\0'; c++) {
+		hash ^= (Uint8)*c;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+static bool pack_is_valid(const asset_pack *self)
+{
+	const asset_pack_header *header = self->header;
+	if (self->size < sizeof(asset_pack_header) || header->magic != ASSET_PACK_MAGIC ||
+	    header->version != ASSET_PACK_VERSION || header->file_size != self->size) {
+		return false;
+	}
+	if (header->toc_offset > self->size ||
+	    (self->size - header->toc_offset) / sizeof(asset_pack_entry) <
+		    header->entry_count) {
+		return false;
+	}
+
+	const asset_pack_entry *entries =
+		(const asset_pack_entry *)(self->base + header->toc_offset);
+	for (Uint32 i = 0; i < header->entry_count; i++) {
+		if (entries[i].offset > self->size ||
+		    entries[i].size > self->size - entries[i].offset) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool asset_pack_open(asset_pack *self, const char *path)
+{
+	memset(self, 0, sizeof(asset_pack));
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		close(fd);
+		return false;
+	}
+
+	void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps the file referenced
+	close(fd);
+	if (base == MAP_FAILED) {
+		perror("mmap");
+		return false;
+	}
+
+	self->base = base;
+	self->size = st.st_size;
+	self->header = base;
+	if (!pack_is_valid(self)) {
+		fprintf(stderr, "Ignoring malformed asset pack %s\n", path);
+		asset_pack_close(self);
+		return false;
+	}
+	self->entries = (const asset_pack_entry *)(self->base + self->header->toc_offset);
+
+	return true;
+}
+
+void asset_pack_close(asset_pack *self)
+{
+	if (self->base != NULL) {
+		munmap(self->base, self->size);
+	}
+	memset(self, 0, sizeof(asset_pack));
+}
+
+const asset_pack_entry *asset_pack_find(const asset_pack *self, const char *path)
+{
+	if (self == NULL || self->base == NULL) {
+		return NULL;
+	}
+
+	Uint64 hash = asset_pack_hash(path);
+	Uint32 lo = 0;
+	Uint32 hi = self->header->entry_count;
+	while (lo < hi) {
+		Uint32 mid = lo + (hi - lo) / 2;
+		if (self->entries[mid].hash < hash) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	if (lo < self->header->entry_count && self->entries[lo].hash == hash) {
+		return &self->entries[lo];
+	}
+	return NULL;
+}
+
+loaded_file asset_pack_load(const asset_pack *self, const char *path)
+{
+	const asset_pack_entry *entry = asset_pack_find(self, path);
+	if (entry == NULL) {
+		return read_file(path);
+	}
+
+	loaded_file lf = {
+		.buf = (char *)self->base + entry->offset,
+		.size = entry->size,
+		.mapped = true,
+	};
+	return lf;
+}
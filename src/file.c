@@ -5,35 +5,58 @@
 
 loaded_file read_file(const char *file_name)
 {
-	FILE *file = fopen(file_name, "rb");
+	loaded_file lf = {
+		.buf = NULL,
+		.size = 0,
+		.mapped = false,
+	};
 
+	FILE *file = fopen(file_name, "rb");
 	if (file == NULL) {
 		fprintf(stderr, "Error opening file: %s\n", file_name);
+		return lf;
 	}
 
-	fseek(file, 0, SEEK_END); 
-	Uint32 file_size = ftell(file);
+	long file_size = -1;
+	if (fseek(file, 0, SEEK_END) == 0) {
+		file_size = ftell(file);
+	}
+	if (file_size < 0) {
+		fprintf(stderr, "Error sizing file: %s\n", file_name);
+		fclose(file);
+		return lf;
+	}
 	rewind(file);
 
-	char *code = aligned_alloc(sizeof(Uint32), sizeof(char) * file_size);
+	// aligned_alloc wants a multiple of the alignment
+	size_t alloc_size = ((size_t)file_size + sizeof(Uint32) - 1) &
+			    ~(sizeof(Uint32) - 1);
+	char *code = aligned_alloc(sizeof(Uint32), alloc_size ? alloc_size : sizeof(Uint32));
 	if (code == NULL) {
 		perror("aligned_alloc");
 		fclose(file);
+		return lf;
 	}
 
-	fread(code, file_size, 1, file);
+	if (file_size > 0 && fread(code, file_size, 1, file) != 1) {
+		fprintf(stderr, "Error reading file: %s\n", file_name);
+		free(code);
+		fclose(file);
+		return lf;
+	}
 
 	fclose(file);
 
-	loaded_file lf = {
-		.buf = code,
-		.size = file_size,
-	};
-
+	lf.buf = code;
+	lf.size = (Uint64)file_size;
 	return lf;
 }
 
 void loaded_file_destroy(loaded_file *self)
 {
-	free(self->buf);
+	if (!self->mapped) {
+		free(self->buf);
+	}
+	self->buf = NULL;
+	self->size = 0;
 }
@@ -0,0 +1,156 @@
+#include "frame_scheduler.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Timed waits wake up late by up to a scheduler tick; this much before a
+// deadline is spun instead.
+#define SPIN_MS 2.0
+
+static double ticks_ms(frame_scheduler *self, Uint64 ticks)
+{
+	return (double)ticks * 1000.0 / (double)self->freq;
+}
+
+void frame_scheduler_init(frame_scheduler *self, frame_sched_mode mode, double fps)
+{
+	memset(self, 0, sizeof(frame_scheduler));
+	self->freq = SDL_GetPerformanceFrequency();
+	self->spin = (Uint64)(SPIN_MS * self->freq / 1000.0);
+	self->start = SDL_GetPerformanceCounter();
+	frame_scheduler_set_mode(self, mode, fps);
+}
+
+void frame_scheduler_set_mode(frame_scheduler *self, frame_sched_mode mode, double fps)
+{
+	if (mode == FRAME_SCHED_FIXED && fps <= 0.0) {
+		mode = FRAME_SCHED_UNCAPPED;
+	}
+	self->mode = mode;
+	self->period = mode == FRAME_SCHED_FIXED ? (Uint64)(self->freq / fps) : 0;
+	self->deadline = SDL_GetPerformanceCounter();
+	self->redraw = true;
+}
+
+bool frame_scheduler_parse(const char *str, frame_sched_mode *rmode, double *rfps)
+{
+	*rfps = 0.0;
+	if (strcmp(str, "uncapped") == 0) {
+		*rmode = FRAME_SCHED_UNCAPPED;
+		return true;
+	}
+	if (strcmp(str, "event") == 0) {
+		*rmode = FRAME_SCHED_EVENT;
+		return true;
+	}
+	*rfps = atof(str);
+	*rmode = FRAME_SCHED_FIXED;
+	return *rfps > 0.0;
+}
+
+// 0 polls, negative waits for as long as it takes
+static bool wake_try(SDL_sem *wake, int timeout_ms)
+{
+	if (timeout_ms == 0) {
+		return SDL_SemTryWait(wake) == 0;
+	}
+	int result = timeout_ms < 0 ? SDL_SemWait(wake) : SDL_SemWaitTimeout(wake, timeout_ms);
+	return result == 0;
+}
+
+static bool wait_wake(frame_scheduler *self, SDL_sem *wake, int timeout_ms)
+{
+	Uint64 start = SDL_GetPerformanceCounter();
+	bool got = wake_try(wake, timeout_ms);
+	self->idle += SDL_GetPerformanceCounter() - start;
+	if (got) {
+		self->redraw = true;
+	}
+	return got;
+}
+
+bool frame_scheduler_next_wake(frame_scheduler *self, SDL_sem *wake, bool can_draw)
+{
+	if (wake_try(wake, 0)) {
+		self->redraw = true;
+		return true;
+	}
+	if (!can_draw) {
+		return wait_wake(self, wake, -1);
+	}
+
+	switch (self->mode) {
+	case FRAME_SCHED_UNCAPPED:
+		return false;
+	case FRAME_SCHED_EVENT:
+		return self->redraw ? false : wait_wake(self, wake, -1);
+	case FRAME_SCHED_FIXED:
+		break;
+	}
+
+	Uint64 now = SDL_GetPerformanceCounter();
+	if (now >= self->deadline) {
+		return false;
+	}
+	Uint64 remaining = self->deadline - now;
+	if (remaining > self->spin) {
+		int timeout_ms = (int)ticks_ms(self, remaining - self->spin);
+		if (timeout_ms > 0 && wait_wake(self, wake, timeout_ms)) {
+			return true;
+		}
+	}
+
+	// wake ups still end the spin early so input is never held back
+	Uint64 spin_start = SDL_GetPerformanceCounter();
+	bool got = false;
+	while (SDL_GetPerformanceCounter() < self->deadline) {
+		if (wake_try(wake, 0)) {
+			self->redraw = true;
+			got = true;
+			break;
+		}
+	}
+	self->spinning += SDL_GetPerformanceCounter() - spin_start;
+	return got;
+}
+
+void frame_scheduler_request_redraw(frame_scheduler *self)
+{
+	self->redraw = true;
+}
+
+void frame_scheduler_frame_done(frame_scheduler *self)
+{
+	self->frames++;
+	self->redraw = false;
+	if (self->mode != FRAME_SCHED_FIXED) {
+		return;
+	}
+
+	// keep the cadence, but a late frame doesn't earn a burst of catch-up ones
+	self->deadline += self->period;
+	Uint64 now = SDL_GetPerformanceCounter();
+	if (self->deadline < now) {
+		self->deadline = now;
+	}
+}
+
+void frame_scheduler_get_stats(frame_scheduler *self, frame_sched_stats *rstats)
+{
+	rstats->frames = self->frames;
+	rstats->wall_ms = ticks_ms(self, SDL_GetPerformanceCounter() - self->start);
+	rstats->idle_ms = ticks_ms(self, self->idle);
+	rstats->spin_ms = ticks_ms(self, self->spinning);
+}
+
+void frame_scheduler_write(frame_scheduler *self, FILE *file)
+{
+	frame_sched_stats stats;
+	frame_scheduler_get_stats(self, &stats);
+	double idle_share = stats.wall_ms > 0.0 ? stats.idle_ms / stats.wall_ms : 0.0;
+	fprintf(file,
+		"{\"frames\":%llu,\"wall_ms\":%.1f,\"idle_ms\":%.1f,\"spin_ms\":%.1f,"
+		"\"idle_share\":%.4f}\n",
+		(unsigned long long)stats.frames, stats.wall_ms, stats.idle_ms,
+		stats.spin_ms, idle_share);
+}
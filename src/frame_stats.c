@@ -0,0 +1,139 @@
+#include "frame_stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char *stat_names[FRAME_STAT_COUNT] = {
+	"wait", "housekeeping", "acquire", "record",
+	"submit", "present", "cpu", "frame",
+};
+
+static int compare_float(const void *a, const void *b)
+{
+	float fa = *(const float *)a;
+	float fb = *(const float *)b;
+	return (fa > fb) - (fa < fb);
+}
+
+// nearest rank on sorted samples
+static double percentile(const float *sorted, Uint32 count, double p)
+{
+	Uint32 rank = (Uint32)(p * count + 0.999999);
+	if (rank == 0) {
+		rank = 1;
+	}
+	if (rank > count) {
+		rank = count;
+	}
+	return sorted[rank - 1];
+}
+
+void frame_stats_init(frame_stats *self)
+{
+	memset(self, 0, sizeof(frame_stats));
+}
+
+void frame_stats_destroy(frame_stats *self)
+{
+	if (self->dump_owned) {
+		fclose(self->dump);
+	}
+	self->dump = NULL;
+}
+
+const char *frame_stat_name(frame_stat stat)
+{
+	return stat < FRAME_STAT_COUNT ? stat_names[stat] : "unknown";
+}
+
+void frame_stats_add(frame_stats *self, frame_stat stat, double ms)
+{
+	frame_stat_window *window = &self->windows[stat];
+	window->ms[window->next] = (float)ms;
+	window->next = (window->next + 1) % FRAME_STATS_WINDOW;
+	if (window->count < FRAME_STATS_WINDOW) {
+		window->count++;
+	}
+}
+
+void frame_stats_summary(frame_stats *self, frame_stat stat,
+			 frame_stat_summary *rsummary)
+{
+	memset(rsummary, 0, sizeof(frame_stat_summary));
+	frame_stat_window *window = &self->windows[stat];
+	if (window->count == 0) {
+		return;
+	}
+
+	// the ring holds the window unordered, sort a copy
+	float sorted[FRAME_STATS_WINDOW];
+	memcpy(sorted, window->ms, sizeof(float) * window->count);
+	qsort(sorted, window->count, sizeof(float), compare_float);
+
+	double sum = 0.0;
+	for (Uint32 i = 0; i < window->count; i++) {
+		sum += sorted[i];
+	}
+	rsummary->samples = window->count;
+	rsummary->mean = sum / window->count;
+	rsummary->p50 = percentile(sorted, window->count, 0.50);
+	rsummary->p95 = percentile(sorted, window->count, 0.95);
+	rsummary->p99 = percentile(sorted, window->count, 0.99);
+	rsummary->max = sorted[window->count - 1];
+}
+
+bool frame_stats_dump_to(frame_stats *self, const char *path, double interval_ms)
+{
+	frame_stats_destroy(self);
+	self->dump_owned = false;
+	self->dump_interval_ms = interval_ms;
+	if (interval_ms <= 0.0) {
+		return true;
+	}
+
+	if (path == NULL) {
+		self->dump = stdout;
+		return true;
+	}
+	self->dump = fopen(path, "a");
+	if (self->dump == NULL) {
+		fprintf(stderr, "Error opening frame stats file %s\n", path);
+		return false;
+	}
+	self->dump_owned = true;
+	return true;
+}
+
+void frame_stats_end_frame(frame_stats *self, double now_ms)
+{
+	self->frames++;
+	if (self->dump == NULL) {
+		return;
+	}
+	if (self->last_dump_ms == 0.0) {
+		self->last_dump_ms = now_ms;
+		return;
+	}
+	if (now_ms - self->last_dump_ms < self->dump_interval_ms) {
+		return;
+	}
+
+	self->last_dump_ms = now_ms;
+	frame_stats_write(self, self->dump);
+	fflush(self->dump);
+}
+
+void frame_stats_write(frame_stats *self, FILE *file)
+{
+	fprintf(file, "{\"frames\":%llu", (unsigned long long)self->frames);
+	for (Uint32 i = 0; i < FRAME_STAT_COUNT; i++) {
+		frame_stat_summary summary;
+		frame_stats_summary(self, i, &summary);
+		fprintf(file,
+			",\"%s_ms\":{\"p50\":%.3f,\"p95\":%.3f,\"p99\":%.3f,"
+			"\"max\":%.3f,\"mean\":%.3f,\"samples\":%u}",
+			stat_names[i], summary.p50, summary.p95, summary.p99, summary.max,
+			summary.mean, summary.samples);
+	}
+	fprintf(file, "}\n");
+}
@@ -0,0 +1,188 @@
+#include "jobs.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+// Caller holds the lock, which is released while the job runs.
+static void run_job(job_system *self, job next)
+{
+	self->active++;
+
+	SDL_UnlockMutex(self->lock);
+	next.fn(next.data);
+	SDL_LockMutex(self->lock);
+
+	self->active--;
+	if (next.group != NULL && --next.group->pending == 0) {
+		SDL_CondBroadcast(self->group_done);
+	}
+	if (self->count == 0 && self->active == 0) {
+		SDL_CondBroadcast(self->idle);
+	}
+}
+
+static int worker_main(void *data)
+{
+	job_system *self = data;
+
+	SDL_LockMutex(self->lock);
+	for (;;) {
+		while (self->count == 0 && !self->quit) {
+			SDL_CondWait(self->has_work, self->lock);
+		}
+		if (self->count == 0 && self->quit) {
+			break;
+		}
+
+		job next = self->queue[self->head];
+		self->head = (self->head + 1) % self->cap;
+		self->count--;
+		run_job(self, next);
+	}
+	SDL_UnlockMutex(self->lock);
+
+	return 0;
+}
+
+// Caller holds the lock. Takes the first queued job of `group` out of the
+// queue, keeping the order of the others.
+static bool take_group_job(job_system *self, job_group *group, job *rjob)
+{
+	for (Uint32 i = 0; i < self->count; i++) {
+		if (self->queue[(self->head + i) % self->cap].group != group) {
+			continue;
+		}
+		*rjob = self->queue[(self->head + i) % self->cap];
+		// group jobs sit at the front, so this shift is short
+		for (Uint32 j = i; j > 0; j--) {
+			self->queue[(self->head + j) % self->cap] =
+				self->queue[(self->head + j - 1) % self->cap];
+		}
+		self->head = (self->head + 1) % self->cap;
+		self->count--;
+		return true;
+	}
+	return false;
+}
+
+void job_system_init(job_system *self, Uint32 thread_count)
+{
+	if (thread_count == 0) {
+		int cpus = SDL_GetCPUCount();
+		thread_count = cpus > 1 ? cpus - 1 : 1;
+	}
+
+	self->thread_count = thread_count;
+	self->lock = SDL_CreateMutex();
+	self->has_work = SDL_CreateCond();
+	self->idle = SDL_CreateCond();
+	self->group_done = SDL_CreateCond();
+	self->cap = 64;
+	self->queue = malloc(sizeof(job) * self->cap);
+	self->head = 0;
+	self->count = 0;
+	self->active = 0;
+	self->quit = false;
+
+	self->threads = malloc(sizeof(SDL_Thread *) * thread_count);
+	for (Uint32 i = 0; i < thread_count; i++) {
+		self->threads[i] = SDL_CreateThread(worker_main, "worker", self);
+		if (self->threads[i] == NULL) {
+			fprintf(stderr, "Error creating worker thread: %s\n",
+				SDL_GetError());
+		}
+	}
+}
+
+void job_system_destroy(job_system *self)
+{
+	SDL_LockMutex(self->lock);
+	self->quit = true;
+	SDL_CondBroadcast(self->has_work);
+	SDL_UnlockMutex(self->lock);
+
+	for (Uint32 i = 0; i < self->thread_count; i++) {
+		if (self->threads[i] != NULL) {
+			SDL_WaitThread(self->threads[i], NULL);
+		}
+	}
+
+	free(self->threads);
+	free(self->queue);
+	SDL_DestroyCond(self->group_done);
+	SDL_DestroyCond(self->idle);
+	SDL_DestroyCond(self->has_work);
+	SDL_DestroyMutex(self->lock);
+}
+
+// Caller holds the lock.
+static void grow_queue(job_system *self)
+{
+	if (self->count < self->cap) {
+		return;
+	}
+
+	// unroll the ring into a bigger one
+	job *queue = malloc(sizeof(job) * self->cap * 2);
+	for (Uint32 i = 0; i < self->count; i++) {
+		queue[i] = self->queue[(self->head + i) % self->cap];
+	}
+	free(self->queue);
+	self->queue = queue;
+	self->head = 0;
+	self->cap *= 2;
+}
+
+void job_system_push(job_system *self, job_fn fn, void *data)
+{
+	SDL_LockMutex(self->lock);
+	grow_queue(self);
+
+	job *slot = &self->queue[(self->head + self->count) % self->cap];
+	slot->fn = fn;
+	slot->data = data;
+	slot->group = NULL;
+	self->count++;
+
+	SDL_CondSignal(self->has_work);
+	SDL_UnlockMutex(self->lock);
+}
+
+void job_system_push_group(job_system *self, job_group *group, job_fn fn, void *data)
+{
+	SDL_LockMutex(self->lock);
+	grow_queue(self);
+
+	self->head = (self->head + self->cap - 1) % self->cap;
+	job *slot = &self->queue[self->head];
+	slot->fn = fn;
+	slot->data = data;
+	slot->group = group;
+	self->count++;
+	group->pending++;
+
+	SDL_CondSignal(self->has_work);
+	SDL_UnlockMutex(self->lock);
+}
+
+void job_system_wait(job_system *self)
+{
+	SDL_LockMutex(self->lock);
+	while (self->count > 0 || self->active > 0) {
+		SDL_CondWait(self->idle, self->lock);
+	}
+	SDL_UnlockMutex(self->lock);
+}
+
+void job_system_wait_group(job_system *self, job_group *group)
+{
+	SDL_LockMutex(self->lock);
+	job next;
+	while (take_group_job(self, group, &next)) {
+		run_job(self, next);
+	}
+	while (group->pending > 0) {
+		SDL_CondWait(self->group_done, self->lock);
+	}
+	SDL_UnlockMutex(self->lock);
+}
@@ -1,49 +1,115 @@
 #include <stdlib.h>
+#include <string.h>
 #include "vk/vk_engine.h"
+#include "render_thread.h"
 
 #define SCREEN_WIDTH 1700
 #define SCREEN_HEIGHT 900
+#define DEFAULT_FPS 60.0
+
+static const vertex TRIANGLE_VERTICES[3] = {
+	{ { 0.0f, -0.5f }, { 1.0f, 0.0f, 0.0f } },
+	{ { 0.5f, 0.5f }, { 0.0f, 1.0f, 0.0f } },
+	{ { -0.5f, 0.5f }, { 0.0f, 0.0f, 1.0f } },
+};
+static const Uint32 TRIANGLE_INDICES[3] = { 0, 1, 2 };
 
 int main(int argc, char *argv[])
 {
-	SDL_Init(SDL_INIT_VIDEO);
-	SDL_WindowFlags win_flags = (SDL_WindowFlags)(SDL_WINDOW_VULKAN);
-	SDL_Window *win = SDL_CreateWindow("Vulkan Engine", SDL_WINDOWPOS_UNDEFINED,
-					   SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH,
-					   SCREEN_HEIGHT, win_flags);
-
+	// render that many frames offscreen and exit, no display needed
+	const char *headless_frames = SDL_getenv("HEADLESS");
+	SDL_Window *win = NULL;
 	vulkan_engine engine;
-	vulkan_engine_init(&engine, win);
+	if (headless_frames != NULL) {
+		SDL_Init(0);
+		vulkan_engine_init_headless(&engine, SCREEN_WIDTH, SCREEN_HEIGHT);
+	} else {
+		SDL_Init(SDL_INIT_VIDEO);
+		SDL_WindowFlags win_flags = (SDL_WindowFlags)(SDL_WINDOW_VULKAN);
+		win = SDL_CreateWindow("Vulkan Engine", SDL_WINDOWPOS_UNDEFINED,
+				       SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH,
+				       SCREEN_HEIGHT, win_flags);
+		vulkan_engine_init(&engine, win);
+	}
+	// lower latency with 1, more CPU/GPU overlap with up to 4
+	const char *frames_in_flight = SDL_getenv("FRAMES_IN_FLIGHT");
+	if (frames_in_flight != NULL) {
+		vulkan_engine_set_frames_in_flight(&engine, atoi(frames_in_flight));
+	}
+	// frame time percentiles every second, "-" for stdout
+	const char *stats_path = SDL_getenv("FRAME_STATS");
+	if (stats_path != NULL) {
+		vulkan_engine_dump_frame_stats(
+			&engine, strcmp(stats_path, "-") == 0 ? NULL : stats_path, 1000.0);
+	}
+	// every frame as a PNG, e.g. CAPTURE=frames/%06llu.png
+	const char *capture_pattern = SDL_getenv("CAPTURE");
+	if (capture_pattern != NULL) {
+		vulkan_engine_capture_sequence(&engine, capture_pattern);
+	}
+	// Chrome trace of the whole run, open it in ui.perfetto.dev
+	const char *trace_path = SDL_getenv("TRACE");
+	if (trace_path != NULL) {
+		vulkan_engine_start_trace(&engine);
+	}
+
+	Uint32 triangle = vulkan_engine_add_mesh(&engine, TRIANGLE_VERTICES, 3,
+						 TRIANGLE_INDICES, 3);
+	instance_data instance;
+	glm_mat4_identity(instance.model);
+	glm_vec4_one(instance.color);
+	vulkan_engine_add_object(&engine, triangle, &instance, 0.75f);
+
+	// FRAME_LIMIT=<fps>, "event" to draw only when something happens, or
+	// "uncapped"
+	frame_sched_mode sched_mode = FRAME_SCHED_FIXED;
+	double fps = DEFAULT_FPS;
+	const char *frame_limit = SDL_getenv("FRAME_LIMIT");
+	if (frame_limit != NULL && !frame_scheduler_parse(frame_limit, &sched_mode, &fps)) {
+		fprintf(stderr, "Unknown FRAME_LIMIT %s, using %.0f fps\n", frame_limit,
+			DEFAULT_FPS);
+		sched_mode = FRAME_SCHED_FIXED;
+		fps = DEFAULT_FPS;
+	}
 
-	SDL_Event e;
-	bool quit = false;
-	bool minimized = false;
-	while (!quit) {
-		while (SDL_PollEvent(&e) != 0) {
+	if (headless_frames != NULL) {
+		int frames = atoi(headless_frames);
+		for (int i = 0; i < frames; i++) {
+			vulkan_engine_draw_frame(&engine);
+		}
+	} else {
+		// the engine belongs to the render thread until it is stopped,
+		// this thread only forwards events
+		render_thread renderer;
+		render_thread_start(&renderer, &engine, sched_mode, fps);
+
+		SDL_Event e;
+		bool quit = false;
+		while (!quit) {
+			if (!SDL_WaitEvent(&e)) {
+				continue;
+			}
 			if (e.type == SDL_QUIT) {
 				quit = true;
-			} else if (e.type == SDL_WINDOWEVENT) {
-				// int newWidth = e.window.data1;
-				// int newHeight = e.window.data2;
-				switch (e.window.event) {
-				case SDL_WINDOWEVENT_RESIZED:
-					engine.fb_resized_flag = true;
-					break;
-				case SDL_WINDOWEVENT_MINIMIZED:
-					minimized = true;
-					break;
-				case SDL_WINDOWEVENT_RESTORED:
-					minimized = false;
-					break;
-				}
+			} else {
+				render_thread_send_event(&renderer, &e);
 			}
 		}
-		if (!minimized) {
-			vulkan_engine_draw_frame(&engine);
+		render_thread_stop(&renderer);
+
+		// how much of the run the render loop spent blocked
+		if (stats_path != NULL) {
+			frame_scheduler_write(&renderer.sched, stderr);
 		}
 	}
 
+	if (trace_path != NULL) {
+		vulkan_engine_write_trace(&engine, trace_path);
+	}
 	vulkan_engine_cleanup(&engine);
-	SDL_DestroyWindow(win);
+	if (win != NULL) {
+		SDL_DestroyWindow(win);
+	}
+	SDL_Quit();
 	return EXIT_SUCCESS;
 }
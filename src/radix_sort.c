@@ -0,0 +1,59 @@
+#include "radix_sort.h"
+
+#include <string.h>
+
+#define RADIX_PASSES 8
+
+void radix_sort_u64(Uint64 *keys, Uint32 *values, Uint64 *tmp_keys,
+		    Uint32 *tmp_values, Uint32 count)
+{
+	if (count < 2) {
+		return;
+	}
+
+	// every pass's histogram in one read of the keys
+	Uint32 histograms[RADIX_PASSES][256];
+	memset(histograms, 0, sizeof(histograms));
+	for (Uint32 i = 0; i < count; i++) {
+		Uint64 key = keys[i];
+		for (Uint32 pass = 0; pass < RADIX_PASSES; pass++) {
+			histograms[pass][(key >> (pass * 8)) & 0xff]++;
+		}
+	}
+
+	Uint64 *src_keys = keys;
+	Uint32 *src_values = values;
+	Uint64 *dst_keys = tmp_keys;
+	Uint32 *dst_values = tmp_values;
+	for (Uint32 pass = 0; pass < RADIX_PASSES; pass++) {
+		Uint32 *histogram = histograms[pass];
+		Uint32 shift = pass * 8;
+		if (histogram[(src_keys[0] >> shift) & 0xff] == count) {
+			continue;
+		}
+
+		Uint32 offset = 0;
+		for (Uint32 i = 0; i < 256; i++) {
+			Uint32 n = histogram[i];
+			histogram[i] = offset;
+			offset += n;
+		}
+		for (Uint32 i = 0; i < count; i++) {
+			Uint32 dst = histogram[(src_keys[i] >> shift) & 0xff]++;
+			dst_keys[dst] = src_keys[i];
+			dst_values[dst] = src_values[i];
+		}
+
+		Uint64 *swap_keys = src_keys;
+		Uint32 *swap_values = src_values;
+		src_keys = dst_keys;
+		src_values = dst_values;
+		dst_keys = swap_keys;
+		dst_values = swap_values;
+	}
+
+	if (src_keys != keys) {
+		memcpy(keys, src_keys, sizeof(Uint64) * count);
+		memcpy(values, src_values, sizeof(Uint32) * count);
+	}
+}
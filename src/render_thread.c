@@ -0,0 +1,123 @@
+#include "render_thread.h"
+
+#include <string.h>
+
+static void apply_command(render_thread *self, const render_cmd *cmd)
+{
+	switch (cmd->type) {
+	case RENDER_CMD_RESIZE:
+		self->engine->fb_resized_flag = true;
+		break;
+	case RENDER_CMD_MINIMIZED:
+		self->minimized = true;
+		break;
+	case RENDER_CMD_RESTORED:
+		self->minimized = false;
+		break;
+	case RENDER_CMD_INPUT:
+		frame_scheduler_request_redraw(&self->sched);
+		break;
+	case RENDER_CMD_CALL:
+		cmd->call.fn(self->engine, cmd->call.data);
+		frame_scheduler_request_redraw(&self->sched);
+		break;
+	case RENDER_CMD_QUIT:
+		self->quit = true;
+		break;
+	}
+}
+
+static int render_main(void *data)
+{
+	render_thread *self = data;
+
+	while (!self->quit) {
+		render_cmd cmd;
+		while (spsc_queue_pop(&self->commands, &cmd)) {
+			apply_command(self, &cmd);
+		}
+		if (self->quit) {
+			break;
+		}
+		// woken up by a command: apply it before deciding to draw
+		if (frame_scheduler_next_wake(&self->sched, self->wake, !self->minimized)) {
+			continue;
+		}
+		vulkan_engine_draw_frame(self->engine);
+		frame_scheduler_frame_done(&self->sched);
+	}
+
+	return 0;
+}
+
+void render_thread_start(render_thread *self, vulkan_engine *engine,
+			 frame_sched_mode mode, double fps)
+{
+	memset(self, 0, sizeof(render_thread));
+	self->engine = engine;
+	frame_scheduler_init(&self->sched, mode, fps);
+	spsc_queue_init(&self->commands, sizeof(render_cmd), RENDER_QUEUE_SIZE);
+	self->wake = SDL_CreateSemaphore(0);
+	self->thread = SDL_CreateThread(render_main, "render", self);
+	if (self->thread == NULL) {
+		fprintf(stderr, "Error creating render thread: %s\n", SDL_GetError());
+	}
+}
+
+void render_thread_stop(render_thread *self)
+{
+	render_cmd cmd = { .type = RENDER_CMD_QUIT };
+	render_thread_send(self, &cmd);
+	SDL_WaitThread(self->thread, NULL);
+	SDL_DestroySemaphore(self->wake);
+	spsc_queue_destroy(&self->commands);
+}
+
+void render_thread_send(render_thread *self, const render_cmd *cmd)
+{
+	// the render thread drains the queue before every frame, so this is rare
+	while (!spsc_queue_push(&self->commands, cmd)) {
+		SDL_Delay(1);
+	}
+	SDL_SemPost(self->wake);
+}
+
+bool render_thread_send_event(render_thread *self, const SDL_Event *event)
+{
+	render_cmd cmd;
+	memset(&cmd, 0, sizeof(render_cmd));
+	switch (event->type) {
+	case SDL_WINDOWEVENT:
+		switch (event->window.event) {
+		case SDL_WINDOWEVENT_RESIZED:
+			cmd.type = RENDER_CMD_RESIZE;
+			break;
+		case SDL_WINDOWEVENT_MINIMIZED:
+			cmd.type = RENDER_CMD_MINIMIZED;
+			break;
+		case SDL_WINDOWEVENT_RESTORED:
+			cmd.type = RENDER_CMD_RESTORED;
+			break;
+		case SDL_WINDOWEVENT_EXPOSED:
+			cmd.type = RENDER_CMD_INPUT;
+			break;
+		default:
+			return false;
+		}
+		break;
+	case SDL_KEYDOWN:
+	case SDL_KEYUP:
+	case SDL_MOUSEMOTION:
+	case SDL_MOUSEBUTTONDOWN:
+	case SDL_MOUSEBUTTONUP:
+	case SDL_MOUSEWHEEL:
+		cmd.type = RENDER_CMD_INPUT;
+		break;
+	default:
+		return false;
+	}
+
+	cmd.event = *event;
+	render_thread_send(self, &cmd);
+	return true;
+}
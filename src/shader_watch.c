@@ -0,0 +1,191 @@
+#include "shader_watch.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <spawn.h>
+#include <sys/inotify.h>
+#include <sys/wait.h>
+#endif
+
+#ifdef __linux__
+extern char **environ;
+
+static bool run_glslc(const shader_source *source, const char *dir)
+{
+	char input[512];
+	char tmp_output[512];
+	char stage[64];
+	snprintf(input, sizeof(input), "%s/%s", dir, source->source);
+	snprintf(tmp_output, sizeof(tmp_output), "%s.tmp", source->output);
+	snprintf(stage, sizeof(stage), "-fshader-stage=%s", source->stage);
+
+	char *argv[] = { "glslc", stage, input, "-o", tmp_output, NULL };
+	pid_t pid;
+	int err = posix_spawnp(&pid, "glslc", NULL, NULL, argv, environ);
+	if (err != 0) {
+		fprintf(stderr, "Error running glslc: %s\n", strerror(err));
+		return false;
+	}
+
+	int status = 0;
+	while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		// glslc already printed the diagnostics
+		remove(tmp_output);
+		return false;
+	}
+
+	if (rename(tmp_output, source->output) != 0) {
+		fprintf(stderr, "Error replacing %s\n", source->output);
+		return false;
+	}
+	return true;
+}
+
+static void compile_job(void *data)
+{
+	shader_compile *compile = data;
+	shader_watch *self = compile->owner;
+
+	for (;;) {
+		bool ok = run_glslc(compile->source, self->dir);
+
+		SDL_LockMutex(self->lock);
+		if (compile->again) {
+			compile->again = false;
+			SDL_UnlockMutex(self->lock);
+			continue;
+		}
+		compile->busy = false;
+		bool listed = false;
+		for (Uint32 i = 0; i < self->done_count; i++) {
+			listed = listed || self->done[i] == compile->source;
+		}
+		if (ok && !listed) {
+			self->done[self->done_count++] = compile->source;
+		}
+		SDL_UnlockMutex(self->lock);
+		break;
+	}
+}
+
+static void queue_compile(shader_watch *self, const char *name)
+{
+	for (Uint32 i = 0; i < self->source_count; i++) {
+		shader_compile *compile = &self->compiles[i];
+		if (strcmp(compile->source->source, name) != 0) {
+			continue;
+		}
+
+		SDL_LockMutex(self->lock);
+		if (compile->busy) {
+			compile->again = true;
+		} else {
+			compile->busy = true;
+			job_system_push(self->jobs, compile_job, compile);
+		}
+		SDL_UnlockMutex(self->lock);
+	}
+}
+
+bool shader_watch_init(shader_watch *self, const char *dir,
+		       const shader_source *sources, Uint32 source_count,
+		       job_system *jobs)
+{
+	memset(self, 0, sizeof(shader_watch));
+	self->fd = -1;
+
+	int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0) {
+		fprintf(stderr, "Error creating inotify instance: %s\n", strerror(errno));
+		return false;
+	}
+	// editors either rewrite in place or rename a temp file over the source
+	if (inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		fprintf(stderr, "Error watching %s: %s\n", dir, strerror(errno));
+		close(fd);
+		return false;
+	}
+
+	self->fd = fd;
+	self->dir = dir;
+	self->jobs = jobs;
+	self->source_count = source_count;
+	self->lock = SDL_CreateMutex();
+	self->compiles = malloc(sizeof(shader_compile) * source_count);
+	self->done = malloc(sizeof(shader_source *) * source_count);
+	for (Uint32 i = 0; i < source_count; i++) {
+		self->compiles[i].owner = self;
+		self->compiles[i].source = &sources[i];
+		self->compiles[i].busy = false;
+		self->compiles[i].again = false;
+	}
+
+	return true;
+}
+
+void shader_watch_destroy(shader_watch *self)
+{
+	if (self->fd < 0) {
+		return;
+	}
+	close(self->fd);
+	free(self->compiles);
+	free(self->done);
+	SDL_DestroyMutex(self->lock);
+}
+
+Uint32 shader_watch_poll(shader_watch *self, const shader_source **rchanged,
+			 Uint32 max)
+{
+	if (self->fd < 0) {
+		return 0;
+	}
+
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t len;
+	while ((len = read(self->fd, buf, sizeof(buf))) > 0) {
+		for (char *ptr = buf; ptr < buf + len;) {
+			struct inotify_event *event = (struct inotify_event *)ptr;
+			if (event->len > 0) {
+				queue_compile(self, event->name);
+			}
+			ptr += sizeof(struct inotify_event) + event->len;
+		}
+	}
+
+	SDL_LockMutex(self->lock);
+	Uint32 count = self->done_count < max ? self->done_count : max;
+	memcpy(rchanged, self->done, sizeof(shader_source *) * count);
+	memmove(self->done, self->done + count,
+		sizeof(shader_source *) * (self->done_count - count));
+	self->done_count -= count;
+	SDL_UnlockMutex(self->lock);
+
+	return count;
+}
+#else
+bool shader_watch_init(shader_watch *self, const char *dir,
+		       const shader_source *sources, Uint32 source_count,
+		       job_system *jobs)
+{
+	memset(self, 0, sizeof(shader_watch));
+	self->fd = -1;
+	return false;
+}
+
+void shader_watch_destroy(shader_watch *self)
+{
+}
+
+Uint32 shader_watch_poll(shader_watch *self, const shader_source **rchanged,
+			 Uint32 max)
+{
+	return 0;
+}
+#endif
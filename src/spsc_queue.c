@@ -0,0 +1,63 @@
+#include "spsc_queue.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void spsc_queue_init(spsc_queue *self, Uint32 item_size, Uint32 capacity)
+{
+	memset(self, 0, sizeof(spsc_queue));
+	Uint32 size = 2;
+	while (size < capacity + 1) {
+		size *= 2;
+	}
+	self->mask = size - 1;
+	self->item_size = item_size;
+	self->items = malloc((size_t)item_size * size);
+	SDL_AtomicSet(&self->head, 0);
+	SDL_AtomicSet(&self->tail, 0);
+}
+
+void spsc_queue_destroy(spsc_queue *self)
+{
+	free(self->items);
+	self->items = NULL;
+}
+
+// The item is written before the head is published and read before the tail
+// is. SDL_AtomicSet is only an acquire barrier on some compilers, so each
+// side publishes its index after a release barrier and reads the other's
+// before an acquire barrier; the two sides never touch the same slot at once.
+bool spsc_queue_push(spsc_queue *self, const void *item)
+{
+	Uint32 head = (Uint32)SDL_AtomicGet(&self->head);
+	Uint32 next = (head + 1) & self->mask;
+	Uint32 tail = (Uint32)SDL_AtomicGet(&self->tail);
+	// the consumer is done reading the slot before we overwrite it
+	SDL_MemoryBarrierAcquire();
+	if (next == tail) {
+		return false;
+	}
+
+	memcpy(&self->items[(size_t)head * self->item_size], item, self->item_size);
+	// the item is visible before the head that covers it
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&self->head, (int)next);
+	return true;
+}
+
+bool spsc_queue_pop(spsc_queue *self, void *ritem)
+{
+	Uint32 tail = (Uint32)SDL_AtomicGet(&self->tail);
+	Uint32 head = (Uint32)SDL_AtomicGet(&self->head);
+	// the item's bytes are read after the head that published them
+	SDL_MemoryBarrierAcquire();
+	if (tail == head) {
+		return false;
+	}
+
+	memcpy(ritem, &self->items[(size_t)tail * self->item_size], self->item_size);
+	// the read is done before the producer may reuse the slot
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&self->tail, (int)((tail + 1) & self->mask));
+	return true;
+}
@@ -0,0 +1,399 @@
+#include "vk/vk_capture.h"
+#include <vulkan/vk_enum_string_helper.h>
+#include <SDL2/SDL_image.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void vk_capture_init(vk_capture *self, vk_mem_allocator *allocator, VkDevice log_dev,
+		     Uint32 queue_family, Uint32 frame_slots)
+{
+	memset(self, 0, sizeof(vk_capture));
+	self->log_dev = log_dev;
+	self->allocator = allocator;
+	for (Uint32 i = 0; i < VK_CAPTURE_SLOTS; i++) {
+		self->slots[i].owner = self;
+	}
+	// its own thread, so encoding never holds up recording jobs
+	job_system_init(&self->encoder, 1);
+
+	VkCommandPoolCreateInfo cp_ci;
+	memset(&cp_ci, 0, sizeof(VkCommandPoolCreateInfo));
+	cp_ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	cp_ci.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT |
+		      VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	cp_ci.queueFamilyIndex = queue_family;
+
+	VkResult result = vkCreateCommandPool(log_dev, &cp_ci, NULL, &self->command_pool);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error creating capture command pool, err: %s\n",
+			string_VkResult(result));
+	}
+
+	self->cmds = malloc(sizeof(VkCommandBuffer) * frame_slots);
+	VkCommandBufferAllocateInfo buf_alloc;
+	memset(&buf_alloc, 0, sizeof(VkCommandBufferAllocateInfo));
+	buf_alloc.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	buf_alloc.commandPool = self->command_pool;
+	buf_alloc.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	buf_alloc.commandBufferCount = frame_slots;
+
+	result = vkAllocateCommandBuffers(log_dev, &buf_alloc, self->cmds);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error allocating capture command buffers, err: %s\n",
+			string_VkResult(result));
+	}
+}
+
+void vk_capture_destroy(vk_capture *self)
+{
+	job_system_destroy(&self->encoder);
+	for (Uint32 i = 0; i < VK_CAPTURE_SLOTS; i++) {
+		vk_capture_slot *slot = &self->slots[i];
+		if (slot->buffer != VK_NULL_HANDLE) {
+			vk_mem_destroy_buffer(self->allocator, slot->buffer, &slot->alloc);
+		}
+	}
+	vkDestroyCommandPool(self->log_dev, self->command_pool, NULL);
+	free(self->cmds);
+}
+
+void vk_capture_request(vk_capture *self, const char *path)
+{
+	self->requested = true;
+	self->request_path[0] = '\0';
+	if (path != NULL) {
+		SDL_strlcpy(self->request_path, path, VK_CAPTURE_PATH_LEN);
+	}
+}
+
+// Rebuilds `pattern` with its one integer conversion as %llu, keeping the
+// zero flag and width, so the frame number always matches the format.
+static bool parse_sequence(const char *pattern, char *rformat)
+{
+	size_t len = 0;
+	Uint32 conversions = 0;
+	for (const char *c = pattern; *c != '\0'; c++) {
+		char piece[32];
+		if (*c != '%') {
+			piece[0] = *c;
+			piece[1] = '\0';
+		} else if (c[1] == '%') {
+			SDL_strlcpy(piece, "%%", sizeof(piece));
+			c++;
+		} else {
+			c++;
+			bool zero = *c == '0';
+			if (zero) {
+				c++;
+			}
+			int width = 0;
+			while (*c >= '0' && *c <= '9' && width < 100) {
+				width = width * 10 + (*c++ - '0');
+			}
+			while (*c == 'h' || *c == 'l' || *c == 'j' || *c == 'z') {
+				c++;
+			}
+			if ((*c != 'd' && *c != 'i' && *c != 'u') || width > 20) {
+				return false;
+			}
+			conversions++;
+			if (width == 0) {
+				SDL_strlcpy(piece, "%llu", sizeof(piece));
+			} else {
+				const char *spec = zero ? "%%0%dllu" : "%%%dllu";
+				SDL_snprintf(piece, sizeof(piece), spec, width);
+			}
+		}
+
+		size_t piece_len = SDL_strlen(piece);
+		if (len + piece_len >= VK_CAPTURE_PATH_LEN) {
+			return false;
+		}
+		SDL_memcpy(rformat + len, piece, piece_len);
+		len += piece_len;
+	}
+	rformat[len] = '\0';
+	return conversions == 1;
+}
+
+bool vk_capture_sequence(vk_capture *self, const char *pattern)
+{
+	self->sequence[0] = '\0';
+	if (pattern == NULL) {
+		return true;
+	}
+
+	char format[VK_CAPTURE_PATH_LEN];
+	if (!parse_sequence(pattern, format)) {
+		fprintf(stderr, "Capture pattern %s needs exactly one integer "
+				"conversion, e.g. %%06llu\n",
+			pattern);
+		return false;
+	}
+	SDL_strlcpy(self->sequence, format, VK_CAPTURE_PATH_LEN);
+	return true;
+}
+
+void vk_capture_set_callback(vk_capture *self, vk_capture_fn fn, void *user)
+{
+	self->fn = fn;
+	self->user = user;
+}
+
+static bool format_supported(VkFormat format, bool *rbgra)
+{
+	switch (format) {
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+		*rbgra = false;
+		return true;
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+		*rbgra = true;
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Buffers keep their size across captures and only grow with the image.
+static bool slot_reserve(vk_capture *self, vk_capture_slot *slot, VkDeviceSize size)
+{
+	if (slot->buffer != VK_NULL_HANDLE && slot->size >= size) {
+		return true;
+	}
+	if (slot->buffer != VK_NULL_HANDLE) {
+		vk_mem_destroy_buffer(self->allocator, slot->buffer, &slot->alloc);
+		slot->buffer = VK_NULL_HANDLE;
+	}
+
+	VkBufferCreateInfo buf_info;
+	memset(&buf_info, 0, sizeof(VkBufferCreateInfo));
+	buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buf_info.size = size;
+	buf_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	// cached memory keeps the encoder's reads fast
+	VkResult result = vk_mem_create_buffer(
+		self->allocator, &buf_info,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		VK_MEMORY_PROPERTY_HOST_CACHED_BIT, &slot->buffer, &slot->alloc);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error creating capture buffer, err: %s\n",
+			string_VkResult(result));
+		slot->buffer = VK_NULL_HANDLE;
+		return false;
+	}
+	slot->size = size;
+	return true;
+}
+
+static void image_barrier(VkCommandBuffer cmd, VkImage image, VkImageLayout old_layout,
+			  VkImageLayout new_layout, VkAccessFlags src_access,
+			  VkAccessFlags dst_access, VkPipelineStageFlags src_stage,
+			  VkPipelineStageFlags dst_stage)
+{
+	VkImageMemoryBarrier barrier;
+	memset(&barrier, 0, sizeof(VkImageMemoryBarrier));
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = src_access;
+	barrier.dstAccessMask = dst_access;
+	barrier.oldLayout = old_layout;
+	barrier.newLayout = new_layout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.layerCount = 1;
+
+	vkCmdPipelineBarrier(cmd, src_stage, dst_stage, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+VkCommandBuffer vk_capture_record(vk_capture *self, Uint32 frame_slot, VkImage image,
+				  VkFormat format, VkExtent2D extent,
+				  VkImageLayout layout, Uint64 frame)
+{
+	char path[VK_CAPTURE_PATH_LEN];
+	if (self->requested) {
+		SDL_strlcpy(path, self->request_path, VK_CAPTURE_PATH_LEN);
+		self->requested = false;
+	} else if (self->sequence[0] != '\0') {
+		// built by parse_sequence, one %llu and nothing else
+		SDL_snprintf(path, VK_CAPTURE_PATH_LEN, self->sequence,
+			     (unsigned long long)frame);
+	} else {
+		return VK_NULL_HANDLE;
+	}
+	self->requests++;
+
+	bool bgra;
+	if (!format_supported(format, &bgra)) {
+		fprintf(stderr, "Capture of format %s is not supported\n",
+			string_VkFormat(format));
+		SDL_AtomicAdd(&self->failed, 1);
+		return VK_NULL_HANDLE;
+	}
+
+	vk_capture_slot *slot = &self->slots[self->next_slot];
+	if (SDL_AtomicGet(&slot->state) != VK_CAPTURE_FREE) {
+		self->dropped++;
+		return VK_NULL_HANDLE;
+	}
+	VkDeviceSize size = (VkDeviceSize)extent.width * extent.height * 4;
+	if (!slot_reserve(self, slot, size)) {
+		SDL_AtomicAdd(&self->failed, 1);
+		return VK_NULL_HANDLE;
+	}
+	self->next_slot = (self->next_slot + 1) % VK_CAPTURE_SLOTS;
+
+	slot->width = extent.width;
+	slot->height = extent.height;
+	slot->bgra = bgra;
+	slot->frame = frame;
+	SDL_strlcpy(slot->path, path, VK_CAPTURE_PATH_LEN);
+	SDL_AtomicSet(&slot->state, VK_CAPTURE_IN_FLIGHT);
+
+	VkCommandBuffer cmd = self->cmds[frame_slot];
+	vkResetCommandBuffer(cmd, 0);
+
+	VkCommandBufferBeginInfo begin_info;
+	memset(&begin_info, 0, sizeof(VkCommandBufferBeginInfo));
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	VkResult result = vkBeginCommandBuffer(cmd, &begin_info);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error begin capture command buffer, err: %s\n",
+			string_VkResult(result));
+	}
+
+	// the render graph's final layout transition, earlier in the same submit,
+	// ends at the transfer stage, so this one chains after it
+	image_barrier(cmd, image, layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		      VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+		      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+			      VK_PIPELINE_STAGE_TRANSFER_BIT,
+		      VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+	VkBufferImageCopy region;
+	memset(&region, 0, sizeof(VkBufferImageCopy));
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.layerCount = 1;
+	region.imageExtent.width = extent.width;
+	region.imageExtent.height = extent.height;
+	region.imageExtent.depth = 1;
+	vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			       slot->buffer, 1, &region);
+
+	if (layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+		image_barrier(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, layout,
+			      VK_ACCESS_TRANSFER_READ_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			      VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+	}
+
+	VkBufferMemoryBarrier host_barrier;
+	memset(&host_barrier, 0, sizeof(VkBufferMemoryBarrier));
+	host_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	host_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	host_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	host_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	host_barrier.buffer = slot->buffer;
+	host_barrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			     VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL, 1, &host_barrier, 0,
+			     NULL);
+
+	result = vkEndCommandBuffer(cmd);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error with recording capture command buffer, err: %s\n",
+			string_VkResult(result));
+	}
+	return cmd;
+}
+
+// encoder thread
+static void encode_slot(void *data)
+{
+	vk_capture_slot *slot = data;
+	vk_capture *self = slot->owner;
+
+	// swizzle in place and drop the swapchain's alpha, nothing else reads it
+	Uint8 *pixels = slot->alloc.mapped;
+	Uint32 count = slot->width * slot->height;
+	for (Uint32 i = 0; i < count; i++) {
+		Uint8 *px = &pixels[i * 4];
+		if (slot->bgra) {
+			Uint8 b = px[0];
+			px[0] = px[2];
+			px[2] = b;
+		}
+		px[3] = 255;
+	}
+
+	if (self->fn != NULL) {
+		self->fn(self->user, slot->frame, pixels, slot->width, slot->height);
+	}
+	if (slot->path[0] != '\0') {
+		SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormatFrom(
+			pixels, slot->width, slot->height, 32, slot->width * 4,
+			SDL_PIXELFORMAT_RGBA32);
+		if (surface != NULL && IMG_SavePNG(surface, slot->path) == 0) {
+			SDL_AtomicAdd(&self->written, 1);
+		} else {
+			fprintf(stderr, "Error writing capture %s: %s\n", slot->path,
+				SDL_GetError());
+			SDL_AtomicAdd(&self->failed, 1);
+		}
+		SDL_FreeSurface(surface);
+	}
+
+	SDL_AtomicSet(&slot->state, VK_CAPTURE_FREE);
+}
+
+void vk_capture_poll(vk_capture *self, Uint64 frames_completed)
+{
+	for (Uint32 i = 0; i < VK_CAPTURE_SLOTS; i++) {
+		vk_capture_slot *slot = &self->slots[i];
+		if (SDL_AtomicGet(&slot->state) != VK_CAPTURE_IN_FLIGHT ||
+		    slot->frame >= frames_completed) {
+			continue;
+		}
+		SDL_AtomicSet(&slot->state, VK_CAPTURE_ENCODING);
+		job_system_push(&self->encoder, encode_slot, slot);
+	}
+}
+
+void vk_capture_cancel(vk_capture *self, Uint64 frame)
+{
+	for (Uint32 i = 0; i < VK_CAPTURE_SLOTS; i++) {
+		vk_capture_slot *slot = &self->slots[i];
+		if (SDL_AtomicGet(&slot->state) != VK_CAPTURE_IN_FLIGHT ||
+		    slot->frame != frame) {
+			continue;
+		}
+		SDL_AtomicSet(&slot->state, VK_CAPTURE_FREE);
+		SDL_AtomicAdd(&self->failed, 1);
+	}
+}
+
+Uint32 vk_capture_pending(vk_capture *self)
+{
+	Uint32 pending = 0;
+	for (Uint32 i = 0; i < VK_CAPTURE_SLOTS; i++) {
+		if (SDL_AtomicGet(&self->slots[i].state) != VK_CAPTURE_FREE) {
+			pending++;
+		}
+	}
+	return pending;
+}
+
+void vk_capture_get_stats(vk_capture *self, vk_capture_stats *rstats)
+{
+	rstats->requested = self->requests;
+	rstats->dropped = self->dropped;
+	rstats->written = SDL_AtomicGet(&self->written);
+	rstats->failed = SDL_AtomicGet(&self->failed);
+}
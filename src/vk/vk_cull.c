@@ -0,0 +1,443 @@
+#include "vk/vk_cull.h"
+#include <vulkan/vk_enum_string_helper.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "asset_pack.h"
+#include "vk/vk_initializers.h"
+
+static void create_cull_buffer(vk_cull *self, VkDeviceSize size,
+			       VkBufferUsageFlags usage, VkBuffer *rbuffer,
+			       vk_mem_allocation *ralloc)
+{
+	VkBufferCreateInfo buf_info;
+	memset(&buf_info, 0, sizeof(VkBufferCreateInfo));
+	buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buf_info.size = size;
+	buf_info.usage = usage | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+	buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VkResult result = vk_mem_create_buffer(self->allocator, &buf_info,
+					       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0,
+					       rbuffer, ralloc);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error creating cull buffer, err: %s\n",
+			string_VkResult(result));
+	}
+}
+
+static void create_cull_descriptors(vk_cull *self)
+{
+	VkDescriptorSetLayoutBinding bindings[4];
+	memset(bindings, 0, sizeof(bindings));
+	for (Uint32 i = 0; i < 4; i++) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layout_ci;
+	memset(&layout_ci, 0, sizeof(VkDescriptorSetLayoutCreateInfo));
+	layout_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layout_ci.bindingCount = 4;
+	layout_ci.pBindings = bindings;
+
+	VkResult result = vkCreateDescriptorSetLayout(self->log_dev, &layout_ci, NULL,
+						      &self->set_layout);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error creating cull set layout, err: %s\n",
+			string_VkResult(result));
+	}
+
+	VkDescriptorPoolSize pool_size = {
+		.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		.descriptorCount = 4,
+	};
+
+	VkDescriptorPoolCreateInfo pool_ci;
+	memset(&pool_ci, 0, sizeof(VkDescriptorPoolCreateInfo));
+	pool_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_ci.maxSets = 1;
+	pool_ci.poolSizeCount = 1;
+	pool_ci.pPoolSizes = &pool_size;
+
+	result = vkCreateDescriptorPool(self->log_dev, &pool_ci, NULL,
+					&self->descriptor_pool);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error creating cull descriptor pool, err: %s\n",
+			string_VkResult(result));
+	}
+
+	VkDescriptorSetAllocateInfo set_info;
+	memset(&set_info, 0, sizeof(VkDescriptorSetAllocateInfo));
+	set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	set_info.descriptorPool = self->descriptor_pool;
+	set_info.descriptorSetCount = 1;
+	set_info.pSetLayouts = &self->set_layout;
+
+	result = vkAllocateDescriptorSets(self->log_dev, &set_info,
+					  &self->descriptor_set);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error allocating cull descriptor set, err: %s\n",
+			string_VkResult(result));
+	}
+
+	VkDescriptorBufferInfo infos[4] = {
+		{ .buffer = self->object_buffer, .offset = 0, .range = VK_WHOLE_SIZE },
+		{ .buffer = self->mesh_buffer, .offset = 0, .range = VK_WHOLE_SIZE },
+		{ .buffer = self->draw_buffer, .offset = 0, .range = VK_WHOLE_SIZE },
+		{ .buffer = self->count_buffer, .offset = 0, .range = VK_WHOLE_SIZE },
+	};
+
+	VkWriteDescriptorSet writes[4];
+	memset(writes, 0, sizeof(writes));
+	for (Uint32 i = 0; i < 4; i++) {
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = self->descriptor_set;
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[i].pBufferInfo = &infos[i];
+	}
+
+	vkUpdateDescriptorSets(self->log_dev, 4, writes, 0, NULL);
+}
+
+static VkPipeline build_cull_pipeline(vk_cull *self, const asset_pack *assets)
+{
+	loaded_file comp_code = asset_pack_load(assets, "build/cull.spv");
+	if (comp_code.buf == NULL) {
+		return VK_NULL_HANDLE;
+	}
+	VkShaderModule comp_mod = create_shader_module(self->log_dev, &comp_code);
+
+	VkComputePipelineCreateInfo pipeline_info;
+	memset(&pipeline_info, 0, sizeof(VkComputePipelineCreateInfo));
+	pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipeline_info.stage.module = comp_mod;
+	pipeline_info.stage.pName = "main";
+	pipeline_info.layout = self->pipeline_layout;
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkResult result = vkCreateComputePipelines(self->log_dev, self->pipeline_cache,
+						   1, &pipeline_info, NULL, &pipeline);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error creating cull pipeline, err: %s\n",
+			string_VkResult(result));
+		pipeline = VK_NULL_HANDLE;
+	}
+
+	vkDestroyShaderModule(self->log_dev, comp_mod, NULL);
+	loaded_file_destroy(&comp_code);
+
+	return pipeline;
+}
+
+static void create_cull_pipeline(vk_cull *self, const asset_pack *assets)
+{
+	VkPushConstantRange push_range = {
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(gpu_cull_constants),
+	};
+
+	VkPipelineLayoutCreateInfo layout_info;
+	memset(&layout_info, 0, sizeof(VkPipelineLayoutCreateInfo));
+	layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layout_info.setLayoutCount = 1;
+	layout_info.pSetLayouts = &self->set_layout;
+	layout_info.pushConstantRangeCount = 1;
+	layout_info.pPushConstantRanges = &push_range;
+
+	VkResult result = vkCreatePipelineLayout(self->log_dev, &layout_info, NULL,
+						 &self->pipeline_layout);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error creating cull pipeline layout, err: %s\n",
+			string_VkResult(result));
+	}
+
+	self->pipeline = build_cull_pipeline(self, assets);
+}
+
+void vk_cull_init(vk_cull *self, vk_mem_allocator *allocator, VkDevice log_dev,
+		  VkPipelineCache pipeline_cache, const asset_pack *assets,
+		  Uint32 instance_stride, bool draw_indirect_count)
+{
+	memset(self, 0, sizeof(vk_cull));
+	self->log_dev = log_dev;
+	self->allocator = allocator;
+	self->pipeline_cache = pipeline_cache;
+	self->instance_stride = instance_stride;
+	self->draw_indirect_count = draw_indirect_count;
+
+	create_cull_buffer(self, sizeof(gpu_object) * (VkDeviceSize)VK_CULL_MAX_OBJECTS,
+			   VK_BUFFER_USAGE_TRANSFER_DST_BIT, &self->object_buffer,
+			   &self->object_alloc);
+	// one more entry for VK_CULL_NULL_MESH
+	create_cull_buffer(self,
+			   sizeof(gpu_mesh) * (VkDeviceSize)(VK_CULL_MAX_MESHES + 1),
+			   VK_BUFFER_USAGE_TRANSFER_DST_BIT, &self->mesh_buffer,
+			   &self->mesh_alloc);
+	// transfer sources so checks can read the culling results back
+	create_cull_buffer(self,
+			   sizeof(VkDrawIndexedIndirectCommand) *
+				   (VkDeviceSize)VK_CULL_MAX_OBJECTS,
+			   VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+				   VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			   &self->draw_buffer, &self->draw_alloc);
+	create_cull_buffer(self, sizeof(Uint32),
+			   VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+				   VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+				   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			   &self->count_buffer, &self->count_alloc);
+	create_cull_buffer(self, (VkDeviceSize)instance_stride * VK_CULL_MAX_OBJECTS,
+			   VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+				   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			   &self->instance_buffer, &self->instance_alloc);
+
+	create_cull_descriptors(self);
+	create_cull_pipeline(self, assets);
+}
+
+void vk_cull_destroy(vk_cull *self)
+{
+	if (SDL_AtomicGet(&self->reload) == VK_RELOAD_COMPILING) {
+		job_system_wait(self->jobs);
+	}
+	vkDestroyPipeline(self->log_dev, self->next_pipeline, NULL);
+	vkDestroyPipeline(self->log_dev, self->pipeline, NULL);
+	vkDestroyPipelineLayout(self->log_dev, self->pipeline_layout, NULL);
+	vkDestroyDescriptorPool(self->log_dev, self->descriptor_pool, NULL);
+	vkDestroyDescriptorSetLayout(self->log_dev, self->set_layout, NULL);
+	vk_mem_destroy_buffer(self->allocator, self->object_buffer, &self->object_alloc);
+	vk_mem_destroy_buffer(self->allocator, self->mesh_buffer, &self->mesh_alloc);
+	vk_mem_destroy_buffer(self->allocator, self->draw_buffer, &self->draw_alloc);
+	vk_mem_destroy_buffer(self->allocator, self->count_buffer, &self->count_alloc);
+	vk_mem_destroy_buffer(self->allocator, self->instance_buffer,
+			      &self->instance_alloc);
+	free(self->object_meshes);
+}
+
+static void reload_job(void *data)
+{
+	vk_cull *self = data;
+	// straight from disk: the pack holds the build-time shader
+	self->next_pipeline = build_cull_pipeline(self, NULL);
+	// the handle is written before the state that publishes it
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&self->reload, VK_RELOAD_DONE);
+}
+
+void vk_cull_reload(vk_cull *self, job_system *jobs)
+{
+	self->jobs = jobs;
+	if (SDL_AtomicGet(&self->reload) != VK_RELOAD_IDLE) {
+		// the compile in progress may have read the old file
+		self->reload_again = true;
+		return;
+	}
+
+	self->reload_again = false;
+	self->next_pipeline = VK_NULL_HANDLE;
+	SDL_AtomicSet(&self->reload, VK_RELOAD_COMPILING);
+	job_system_push(jobs, reload_job, self);
+}
+
+VkPipeline vk_cull_update(vk_cull *self)
+{
+	if (SDL_AtomicGet(&self->reload) != VK_RELOAD_DONE) {
+		return VK_NULL_HANDLE;
+	}
+	// pairs with the release in reload_job
+	SDL_MemoryBarrierAcquire();
+
+	VkPipeline old = VK_NULL_HANDLE;
+	if (self->next_pipeline != VK_NULL_HANDLE) {
+		old = self->pipeline;
+		self->pipeline = self->next_pipeline;
+		self->next_pipeline = VK_NULL_HANDLE;
+	} else {
+		fprintf(stderr, "Cull shader reload failed, keeping the old one\n");
+	}
+	SDL_AtomicSet(&self->reload, VK_RELOAD_IDLE);
+
+	if (self->reload_again) {
+		vk_cull_reload(self, self->jobs);
+	}
+	return old;
+}
+
+void vk_cull_set_mesh(vk_cull *self, vk_upload_ring *upload, Uint32 id,
+		      const vk_mesh *mesh)
+{
+	if (id >= VK_CULL_MAX_MESHES) {
+		fprintf(stderr, "Mesh %u is past the cull mesh table\n", id);
+		return;
+	}
+
+	gpu_mesh entry = {
+		.index_count = mesh->index_count,
+		.first_index = mesh->first_index,
+		.vertex_offset = mesh->vertex_offset,
+		.pad = 0,
+	};
+	vk_upload_buffer(upload, self->mesh_buffer, sizeof(gpu_mesh) * (VkDeviceSize)id,
+			 &entry, sizeof(gpu_mesh));
+}
+
+// Device memory starts undefined, so the null entry is written whenever an
+// object may be pointed at it rather than trusted.
+static void write_null_mesh(vk_cull *self, vk_upload_ring *upload)
+{
+	gpu_mesh empty;
+	memset(&empty, 0, sizeof(gpu_mesh));
+	vk_upload_buffer(upload, self->mesh_buffer,
+			 sizeof(gpu_mesh) * (VkDeviceSize)VK_CULL_NULL_MESH, &empty,
+			 sizeof(gpu_mesh));
+}
+
+void vk_cull_remove_mesh(vk_cull *self, vk_upload_ring *upload, Uint32 id)
+{
+	if (id >= VK_CULL_MAX_MESHES) {
+		return;
+	}
+
+	gpu_mesh empty;
+	memset(&empty, 0, sizeof(gpu_mesh));
+	vk_upload_buffer(upload, self->mesh_buffer, sizeof(gpu_mesh) * (VkDeviceSize)id,
+			 &empty, sizeof(gpu_mesh));
+	write_null_mesh(self, upload);
+
+	Uint32 null_mesh = VK_CULL_NULL_MESH;
+	for (Uint32 i = 0; i < self->object_count; i++) {
+		if (self->object_meshes[i] != id) {
+			continue;
+		}
+		self->object_meshes[i] = VK_CULL_NULL_MESH;
+		vk_upload_buffer(upload, self->object_buffer,
+				 sizeof(gpu_object) * (VkDeviceSize)i +
+					 offsetof(gpu_object, mesh),
+				 &null_mesh, sizeof(Uint32));
+	}
+}
+
+Uint32 vk_cull_add_object(vk_cull *self, vk_upload_ring *upload,
+			  const gpu_object *object, const void *instance)
+{
+	if (self->object_count == VK_CULL_MAX_OBJECTS) {
+		fprintf(stderr, "Cull object buffer is full\n");
+		return UINT32_MAX;
+	}
+
+	if (self->object_count == self->object_cap) {
+		self->object_cap = self->object_cap ? self->object_cap * 2 : 1024;
+		self->object_meshes =
+			realloc(self->object_meshes, sizeof(Uint32) * self->object_cap);
+	}
+
+	Uint32 index = self->object_count++;
+	vk_cull_update_object(self, upload, index, object, instance);
+	return index;
+}
+
+void vk_cull_update_object(vk_cull *self, vk_upload_ring *upload, Uint32 index,
+			   const gpu_object *object, const void *instance)
+{
+	gpu_object entry = *object;
+	// the shader indexes the mesh table with it unchecked
+	if (entry.mesh >= VK_CULL_MAX_MESHES && entry.mesh != VK_CULL_NULL_MESH) {
+		fprintf(stderr, "Mesh %u is past the cull mesh table, object %u draws nothing\n",
+			entry.mesh, index);
+		entry.mesh = VK_CULL_NULL_MESH;
+	}
+	if (entry.mesh == VK_CULL_NULL_MESH) {
+		write_null_mesh(self, upload);
+	}
+	self->object_meshes[index] = entry.mesh;
+	vk_upload_buffer(upload, self->object_buffer,
+			 sizeof(gpu_object) * (VkDeviceSize)index, &entry,
+			 sizeof(gpu_object));
+	vk_upload_buffer(upload, self->instance_buffer,
+			 (VkDeviceSize)self->instance_stride * index, instance,
+			 self->instance_stride);
+}
+
+void vk_cull_clear_objects(vk_cull *self)
+{
+	self->object_count = 0;
+}
+
+void vk_cull_dispatch(vk_cull *self, VkCommandBuffer cmd, mat4 view_proj)
+{
+	if (self->object_count == 0) {
+		return;
+	}
+
+	// the previous frame's indirect draw may still be reading the draw
+	// and count buffers
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+			     VK_PIPELINE_STAGE_TRANSFER_BIT |
+				     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			     0, 0, NULL, 0, NULL, 0, NULL);
+
+	VkMemoryBarrier barrier;
+	memset(&barrier, 0, sizeof(VkMemoryBarrier));
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+
+	if (self->draw_indirect_count) {
+		vkCmdFillBuffer(cmd, self->count_buffer, 0, sizeof(Uint32), 0);
+
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT |
+					VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+				     &barrier, 0, NULL, 0, NULL);
+	}
+
+	gpu_cull_constants constants;
+	memset(&constants, 0, sizeof(gpu_cull_constants));
+	glm_frustum_planes(view_proj, constants.planes);
+	constants.object_count = self->object_count;
+	constants.compact = self->draw_indirect_count ? 1 : 0;
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, self->pipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+				self->pipeline_layout, 0, 1, &self->descriptor_set, 0,
+				NULL);
+	vkCmdPushConstants(cmd, self->pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT,
+			   0, sizeof(gpu_cull_constants), &constants);
+	vkCmdDispatch(cmd,
+		      (self->object_count + VK_CULL_GROUP_SIZE - 1) / VK_CULL_GROUP_SIZE,
+		      1, 1);
+
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			     VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &barrier, 0,
+			     NULL, 0, NULL);
+}
+
+void vk_cull_draw(vk_cull *self, VkCommandBuffer cmd)
+{
+	if (self->object_count == 0) {
+		return;
+	}
+
+	VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(cmd, 1, 1, &self->instance_buffer, &offset);
+
+	if (self->draw_indirect_count) {
+		vkCmdDrawIndexedIndirectCount(cmd, self->draw_buffer, 0,
+					      self->count_buffer, 0, self->object_count,
+					      sizeof(VkDrawIndexedIndirectCommand));
+	} else {
+		vkCmdDrawIndexedIndirect(cmd, self->draw_buffer, 0, self->object_count,
+					 sizeof(VkDrawIndexedIndirectCommand));
+	}
+}
@@ -0,0 +1,92 @@
+#include "vk/vk_deletion_queue.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void destroy_entry(vk_deletion_queue *self, vk_deletion *entry)
+{
+	switch (entry->type) {
+	case VK_DELETE_SWAPCHAIN:
+		vkDestroySwapchainKHR(self->log_dev, entry->swap_chain, NULL);
+		break;
+	case VK_DELETE_IMAGE_VIEW:
+		vkDestroyImageView(self->log_dev, entry->image_view, NULL);
+		break;
+	case VK_DELETE_FRAMEBUFFER:
+		vkDestroyFramebuffer(self->log_dev, entry->framebuffer, NULL);
+		break;
+	case VK_DELETE_COMMAND_BUFFER:
+		vkFreeCommandBuffers(self->log_dev, entry->command_buffer.pool, 1,
+				     &entry->command_buffer.cmd);
+		break;
+	case VK_DELETE_COMMAND_POOL:
+		vkDestroyCommandPool(self->log_dev, entry->command_pool, NULL);
+		break;
+	case VK_DELETE_PIPELINE:
+		vkDestroyPipeline(self->log_dev, entry->pipeline, NULL);
+		break;
+	case VK_DELETE_PIPELINE_LAYOUT:
+		vkDestroyPipelineLayout(self->log_dev, entry->pipeline_layout, NULL);
+		break;
+	case VK_DELETE_DESCRIPTOR_POOL:
+		vkDestroyDescriptorPool(self->log_dev, entry->descriptor_pool, NULL);
+		break;
+	case VK_DELETE_DESCRIPTOR_SET_LAYOUT:
+		vkDestroyDescriptorSetLayout(self->log_dev, entry->descriptor_set_layout,
+					     NULL);
+		break;
+	case VK_DELETE_SAMPLER:
+		vkDestroySampler(self->log_dev, entry->sampler, NULL);
+		break;
+	case VK_DELETE_BUFFER:
+		vk_mem_destroy_buffer(entry->buffer.allocator, entry->buffer.buffer,
+				      &entry->buffer.alloc);
+		break;
+	case VK_DELETE_IMAGE:
+		vk_mem_destroy_image(entry->image.allocator, entry->image.image,
+				     &entry->image.alloc);
+		break;
+	case VK_DELETE_HOST_MEMORY:
+		free(entry->host);
+		break;
+	case VK_DELETE_CALLBACK:
+		entry->callback.fn(entry->callback.owner, entry->callback.arg);
+		break;
+	}
+}
+
+void vk_deletion_queue_init(vk_deletion_queue *self, VkDevice log_dev)
+{
+	memset(self, 0, sizeof(vk_deletion_queue));
+	self->log_dev = log_dev;
+}
+
+void vk_deletion_queue_destroy(vk_deletion_queue *self)
+{
+	vk_deletion_queue_flush(self, UINT64_MAX);
+	free(self->entries);
+}
+
+void vk_deletion_queue_push(vk_deletion_queue *self, const vk_deletion *deletion)
+{
+	if (self->count == self->cap) {
+		self->cap = self->cap ? self->cap * 2 : 64;
+		self->entries = realloc(self->entries, sizeof(vk_deletion) * self->cap);
+	}
+	self->entries[self->count++] = *deletion;
+}
+
+void vk_deletion_queue_flush(vk_deletion_queue *self, Uint64 frames_completed)
+{
+	Uint32 done = 0;
+	while (done < self->count && self->entries[done].frame < frames_completed) {
+		destroy_entry(self, &self->entries[done]);
+		done++;
+	}
+	if (done == 0) {
+		return;
+	}
+
+	memmove(self->entries, &self->entries[done],
+		sizeof(vk_deletion) * (self->count - done));
+	self->count -= done;
+}
@@ -1,4 +1,5 @@
 #include "vk/vk_engine.h"
+#include "radix_sort.h"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_vulkan.h>
 #include <vulkan/vk_enum_string_helper.h>
@@ -6,9 +7,14 @@
 #include <stddef.h>
 
 #include "file.h"
+#include "vk/vk_initializers.h"
 
 #define SCREEN_WIDTH 1700
 #define SCREEN_HEIGHT 900
+#define PIPELINE_CACHE_PATH "build/pipeline_cache.bin"
+#define ASSET_PACK_PATH "build/assets.pack"
+// readable with a plain copy, no swizzle, for readback
+#define HEADLESS_FORMAT VK_FORMAT_R8G8B8A8_UNORM
 
 static const char *validation_layers[] = {
 	"VK_LAYER_KHRONOS_validation",
@@ -21,28 +27,41 @@ static const Uint32 device_extensions_size = 1;
 
 #ifdef DEBUG
 const bool enable_validation_layers = true;
+static const bool enable_shader_reload = true;
 #else
 const bool enable_validation_layers = false;
+static const bool enable_shader_reload = false;
 #endif /* ifdef DEBUG */
 
-const vertex VERTICES[3] = { { { 0.0f, -0.5f }, { 1.0f, 0.0f, 0.0f } },
-			     { { 0.5f, 0.5f }, { 0.0f, 1.0f, 0.0f } },
-			     { { -0.5f, 0.5f }, { 0.0f, 0.0f, 1.0f } } };
+// mirrors the glslc rules in the Makefile
+static const shader_source shader_sources[] = {
+	{ "vertex.glsl", "vert", "build/vert.spv" },
+	{ "fragment.glsl", "frag", "build/frag.spv" },
+	{ "cull.glsl", "comp", "build/cull.spv" },
+};
+static const Uint32 shader_sources_size =
+	sizeof(shader_sources) / sizeof(shader_sources[0]);
 
-static VkVertexInputBindingDescription vertex_binding_description()
+// Draws that blend or leave depth alone depend on what is behind them, so they
+// go last and back to front.
+static bool desc_translucent(const vk_pipeline_desc *desc)
 {
-	VkVertexInputBindingDescription bind_desc;
-	bind_desc.binding = 0;
-	bind_desc.stride = sizeof(vertex);
-	bind_desc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-	return bind_desc;
+	return desc->blend != VK_BLEND_MODE_OPAQUE || !desc->depth_write;
 }
-// Make sure to free returned array
-static VkVertexInputAttributeDescription *vertex_attribute_description()
+
+// binding 0 per vertex, binding 1 per instance
+static void vertex_input_description(vk_pipeline_desc *desc)
 {
-	VkVertexInputAttributeDescription *attr_descs =
-		malloc(sizeof(VkVertexInputAttributeDescription) * 2);
+	desc->binding_count = 2;
+	desc->bindings[0].binding = 0;
+	desc->bindings[0].stride = sizeof(vertex);
+	desc->bindings[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	desc->bindings[1].binding = 1;
+	desc->bindings[1].stride = sizeof(instance_data);
+	desc->bindings[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+	VkVertexInputAttributeDescription *attr_descs = desc->attributes;
+	desc->attribute_count = 7;
 
 	attr_descs[0].binding = 0;
 	attr_descs[0].location = 0;
@@ -54,23 +73,18 @@ static VkVertexInputAttributeDescription *vertex_attribute_description()
 	attr_descs[1].format = VK_FORMAT_R32G32B32_SFLOAT;
 	attr_descs[1].offset = offsetof(vertex, color);
 
-	return attr_descs;
-}
-
-static Uint32 find_memory_flags(vulkan_engine *self, Uint32 type_filter,
-				VkMemoryPropertyFlags props)
-{
-	VkPhysicalDeviceMemoryProperties mem_props;
-	vkGetPhysicalDeviceMemoryProperties(self->phy_dev, &mem_props);
-
-	for (Uint32 i = 0; i < mem_props.memoryTypeCount; i++) {
-		if ((type_filter & (1 << i)) &&
-		    (mem_props.memoryTypes[i].propertyFlags & props) == props) {
-			return i;
-		}
+	// a mat4 input takes one location per column
+	for (Uint32 i = 0; i < 4; i++) {
+		attr_descs[2 + i].binding = 1;
+		attr_descs[2 + i].location = 2 + i;
+		attr_descs[2 + i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		attr_descs[2 + i].offset = offsetof(instance_data, model) + sizeof(vec4) * i;
 	}
 
-	return -1;
+	attr_descs[6].binding = 1;
+	attr_descs[6].location = 6;
+	attr_descs[6].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+	attr_descs[6].offset = offsetof(instance_data, color);
 }
 
 static bool check_validation_layer_support()
@@ -127,8 +141,11 @@ populate_debug_messenger_creat_info(VkDebugUtilsMessengerCreateInfoEXT *creat_in
 
 static void create_instance(vulkan_engine *self)
 {
-	self->win_extent.width = SCREEN_WIDTH;
-	self->win_extent.height = SCREEN_HEIGHT;
+	// headless targets keep the size they were asked for
+	if (!self->headless) {
+		self->win_extent.width = SCREEN_WIDTH;
+		self->win_extent.height = SCREEN_HEIGHT;
+	}
 	self->initialized = true;
 	self->frame_num = 0;
 	self->phy_dev = VK_NULL_HANDLE;
@@ -136,12 +153,14 @@ static void create_instance(vulkan_engine *self)
 	self->graphics_queue = VK_NULL_HANDLE;
 	self->present_queue = VK_NULL_HANDLE;
 	self->swap_chain = VK_NULL_HANDLE;
+	self->swap_chain_retired = false;
 	self->swap_chain_images = NULL;
 	self->swap_chain_images_size = 0;
 	self->swap_chain_image_views = NULL;
 	self->render_pass = NULL;
 	self->pipeline_layout = NULL;
 	self->current_frame = 0;
+	self->frames_in_flight = DEFAULT_FRAMES_IN_FLIGHT;
 	self->fb_resized_flag = false;
 
 	VkApplicationInfo app_info = {
@@ -154,11 +173,16 @@ static void create_instance(vulkan_engine *self)
 		.pNext = NULL,
 	};
 
+	// headless needs no surface extensions, and no SDL video at all
 	uint32_t ext_count = 0;
-	SDL_Vulkan_GetInstanceExtensions(self->win, &ext_count, NULL);
+	if (!self->headless) {
+		SDL_Vulkan_GetInstanceExtensions(self->win, &ext_count, NULL);
+	}
 
 	const char *ext_names[ext_count + 1];
-	SDL_Vulkan_GetInstanceExtensions(self->win, &ext_count, ext_names);
+	if (!self->headless) {
+		SDL_Vulkan_GetInstanceExtensions(self->win, &ext_count, ext_names);
+	}
 
 	if (enable_validation_layers) {
 		ext_names[ext_count++] = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
@@ -232,6 +256,9 @@ static void queue_family_indices_init(VkPhysicalDevice dev, VkSurfaceKHR surface
 			r_indices->graphics_family = i;
 			r_indices->graphics_found = true;
 		}
+		if (surface == VK_NULL_HANDLE) {
+			continue;
+		}
 		VkBool32 present_support = false;
 		vkGetPhysicalDeviceSurfaceSupportKHR(dev, i, surface, &present_support);
 		if (present_support) {
@@ -239,6 +266,12 @@ static void queue_family_indices_init(VkPhysicalDevice dev, VkSurfaceKHR surface
 			r_indices->present_found = true;
 		}
 	}
+
+	// headless: nothing is presented, the graphics queue stands in
+	if (surface == VK_NULL_HANDLE) {
+		r_indices->present_family = r_indices->graphics_family;
+		r_indices->present_found = r_indices->graphics_found;
+	}
 }
 
 static bool queue_family_indices_is_complete(queue_family_indices *indices)
@@ -315,6 +348,11 @@ static bool phy_dev_is_usable(VkPhysicalDevice dev, VkSurfaceKHR surface)
 	queue_family_indices family_indices;
 	queue_family_indices_init(dev, surface, &family_indices);
 
+	// headless only renders, so software devices like lavapipe qualify
+	if (surface == VK_NULL_HANDLE) {
+		return family_indices.graphics_found;
+	}
+
 	bool extensions_supported = check_dev_ext_support(dev);
 
 	bool swap_chain_adequate = false;
@@ -403,16 +441,64 @@ static void create_logical_device(vulkan_engine *self)
 		queue_create_infos[i] = queue_creat_info;
 	}
 
-	VkPhysicalDeviceFeatures feats;
-	SDL_memset(&feats, 0, sizeof(VkPhysicalDeviceFeatures));
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(self->phy_dev, &props);
+	bool has_13 = props.apiVersion >= VK_API_VERSION_1_3;
+
+	VkPhysicalDeviceVulkan13Features supported_13;
+	SDL_memset(&supported_13, 0, sizeof(VkPhysicalDeviceVulkan13Features));
+	supported_13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+	VkPhysicalDeviceVulkan12Features supported_12;
+	SDL_memset(&supported_12, 0, sizeof(VkPhysicalDeviceVulkan12Features));
+	supported_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	supported_12.pNext = has_13 ? &supported_13 : NULL;
+	VkPhysicalDeviceFeatures2 supported;
+	SDL_memset(&supported, 0, sizeof(VkPhysicalDeviceFeatures2));
+	supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	supported.pNext = &supported_12;
+	vkGetPhysicalDeviceFeatures2(self->phy_dev, &supported);
+
+	// GPU culled draws are issued as one multi draw indirect and carry the
+	// object index in firstInstance
+	self->multi_draw_indirect = supported.features.multiDrawIndirect == VK_TRUE &&
+				    supported.features.drawIndirectFirstInstance == VK_TRUE;
+	self->draw_indirect_count = self->multi_draw_indirect &&
+				    supported_12.drawIndirectCount == VK_TRUE;
+	if (!self->multi_draw_indirect) {
+		fprintf(stderr, "multiDrawIndirect is not supported, GPU culled "
+				"objects will not be drawn\n");
+	}
+	// without it the render graph falls back to render passes and framebuffers
+	self->dynamic_rendering = has_13 && supported_13.dynamicRendering == VK_TRUE;
+
+	VkPhysicalDeviceVulkan13Features feats_13;
+	SDL_memset(&feats_13, 0, sizeof(VkPhysicalDeviceVulkan13Features));
+	feats_13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+	feats_13.dynamicRendering = VK_TRUE;
+
+	VkPhysicalDeviceVulkan12Features feats_12;
+	SDL_memset(&feats_12, 0, sizeof(VkPhysicalDeviceVulkan12Features));
+	feats_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	feats_12.drawIndirectCount = self->draw_indirect_count;
+	// core and mandatory since 1.2, frame pacing depends on it
+	feats_12.timelineSemaphore = VK_TRUE;
+	feats_12.pNext = self->dynamic_rendering ? &feats_13 : NULL;
+
+	VkPhysicalDeviceFeatures2 feats;
+	SDL_memset(&feats, 0, sizeof(VkPhysicalDeviceFeatures2));
+	feats.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	feats.pNext = &feats_12;
+	feats.features.multiDrawIndirect = self->multi_draw_indirect;
+	feats.features.drawIndirectFirstInstance = self->multi_draw_indirect;
 
 	VkDeviceCreateInfo dev_creat_info;
 	SDL_memset(&dev_creat_info, 0, sizeof(VkDeviceCreateInfo));
 	dev_creat_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	dev_creat_info.pQueueCreateInfos = queue_create_infos;
 	dev_creat_info.queueCreateInfoCount = used_idx + 1;
-	dev_creat_info.pEnabledFeatures = &feats;
-	dev_creat_info.enabledExtensionCount = device_extensions_size;
+	dev_creat_info.pNext = &feats;
+	dev_creat_info.pEnabledFeatures = NULL;
+	dev_creat_info.enabledExtensionCount = self->headless ? 0 : device_extensions_size;
 	dev_creat_info.ppEnabledExtensionNames = device_extensions;
 
 	if (enable_validation_layers) {
@@ -489,7 +575,51 @@ VkExtent2D choose_swap_extent(VkSurfaceCapabilitiesKHR *capabilites, SDL_Window
 	}
 }
 
-static void create_swap_chain(vulkan_engine *self)
+// Engine-owned images stand in for the swapchain, one per frame slot so the
+// frame timeline alone guards their reuse.
+static void create_headless_targets(vulkan_engine *self)
+{
+	self->swap_chain_extent = self->win_extent;
+	self->swap_chain_image_format = HEADLESS_FORMAT;
+	self->capture_supported = true;
+	self->swap_chain_images_size = MAX_FRAMES_IN_FLIGHT;
+	self->swap_chain_images = malloc(sizeof(VkImage) * self->swap_chain_images_size);
+	self->headless_allocs =
+		malloc(sizeof(vk_mem_allocation) * self->swap_chain_images_size);
+
+	VkImageCreateInfo image_info;
+	memset(&image_info, 0, sizeof(VkImageCreateInfo));
+	image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_info.imageType = VK_IMAGE_TYPE_2D;
+	image_info.format = HEADLESS_FORMAT;
+	image_info.extent.width = self->win_extent.width;
+	image_info.extent.height = self->win_extent.height;
+	image_info.extent.depth = 1;
+	image_info.mipLevels = 1;
+	image_info.arrayLayers = 1;
+	image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_info.usage =
+		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	for (Uint32 i = 0; i < self->swap_chain_images_size; i++) {
+		VkResult result = vk_mem_create_image(&self->allocator, &image_info,
+						      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+						      &self->swap_chain_images[i],
+						      &self->headless_allocs[i]);
+		if (result != VK_SUCCESS) {
+			fprintf(stderr, "Error creating headless target, err: %s\n",
+				string_VkResult(result));
+		}
+	}
+}
+
+// Returns VK_NULL_HANDLE on failure, leaving the current swapchain and its
+// images in place.
+static VkSwapchainKHR new_swap_chain(vulkan_engine *self, VkExtent2D *rextent,
+				     VkFormat *rformat)
 {
 	swap_chain_support_details details;
 	swap_chain_support_details_init(self->phy_dev, self->sdl_surface, &details);
@@ -523,6 +653,12 @@ static void create_swap_chain(vulkan_engine *self)
 	sc_creat.imageExtent = extent;
 	sc_creat.imageArrayLayers = 1;
 	sc_creat.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	// for capture, where the surface allows it
+	self->capture_supported = (details.capabilites.supportedUsageFlags &
+				   VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+	if (self->capture_supported) {
+		sc_creat.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
 
 	if (indices.graphics_family != indices.present_family) {
 		sc_creat.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
@@ -538,14 +674,39 @@ static void create_swap_chain(vulkan_engine *self)
 	sc_creat.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	sc_creat.presentMode = present_mode;
 	sc_creat.clipped = true;
-	sc_creat.oldSwapchain = NULL;
+	// lets the presentation engine hand images over without a gap
+	sc_creat.oldSwapchain =
+		self->swap_chain_retired ? VK_NULL_HANDLE : self->swap_chain;
 
+	VkSwapchainKHR swap_chain = VK_NULL_HANDLE;
 	VkResult result =
-		vkCreateSwapchainKHR(self->log_dev, &sc_creat, NULL, &self->swap_chain);
+		vkCreateSwapchainKHR(self->log_dev, &sc_creat, NULL, &swap_chain);
 	if (result != VK_SUCCESS) {
 		fprintf(stderr, "Error creating swap_chain. err: %s\n",
 			string_VkResult(result));
+		// the old one stops presenting even so
+		self->swap_chain_retired = self->swap_chain != VK_NULL_HANDLE;
+		swap_chain = VK_NULL_HANDLE;
+	}
+
+	*rextent = extent;
+	*rformat = format.format;
+	swap_chain_support_details_destroy(&details);
+	return swap_chain;
+}
+
+// Replaces the current swapchain, which presents may still be queued to.
+static void use_swap_chain(vulkan_engine *self, VkSwapchainKHR swap_chain,
+			   VkExtent2D extent, VkFormat format)
+{
+	if (self->swap_chain != VK_NULL_HANDLE) {
+		vulkan_engine_defer_deletion(
+			self, &(vk_deletion){ .type = VK_DELETE_SWAPCHAIN,
+					      .swap_chain = self->swap_chain });
 	}
+	self->swap_chain = swap_chain;
+	self->swap_chain_retired = false;
+
 	// set up swap chain images
 	vkGetSwapchainImagesKHR(self->log_dev, self->swap_chain,
 				&self->swap_chain_images_size, NULL);
@@ -555,9 +716,20 @@ static void create_swap_chain(vulkan_engine *self)
 				&self->swap_chain_images_size, self->swap_chain_images);
 
 	self->swap_chain_extent = extent;
-	self->swap_chain_image_format = format.format;
+	self->swap_chain_image_format = format;
+}
 
-	swap_chain_support_details_destroy(&details);
+static void create_swap_chain(vulkan_engine *self)
+{
+	if (self->headless) {
+		create_headless_targets(self);
+		return;
+	}
+
+	VkExtent2D extent;
+	VkFormat format;
+	VkSwapchainKHR swap_chain = new_swap_chain(self, &extent, &format);
+	use_swap_chain(self, swap_chain, extent, format);
 }
 
 void create_image_views(vulkan_engine *self)
@@ -592,155 +764,55 @@ void create_image_views(vulkan_engine *self)
 	}
 }
 
-VkShaderModule create_shader_module(VkDevice log_dev, loaded_file *lf)
+static VkFormat find_depth_format(VkPhysicalDevice phy_dev)
 {
-	VkShaderModuleCreateInfo smci;
-	memset(&smci, 0, sizeof(VkShaderModuleCreateInfo));
-
-	smci.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	smci.codeSize = lf->size;
-	smci.pCode = (Uint32 *)lf->buf;
+	static const VkFormat candidates[] = { VK_FORMAT_D32_SFLOAT,
+					       VK_FORMAT_X8_D24_UNORM_PACK32,
+					       VK_FORMAT_D24_UNORM_S8_UINT,
+					       VK_FORMAT_D32_SFLOAT_S8_UINT,
+					       VK_FORMAT_D16_UNORM };
+	for (Uint32 i = 0; i < sizeof(candidates) / sizeof(VkFormat); i++) {
+		VkFormatProperties props;
+		vkGetPhysicalDeviceFormatProperties(phy_dev, candidates[i], &props);
+		if (props.optimalTilingFeatures &
+		    VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+			return candidates[i];
+		}
+	}
+	// D16 support is required by the spec
+	return VK_FORMAT_D16_UNORM;
+}
 
-	VkShaderModule module;
-	VkResult result = vkCreateShaderModule(log_dev, &smci, NULL, &module);
+static void create_descriptor_set_layout(vulkan_engine *self)
+{
+	VkDescriptorSetLayoutBinding camera_binding;
+	memset(&camera_binding, 0, sizeof(VkDescriptorSetLayoutBinding));
+	camera_binding.binding = 0;
+	camera_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	camera_binding.descriptorCount = 1;
+	camera_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layout_ci;
+	memset(&layout_ci, 0, sizeof(VkDescriptorSetLayoutCreateInfo));
+	layout_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layout_ci.bindingCount = 1;
+	layout_ci.pBindings = &camera_binding;
+
+	VkResult result = vkCreateDescriptorSetLayout(self->log_dev, &layout_ci, NULL,
+						      &self->descriptor_set_layout);
 	if (result != VK_SUCCESS) {
-		fprintf(stderr, "Error creating shader module. err: %s\n",
+		fprintf(stderr, "Error creating descriptor set layout. err: %s\n",
 			string_VkResult(result));
 	}
-
-	return module;
 }
 
 void create_graphics_pipeline(vulkan_engine *self)
 {
-	// shader stage
-	loaded_file vert_code = read_file("build/vert.spv");
-	loaded_file frag_code = read_file("build/frag.spv");
-
-	VkShaderModule vert_mod = create_shader_module(self->log_dev, &vert_code);
-	VkShaderModule frag_mod = create_shader_module(self->log_dev, &frag_code);
-
-	VkPipelineShaderStageCreateInfo pvssci;
-	memset(&pvssci, 0, sizeof(VkPipelineShaderStageCreateInfo));
-	pvssci.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	pvssci.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	pvssci.module = vert_mod;
-	pvssci.pName = "main";
-
-	VkPipelineShaderStageCreateInfo pfssci;
-	memset(&pfssci, 0, sizeof(VkPipelineShaderStageCreateInfo));
-	pfssci.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	pfssci.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	pfssci.module = frag_mod;
-	pfssci.pName = "main";
-
-	VkPipelineShaderStageCreateInfo shader_stages[] = { pvssci, pfssci };
-
-	// dynamic stage
-
-	VkDynamicState dynamic_states[] = {
-		VK_DYNAMIC_STATE_VIEWPORT,
-		VK_DYNAMIC_STATE_SCISSOR,
-	};
-
-	VkPipelineDynamicStateCreateInfo dsci;
-	memset(&dsci, 0, sizeof(VkPipelineDynamicStateCreateInfo));
-	dsci.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	dsci.dynamicStateCount = 2;
-	dsci.pDynamicStates = dynamic_states;
-
-	VkVertexInputBindingDescription vertex_bind_desc = vertex_binding_description();
-	VkVertexInputAttributeDescription *vertex_attr_decs =
-		vertex_attribute_description();
-
-	VkPipelineVertexInputStateCreateInfo visci;
-	memset(&visci, 0, sizeof(VkPipelineVertexInputStateCreateInfo));
-	visci.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-
-	visci.vertexBindingDescriptionCount = 1;
-	visci.vertexAttributeDescriptionCount = 2; //TODO hard coded baby
-
-	visci.pVertexBindingDescriptions = &vertex_bind_desc;
-	visci.pVertexAttributeDescriptions = vertex_attr_decs;
-
-	VkPipelineInputAssemblyStateCreateInfo iaci;
-	memset(&iaci, 0, sizeof(VkPipelineInputAssemblyStateCreateInfo));
-	iaci.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	iaci.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	iaci.primitiveRestartEnable = VK_FALSE;
-
-	VkViewport viewport;
-	memset(&viewport, 0, sizeof(VkViewport));
-	viewport.x = 0;
-	viewport.y = 0;
-	viewport.width = self->swap_chain_extent.width;
-	viewport.height = self->swap_chain_extent.height;
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-
-	VkRect2D scissor;
-	scissor.offset.x = 0;
-	scissor.offset.y = 0;
-	scissor.extent = self->swap_chain_extent;
-
-	VkPipelineViewportStateCreateInfo vsci;
-	memset(&vsci, 0, sizeof(VkPipelineViewportStateCreateInfo));
-	vsci.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	vsci.viewportCount = 1;
-	vsci.pViewports = &viewport;
-	vsci.scissorCount = 1;
-	vsci.pScissors = &scissor;
-
-	VkPipelineRasterizationStateCreateInfo rastci;
-	memset(&rastci, 0, sizeof(VkPipelineRasterizationStateCreateInfo));
-	rastci.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rastci.lineWidth = 1.0f;
-	rastci.depthClampEnable = VK_FALSE;
-	rastci.polygonMode = VK_POLYGON_MODE_FILL;
-	rastci.cullMode = VK_CULL_MODE_BACK_BIT;
-	rastci.frontFace = VK_FRONT_FACE_CLOCKWISE;
-	rastci.depthBiasEnable = VK_FALSE;
-
-	VkPipelineMultisampleStateCreateInfo multisci;
-	memset(&multisci, 0, sizeof(VkPipelineMultisampleStateCreateInfo));
-	multisci.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisci.sampleShadingEnable = VK_FALSE;
-	multisci.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-	multisci.minSampleShading = 1.0f;
-	multisci.pSampleMask = NULL;
-	multisci.alphaToCoverageEnable = VK_FALSE;
-	multisci.alphaToOneEnable = VK_FALSE;
-
-	VkPipelineColorBlendAttachmentState color_blend_att;
-	color_blend_att.colorWriteMask =
-		VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-		VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-
-	color_blend_att.blendEnable = VK_TRUE;
-	color_blend_att.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-	color_blend_att.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-	color_blend_att.colorBlendOp = VK_BLEND_OP_ADD;
-	color_blend_att.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-	color_blend_att.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-	color_blend_att.alphaBlendOp = VK_BLEND_OP_ADD;
-
-	VkPipelineColorBlendStateCreateInfo color_blend_ci;
-	memset(&color_blend_ci, 0, sizeof(VkPipelineColorBlendStateCreateInfo));
-	color_blend_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	color_blend_ci.logicOpEnable = VK_FALSE;
-	color_blend_ci.logicOp = VK_LOGIC_OP_COPY;
-	color_blend_ci.attachmentCount = 1;
-	color_blend_ci.pAttachments = &color_blend_att;
-	color_blend_ci.blendConstants[0] = 0.0f;
-	color_blend_ci.blendConstants[1] = 0.0f;
-	color_blend_ci.blendConstants[2] = 0.0f;
-	color_blend_ci.blendConstants[3] = 0.0f;
-
-	memset(&self->pipeline_layout, 0, sizeof(VkPipelineLayout));
-
 	VkPipelineLayoutCreateInfo pipeline_layout_ci;
 	memset(&pipeline_layout_ci, 0, sizeof(VkPipelineLayoutCreateInfo));
 	pipeline_layout_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipeline_layout_ci.setLayoutCount = 1;
+	pipeline_layout_ci.pSetLayouts = &self->descriptor_set_layout;
 
 	VkResult result = vkCreatePipelineLayout(self->log_dev, &pipeline_layout_ci,
 						 NULL, &self->pipeline_layout);
@@ -749,116 +821,19 @@ void create_graphics_pipeline(vulkan_engine *self)
 			string_VkResult(result));
 	}
 
-	VkGraphicsPipelineCreateInfo pipeline_ci;
-	memset(&pipeline_ci, 0, sizeof(VkGraphicsPipelineCreateInfo));
-	pipeline_ci.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipeline_ci.stageCount = 2;
-	pipeline_ci.pStages = shader_stages;
-	pipeline_ci.pVertexInputState = &visci;
-	pipeline_ci.pInputAssemblyState = &iaci;
-	pipeline_ci.pViewportState = &vsci;
-	pipeline_ci.pRasterizationState = &rastci;
-	pipeline_ci.pMultisampleState = &multisci;
-	pipeline_ci.pDepthStencilState = NULL;
-	pipeline_ci.pColorBlendState = &color_blend_ci;
-	pipeline_ci.pDynamicState = &dsci;
-	pipeline_ci.layout = self->pipeline_layout;
-	pipeline_ci.renderPass = self->render_pass;
-	pipeline_ci.subpass = 0;
-	pipeline_ci.basePipelineHandle = VK_NULL_HANDLE;
-	pipeline_ci.basePipelineIndex = -1;
-
-	result = vkCreateGraphicsPipelines(self->log_dev, VK_NULL_HANDLE, 1,
-					   &pipeline_ci, NULL,
-					   &self->graphics_pipeline);
-	if (result != VK_SUCCESS) {
-		fprintf(stderr, "Error creating graphics pipeline . err: %s\n",
-			string_VkResult(result));
-	}
-	vkDestroyShaderModule(self->log_dev, vert_mod, NULL);
-	vkDestroyShaderModule(self->log_dev, frag_mod, NULL);
-
-	free(vertex_attr_decs);
-
-	loaded_file_destroy(&vert_code);
-	loaded_file_destroy(&frag_code);
-}
-
-static void create_render_pass(vulkan_engine *self)
-{
-	VkAttachmentDescription color_att;
-	memset(&color_att, 0, sizeof(VkAttachmentDescription));
-	color_att.format = self->swap_chain_image_format;
-	color_att.samples = VK_SAMPLE_COUNT_1_BIT;
-	color_att.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	color_att.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-	color_att.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	color_att.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	color_att.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	color_att.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-	VkAttachmentReference color_att_ref;
-	memset(&color_att_ref, 0, sizeof(VkAttachmentReference));
-	color_att_ref.attachment = 0;
-	color_att_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-	VkSubpassDescription subpass;
-	memset(&subpass, 0, sizeof(VkSubpassDescription));
-	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpass.colorAttachmentCount = 1;
-	subpass.pColorAttachments = &color_att_ref;
-
-	VkSubpassDependency dep;
-	memset(&dep, 0, sizeof(VkSubpassDependency));
-	dep.srcSubpass = VK_SUBPASS_EXTERNAL;
-	dep.dstSubpass = 0;
-	dep.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dep.srcAccessMask = 0;
-	dep.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dep.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-	VkRenderPassCreateInfo rend_pass_ci;
-	memset(&rend_pass_ci, 0, sizeof(VkRenderPassCreateInfo));
-	rend_pass_ci.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	rend_pass_ci.attachmentCount = 1;
-	rend_pass_ci.pAttachments = &color_att;
-	rend_pass_ci.subpassCount = 1;
-	rend_pass_ci.pSubpasses = &subpass;
-	rend_pass_ci.dependencyCount = 1;
-	rend_pass_ci.pDependencies = &dep;
-
-	VkResult result = vkCreateRenderPass(self->log_dev, &rend_pass_ci, NULL,
-					     &self->render_pass);
-	if (result != VK_SUCCESS) {
-		fprintf(stderr, "Error creating render pass. err: %s\n",
-			string_VkResult(result));
-	}
-}
-
-void create_frame_buffers(vulkan_engine *self)
-{
-	self->swap_chain_frame_buffers =
-		malloc(sizeof(VkFramebuffer) * self->swap_chain_images_size);
-	for (size_t i = 0; i < self->swap_chain_images_size; i++) {
-		VkImageView attachments[] = { self->swap_chain_image_views[i] };
-
-		VkFramebufferCreateInfo fb_ci;
-		memset(&fb_ci, 0, sizeof(VkFramebufferCreateInfo));
-		fb_ci.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		fb_ci.renderPass = self->render_pass;
-		fb_ci.attachmentCount = 1;
-		fb_ci.pAttachments = attachments;
-		fb_ci.width = self->swap_chain_extent.width;
-		fb_ci.height = self->swap_chain_extent.height;
-		fb_ci.layers = 1;
-		VkResult result =
-			vkCreateFramebuffer(self->log_dev, &fb_ci, NULL,
-					    &self->swap_chain_frame_buffers[i]);
-		if (result != VK_SUCCESS) {
-			fprintf(stderr, "Error creating frame buffer. err: %s\n",
-				string_VkResult(result));
-		}
-	}
+	vk_pipeline_desc_init(&self->default_pipeline_desc);
+	vertex_input_description(&self->default_pipeline_desc);
+	self->default_pipeline_desc.layout = self->pipeline_layout;
+	self->default_pipeline_desc.render_pass = self->render_pass;
+	self->default_pipeline_desc.subpass = 0;
+	self->default_pipeline_desc.color_format = self->swap_chain_image_format;
+	self->default_pipeline_desc.depth_format = self->depth_format;
+
+	// built up front: it is the fallback while other variants compile
+	self->graphics_pipeline =
+		vk_pipelines_get_blocking(&self->pipelines, &self->default_pipeline_desc);
+	self->draw_pipeline = self->graphics_pipeline;
+	self->draw_translucent = desc_translucent(&self->default_pipeline_desc);
 }
 
 void create_command_pool(vulkan_engine *self)
@@ -906,37 +881,88 @@ void create_command_buffers(vulkan_engine *self)
 	}
 }
 
-void record_command_buffer(vulkan_engine *self, VkCommandBuffer buffer,
-			   Uint32 image_idx)
+// Pools and secondary buffers for recording slices of the draw list on the
+// job system. A recorder is used by one job at a time, so its pools need no
+// locking even though the thread running it changes from frame to frame.
+static void create_record_pools(vulkan_engine *self)
 {
-	VkCommandBufferBeginInfo begin_info;
-	memset(&begin_info, 0, sizeof(VkCommandBufferBeginInfo));
-	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	queue_family_indices queue_family_indices;
+	queue_family_indices_init(self->phy_dev, self->sdl_surface,
+				  &queue_family_indices);
 
-	VkResult result;
-	result = vkBeginCommandBuffer(buffer, &begin_info);
-	if (result != VK_SUCCESS) {
-		fprintf(stderr, "Error begin command buffer, err: %s\n",
-			string_VkResult(result));
+	// the main thread records a slice too
+	self->recorder_count = self->jobs.thread_count + 1;
+	if (self->recorder_count > MAX_RECORDERS) {
+		self->recorder_count = MAX_RECORDERS;
+	}
+	Uint32 pool_count = self->recorder_count * MAX_FRAMES_IN_FLIGHT;
+	self->record_pools = malloc(sizeof(VkCommandPool) * pool_count);
+	self->record_buffers = malloc(sizeof(VkCommandBuffer) * pool_count);
+	self->recorders = malloc(sizeof(draw_recorder) * self->recorder_count);
+	memset(&self->record_jobs, 0, sizeof(job_group));
+
+	VkCommandPoolCreateInfo cp_ci;
+	memset(&cp_ci, 0, sizeof(VkCommandPoolCreateInfo));
+	cp_ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	// reset as a whole each time the frame slot comes around
+	cp_ci.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	cp_ci.queueFamilyIndex = queue_family_indices.graphics_family;
+
+	for (Uint32 i = 0; i < pool_count; i++) {
+		VkResult result = vkCreateCommandPool(self->log_dev, &cp_ci, NULL,
+						      &self->record_pools[i]);
+		if (result != VK_SUCCESS) {
+			fprintf(stderr, "Error creating record command pool, err: %s\n",
+				string_VkResult(result));
+			continue;
+		}
+
+		VkCommandBufferAllocateInfo buf_info;
+		memset(&buf_info, 0, sizeof(VkCommandBufferAllocateInfo));
+		buf_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		buf_info.commandPool = self->record_pools[i];
+		buf_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		buf_info.commandBufferCount = 1;
+
+		result = vkAllocateCommandBuffers(self->log_dev, &buf_info,
+						  &self->record_buffers[i]);
+		if (result != VK_SUCCESS) {
+			fprintf(stderr, "Error allocating secondary command buffer, err: %s\n",
+				string_VkResult(result));
+		}
 	}
+}
 
-	VkRenderPassBeginInfo rend_info;
-	memset(&rend_info, 0, sizeof(VkRenderPassBeginInfo));
-	rend_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	rend_info.renderPass = self->render_pass;
-	rend_info.framebuffer = self->swap_chain_frame_buffers[image_idx];
-	rend_info.renderArea.extent = self->swap_chain_extent;
-	rend_info.renderArea.offset.x = 0;
-	rend_info.renderArea.offset.y = 0;
+static void destroy_record_pools(vulkan_engine *self)
+{
+	for (Uint32 i = 0; i < self->recorder_count * MAX_FRAMES_IN_FLIGHT; i++) {
+		vkDestroyCommandPool(self->log_dev, self->record_pools[i], NULL);
+	}
+	free(self->record_pools);
+	free(self->record_buffers);
+	free(self->recorders);
+}
 
-	VkClearValue clear = { { { 0.0f, 0.0f, 0.0f, 1.0f } } };
-	rend_info.clearValueCount = 1;
-	rend_info.pClearValues = &clear;
+static void record_cull_draw(vulkan_engine *self, VkCommandBuffer buffer,
+			     VkPipeline *bound_pipeline)
+{
+	if (*bound_pipeline != self->graphics_pipeline) {
+		vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+				  self->graphics_pipeline);
+		*bound_pipeline = self->graphics_pipeline;
+	}
+	vk_cull_draw(&self->cull, buffer);
+}
 
-	vkCmdBeginRenderPass(buffer, &rend_info, VK_SUBPASS_CONTENTS_INLINE);
+// Records a slice of the draw list inside the render pass. Everything a draw
+// depends on is bound here since secondary buffers inherit no state.
+static void record_draws(const draw_recorder *rec, VkCommandBuffer buffer)
+{
+	vulkan_engine *self = rec->engine;
 
 	vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
 			  self->graphics_pipeline);
+	VkPipeline bound_pipeline = self->graphics_pipeline;
 
 	VkViewport viewport;
 	memset(&viewport, 0, sizeof(VkViewport));
@@ -954,8 +980,224 @@ void record_command_buffer(vulkan_engine *self, VkCommandBuffer buffer,
 	scissor.extent = self->swap_chain_extent;
 	vkCmdSetScissor(buffer, 0, 1, &scissor);
 
-	vkCmdDraw(buffer, 3, 1, 0, 0);
-	vkCmdEndRenderPass(buffer);
+	Uint32 dynamic_offsets[] = { (Uint32)rec->camera_offset };
+	vkCmdBindDescriptorSets(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+				self->pipeline_layout, 0, 1, &self->frame_descriptor_set,
+				1, dynamic_offsets);
+
+	vk_mesh_pool_bind(&self->meshes, buffer);
+
+	// the culled draws are opaque, so they go between the opaque draws and
+	// the translucent ones blended over them
+	Uint32 end = rec->first_draw + rec->draw_count;
+	if (rec->has_instances && rec->draw_count > 0) {
+		vkCmdBindVertexBuffers(buffer, 1, 1, &self->frame_ring.buffer,
+				       &rec->instance_offset);
+		for (Uint32 i = rec->first_draw; i < end; i++) {
+			if (rec->cull_draw && i == rec->cull_at) {
+				record_cull_draw(self, buffer, &bound_pipeline);
+				vkCmdBindVertexBuffers(buffer, 1, 1, &self->frame_ring.buffer,
+						       &rec->instance_offset);
+			}
+			draw_cmd *draw = &self->draw_list[i];
+			vk_mesh *mesh = vk_mesh_pool_get(&self->meshes, draw->mesh);
+			if (mesh == NULL) {
+				continue;
+			}
+			if (draw->pipeline != bound_pipeline) {
+				vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+						  draw->pipeline);
+				bound_pipeline = draw->pipeline;
+			}
+			vkCmdDrawIndexed(buffer, mesh->index_count, draw->instance_count,
+					 mesh->first_index, mesh->vertex_offset,
+					 draw->first_instance);
+		}
+	}
+
+	if (rec->cull_draw && (rec->cull_at >= end || !rec->has_instances)) {
+		record_cull_draw(self, buffer, &bound_pipeline);
+	}
+}
+
+static void record_secondary(void *data)
+{
+	draw_recorder *rec = data;
+	vulkan_engine *self = rec->engine;
+
+	vkResetCommandPool(self->log_dev, rec->pool, 0);
+
+	vk_rg_inheritance inherit;
+	vk_render_graph_inheritance(&self->graph, self->main_pass, rec->image_idx,
+				    &inherit);
+
+	VkCommandBufferBeginInfo begin_info;
+	memset(&begin_info, 0, sizeof(VkCommandBufferBeginInfo));
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+			   VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	begin_info.pInheritanceInfo = &inherit.info;
+
+	VkResult result = vkBeginCommandBuffer(rec->cmd, &begin_info);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error begin secondary command buffer, err: %s\n",
+			string_VkResult(result));
+		return;
+	}
+
+	record_draws(rec, rec->cmd);
+
+	result = vkEndCommandBuffer(rec->cmd);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error with recording secondary command buffer, err: %s\n",
+			string_VkResult(result));
+	}
+}
+
+// Splits the draw list across the recorders. Returns the number of slices,
+// the first of which is left for the calling thread.
+static Uint32 plan_recorders(vulkan_engine *self, const draw_recorder *frame)
+{
+	Uint32 slices = (self->draw_count + RECORD_DRAWS_PER_JOB - 1) /
+			RECORD_DRAWS_PER_JOB;
+	if (slices > self->recorder_count) {
+		slices = self->recorder_count;
+	}
+	Uint32 per_slice = (self->draw_count + slices - 1) / slices;
+
+	Uint32 first = 0;
+	for (Uint32 i = 0; i < slices; i++) {
+		Uint32 idx = self->current_frame * self->recorder_count + i;
+		draw_recorder *rec = &self->recorders[i];
+		*rec = *frame;
+		rec->pool = self->record_pools[idx];
+		rec->cmd = self->record_buffers[idx];
+		rec->first_draw = first;
+		rec->draw_count = self->draw_count - first < per_slice
+					  ? self->draw_count - first
+					  : per_slice;
+		// the slice holding the first translucent draw, or the last one
+		rec->cull_draw = frame->cull_draw && frame->cull_at >= first &&
+				 (frame->cull_at < first + rec->draw_count ||
+				  i == slices - 1);
+		first += rec->draw_count;
+	}
+
+	return slices;
+}
+
+// Copies the camera and the queued instances into this frame's ring slice.
+static void write_frame_data(vulkan_engine *self, draw_recorder *frame)
+{
+	camera_data *camera = vk_frame_ring_alloc(&self->frame_ring, sizeof(camera_data),
+						  0, &frame->camera_offset);
+	if (camera != NULL) {
+		memcpy(camera, &self->camera, sizeof(camera_data));
+	}
+
+	// instances queued since the last frame go into this frame's slice
+	instance_data *instances = NULL;
+	if (self->instance_count > 0) {
+		instances = vk_frame_ring_alloc(&self->frame_ring,
+						sizeof(instance_data) * self->instance_count,
+						16, &frame->instance_offset);
+	}
+	if (instances != NULL) {
+		memcpy(instances, self->instance_list,
+		       sizeof(instance_data) * self->instance_count);
+		frame->has_instances = true;
+	}
+}
+
+static void init_frame(vulkan_engine *self, draw_recorder *frame, Uint32 image_idx)
+{
+	memset(frame, 0, sizeof(draw_recorder));
+	frame->engine = self;
+	frame->image_idx = image_idx;
+	frame->draw_count = self->draw_count;
+	frame->cull_draw = self->multi_draw_indirect;
+	// sorted lists keep their translucent draws at the end
+	frame->cull_at = self->draw_count;
+	for (Uint32 i = 0; i < self->draw_count; i++) {
+		if (self->draw_list[i].translucent) {
+			frame->cull_at = i;
+			break;
+		}
+	}
+}
+
+// What the graph's passes record from, passed through vk_render_graph_execute.
+typedef struct {
+	draw_recorder *frame;
+	Uint32 slices; // secondary buffers being recorded, 0 to record inline
+} frame_record;
+
+// The indirect draw buffers it writes are synchronized by vk_cull itself.
+static void record_cull_pass(void *data, const vk_rg_context *ctx)
+{
+	vulkan_engine *self = data;
+	Uint32 cull_scope = vk_profiler_begin(&self->profiler, ctx->cmd, "cull");
+	vk_cull_dispatch(&self->cull, ctx->cmd, self->camera.view_proj);
+	vk_profiler_end(&self->profiler, ctx->cmd, cull_scope);
+}
+
+static void record_main_pass(void *data, const vk_rg_context *ctx)
+{
+	vulkan_engine *self = data;
+	frame_record *rec = ctx->frame;
+
+	// timestamps can't go inside a pass made of secondary buffers
+	Uint32 pass_scope = vk_profiler_begin(&self->profiler, ctx->cmd, "main pass");
+	if (rec->slices > 0) {
+		vk_render_graph_begin_pass(ctx, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		record_secondary(&self->recorders[0]);
+		// runs the slices no worker has picked up, so compiles holding
+		// every worker don't hold up the frame
+		job_system_wait_group(&self->jobs, &self->record_jobs);
+
+		VkCommandBuffer secondaries[MAX_RECORDERS];
+		for (Uint32 i = 0; i < rec->slices; i++) {
+			secondaries[i] = self->recorders[i].cmd;
+		}
+		vkCmdExecuteCommands(ctx->cmd, rec->slices, secondaries);
+	} else {
+		vk_render_graph_begin_pass(ctx, VK_SUBPASS_CONTENTS_INLINE);
+		record_draws(rec->frame, ctx->cmd);
+	}
+	vk_render_graph_end_pass(ctx);
+	vk_profiler_end(&self->profiler, ctx->cmd, pass_scope);
+}
+
+// `frame` comes from write_frame_data. Secondary buffers are reset when their
+// slot comes around again, so reusable recordings pass parallel = false.
+void record_command_buffer(vulkan_engine *self, VkCommandBuffer buffer,
+			   draw_recorder *frame, bool parallel)
+{
+	// long draw lists are recorded in parallel into secondary buffers
+	frame_record rec = { .frame = frame, .slices = 0 };
+	if (parallel && frame->has_instances && self->draw_count >= RECORD_DRAWS_PER_JOB) {
+		rec.slices = plan_recorders(self, frame);
+		for (Uint32 i = 1; i < rec.slices; i++) {
+			job_system_push_group(&self->jobs, &self->record_jobs,
+					      record_secondary, &self->recorders[i]);
+		}
+	}
+
+	VkCommandBufferBeginInfo begin_info;
+	memset(&begin_info, 0, sizeof(VkCommandBufferBeginInfo));
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+	VkResult result;
+	result = vkBeginCommandBuffer(buffer, &begin_info);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error begin command buffer, err: %s\n",
+			string_VkResult(result));
+	}
+
+	vk_profiler_reset(&self->profiler, buffer, self->current_frame);
+	Uint32 frame_scope = vk_profiler_begin(&self->profiler, buffer, "frame");
+	vk_render_graph_execute(&self->graph, buffer, frame->image_idx, &rec);
+	vk_profiler_end(&self->profiler, buffer, frame_scope);
 
 	result = vkEndCommandBuffer(buffer);
 	if (result != VK_SUCCESS) {
@@ -964,56 +1206,423 @@ void record_command_buffer(vulkan_engine *self, VkCommandBuffer buffer,
 	}
 }
 
+// The graph decides every barrier and layout, so passes such as shadows or
+// post-processing only declare what they use. Pipelines are built against the
+// main pass's render pass.
+static void create_render_graph(vulkan_engine *self)
+{
+	vk_render_graph_init(&self->graph, &self->allocator, self->log_dev,
+			     self->dynamic_rendering);
+	self->depth_format = find_depth_format(self->phy_dev);
+
+	// cleared every frame; headless targets are only ever read back
+	self->swap_chain_target = vk_render_graph_import(
+		&self->graph, "swapchain", self->swap_chain_image_format,
+		VK_IMAGE_LAYOUT_UNDEFINED,
+		self->headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+			       : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+	vk_render_graph_bind_images(&self->graph, self->swap_chain_target,
+				    self->swap_chain_images, self->swap_chain_image_views,
+				    self->swap_chain_images_size);
+	self->depth_target =
+		vk_render_graph_image(&self->graph, "depth", self->depth_format, 0, 0);
+
+	if (self->multi_draw_indirect) {
+		Uint32 cull_pass = vk_render_graph_add_pass(
+			&self->graph, "cull", VK_RG_PASS_COMPUTE, record_cull_pass, self);
+		vk_render_graph_keep(&self->graph, cull_pass);
+	}
+
+	self->main_pass = vk_render_graph_add_pass(&self->graph, "main",
+						   VK_RG_PASS_GRAPHICS, record_main_pass,
+						   self);
+	VkClearColorValue black = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+	vk_render_graph_color(&self->graph, self->main_pass, self->swap_chain_target,
+			      VK_ATTACHMENT_LOAD_OP_CLEAR, &black);
+	vk_render_graph_depth(&self->graph, self->main_pass, self->depth_target,
+			      VK_ATTACHMENT_LOAD_OP_CLEAR, 1.0f);
+
+	if (!vk_render_graph_compile(&self->graph, self->swap_chain_extent)) {
+		fprintf(stderr, "Error compiling the render graph\n");
+	}
+	self->render_pass = vk_render_graph_render_pass(&self->graph, self->main_pass);
+}
+
 void create_sync_objects(vulkan_engine *self)
 {
+	// acquire and present only take binary semaphores, so those stay per slot
 	self->image_avail_sems = malloc(sizeof(VkSemaphore) * MAX_FRAMES_IN_FLIGHT);
 	self->rend_finished_sems = malloc(sizeof(VkSemaphore) * MAX_FRAMES_IN_FLIGHT);
-	self->in_flight_fences = malloc(sizeof(VkSemaphore) * MAX_FRAMES_IN_FLIGHT);
 
 	VkSemaphoreCreateInfo sem_info;
 	memset(&sem_info, 0, sizeof(VkSemaphoreCreateInfo));
 	sem_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-	VkFenceCreateInfo fen_info;
-	memset(&fen_info, 0, sizeof(VkFenceCreateInfo));
-	fen_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fen_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+	for (Uint32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 		if (vkCreateSemaphore(self->log_dev, &sem_info, NULL,
 				      &self->image_avail_sems[i]) != VK_SUCCESS ||
 		    vkCreateSemaphore(self->log_dev, &sem_info, NULL,
-				      &self->rend_finished_sems[i]) != VK_SUCCESS ||
-		    vkCreateFence(self->log_dev, &fen_info, NULL,
-				  &self->in_flight_fences[i]) != VK_SUCCESS) {
+				      &self->rend_finished_sems[i]) != VK_SUCCESS) {
 			fprintf(stderr, "Error creating sync objects\n");
 		}
 	}
+
+	VkSemaphoreTypeCreateInfo type_info;
+	memset(&type_info, 0, sizeof(VkSemaphoreTypeCreateInfo));
+	type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	type_info.initialValue = 0;
+	sem_info.pNext = &type_info;
+
+	VkResult result =
+		vkCreateSemaphore(self->log_dev, &sem_info, NULL, &self->frame_timeline);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error creating frame timeline semaphore, err: %s\n",
+			string_VkResult(result));
+	}
+}
+
+// Block until the GPU has finished frame `frame`.
+static void wait_for_frame(vulkan_engine *self, Uint64 frame)
+{
+	Uint64 value = frame + 1;
+	VkSemaphoreWaitInfo wait_info;
+	memset(&wait_info, 0, sizeof(VkSemaphoreWaitInfo));
+	wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	wait_info.semaphoreCount = 1;
+	wait_info.pSemaphores = &self->frame_timeline;
+	wait_info.pValues = &value;
+
+	VkResult result = vkWaitSemaphores(self->log_dev, &wait_info, UINT64_MAX);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error waiting for frame timeline, err: %s\n",
+			string_VkResult(result));
+	}
+}
+
+// One reusable recording per frame slot and swapchain image. Called whenever
+// the swapchain is (re)created, which also invalidates every recording.
+static void create_static_recordings(vulkan_engine *self)
+{
+	Uint32 count = MAX_FRAMES_IN_FLIGHT * self->swap_chain_images_size;
+	self->static_recordings = calloc(count, sizeof(static_recording));
+
+	VkCommandBuffer buffers[count];
+	VkCommandBufferAllocateInfo buf_info;
+	memset(&buf_info, 0, sizeof(VkCommandBufferAllocateInfo));
+	buf_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	buf_info.commandPool = self->command_pool;
+	buf_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	buf_info.commandBufferCount = count;
+
+	VkResult result = vkAllocateCommandBuffers(self->log_dev, &buf_info, buffers);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error allocating static command buffers, err: %s\n",
+			string_VkResult(result));
+		return;
+	}
+	for (Uint32 i = 0; i < count; i++) {
+		self->static_recordings[i].cmd = buffers[i];
+	}
+}
+
+static void destroy_static_recordings(vulkan_engine *self)
+{
+	Uint32 count = MAX_FRAMES_IN_FLIGHT * self->swap_chain_images_size;
+	for (Uint32 i = 0; i < count; i++) {
+		if (self->static_recordings[i].cmd != VK_NULL_HANDLE) {
+			vkFreeCommandBuffers(self->log_dev, self->command_pool, 1,
+					     &self->static_recordings[i].cmd);
+		}
+	}
+	free(self->static_recordings);
+	self->static_recordings = NULL;
+}
+
+// Clip space depth of the first instance's origin, quantized to 16 bits.
+static Uint64 draw_depth(vulkan_engine *self, const draw_cmd *draw)
+{
+	vec4 origin;
+	glm_vec4_copy(self->instance_list[draw->first_instance].model[3], origin);
+	vec4 clip;
+	glm_mat4_mulv(self->camera.view_proj, origin, clip);
+	float depth = clip[3] > 0.0f ? clip[2] / clip[3] : 1.0f;
+	depth = depth < 0.0f ? 0.0f : depth > 1.0f ? 1.0f : depth;
+	return (Uint64)(depth * 65535.0f);
+}
+
+// Opaque draws go first, grouped by pipeline then mesh so binds repeat as
+// little as possible, and front to back within a group so early depth tests
+// reject what's hidden. Translucent draws go last and back to front. Bits
+// 40-51 are left for a material once draws carry one.
+static Uint64 draw_sort_key(vulkan_engine *self, const draw_cmd *draw)
+{
+	Uint64 depth = draw_depth(self, draw);
+	if (draw->translucent) {
+		return (1ull << 63) | ((0xffffull - depth) << 47);
+	}
+	// the pipeline handle's bits are hashed down to 11
+	Uint64 pipeline =
+		((Uint64)(uintptr_t)draw->pipeline * 0x9e3779b97f4a7c15ull) >> 53;
+	return (pipeline << 52) | (((Uint64)draw->mesh & 0xffffff) << 16) | depth;
+}
+
+// The sort is stable, so equal keys keep their submission order.
+static void sort_draws(vulkan_engine *self)
+{
+	Uint32 count = self->draw_count;
+	if (count > self->sort_cap) {
+		self->sort_cap = self->draw_cap;
+		self->sort_keys =
+			realloc(self->sort_keys, sizeof(Uint64) * self->sort_cap);
+		self->sort_tmp_keys =
+			realloc(self->sort_tmp_keys, sizeof(Uint64) * self->sort_cap);
+		self->sort_order =
+			realloc(self->sort_order, sizeof(Uint32) * self->sort_cap);
+		self->sort_tmp_order =
+			realloc(self->sort_tmp_order, sizeof(Uint32) * self->sort_cap);
+		self->sorted_draws =
+			realloc(self->sorted_draws, sizeof(draw_cmd) * self->sort_cap);
+	}
+
+	for (Uint32 i = 0; i < count; i++) {
+		self->sort_keys[i] = draw_sort_key(self, &self->draw_list[i]);
+		self->sort_order[i] = i;
+	}
+	radix_sort_u64(self->sort_keys, self->sort_order, self->sort_tmp_keys,
+		       self->sort_tmp_order, count);
+	for (Uint32 i = 0; i < count; i++) {
+		// memcpy keeps the padding too, static frames memcmp draw lists
+		memcpy(&self->sorted_draws[i], &self->draw_list[self->sort_order[i]],
+		       sizeof(draw_cmd));
+	}
+	memcpy(self->draw_list, self->sorted_draws, sizeof(draw_cmd) * count);
+}
+
+// The draw list is requeued every frame, so compare it with the one the
+// current recordings were made from. The camera only matters to the culling
+// dispatch, whose frustum planes are push constants.
+static bool static_scene_changed(vulkan_engine *self)
+{
+	if (self->static_draw_count != self->draw_count ||
+	    self->static_instance_count != self->instance_count) {
+		return true;
+	}
+	if (memcmp(self->static_draws, self->draw_list,
+		   sizeof(draw_cmd) * self->draw_count) != 0) {
+		return true;
+	}
+	return self->multi_draw_indirect &&
+	       memcmp(&self->static_camera, &self->camera, sizeof(camera_data)) != 0;
+}
+
+static void static_begin_generation(vulkan_engine *self)
+{
+	if (self->draw_count > self->static_draw_cap) {
+		self->static_draw_cap = self->draw_count;
+		self->static_draws =
+			realloc(self->static_draws, sizeof(draw_cmd) * self->static_draw_cap);
+	}
+	if (self->draw_count > 0) {
+		memcpy(self->static_draws, self->draw_list,
+		       sizeof(draw_cmd) * self->draw_count);
+	}
+	self->static_draw_count = self->draw_count;
+	self->static_instance_count = self->instance_count;
+	memcpy(&self->static_camera, &self->camera, sizeof(camera_data));
+	self->static_generation++;
+	self->static_dirty = false;
+}
+
+// Returns the command buffer to submit for this frame in static frames mode,
+// re-recording it only if the scene changed since it was last recorded.
+static VkCommandBuffer static_command_buffer(vulkan_engine *self, Uint32 image_idx)
+{
+	if (self->static_dirty || static_scene_changed(self)) {
+		static_begin_generation(self);
+	}
+
+	draw_recorder frame;
+	init_frame(self, &frame, image_idx);
+	write_frame_data(self, &frame);
+
+	static_recording *rec =
+		&self->static_recordings[self->current_frame * self->swap_chain_images_size +
+					 image_idx];
+	if (rec->generation == self->static_generation &&
+	    rec->camera_offset == frame.camera_offset &&
+	    rec->instance_offset == frame.instance_offset) {
+		self->reused_frames++;
+		return rec->cmd;
+	}
+
+	vkResetCommandBuffer(rec->cmd, 0);
+	record_command_buffer(self, rec->cmd, &frame, false);
+	rec->generation = self->static_generation;
+	rec->camera_offset = frame.camera_offset;
+	rec->instance_offset = frame.instance_offset;
+	return rec->cmd;
+}
+
+// Runs at the frame boundary: pipelines rebuilt from changed shaders are
+// swapped in here and the replaced ones retire until no frame can use them.
+static void reload_shaders(vulkan_engine *self)
+{
+	if (self->shader_reload) {
+		const shader_source *changed[shader_sources_size];
+		Uint32 count = shader_watch_poll(&self->shader_watch, changed,
+						 shader_sources_size);
+		for (Uint32 i = 0; i < count; i++) {
+			if (strcmp(changed[i]->output, "build/cull.spv") == 0) {
+				vk_cull_reload(&self->cull, &self->jobs);
+			} else {
+				vk_pipelines_reload_shader(&self->pipelines,
+							   changed[i]->output);
+			}
+		}
+	}
+
+	VkPipeline old_cull = vk_cull_update(&self->cull);
+	if (old_cull != VK_NULL_HANDLE) {
+		vulkan_engine_defer_deletion(
+			self,
+			&(vk_deletion){ .type = VK_DELETE_PIPELINE, .pipeline = old_cull });
+		self->static_dirty = true;
+	}
+
+	if (vk_pipelines_update(&self->pipelines, self->frame_num) > 0) {
+		// the default pipeline may be one of the swapped ones
+		self->graphics_pipeline = vk_pipelines_get_blocking(
+			&self->pipelines, &self->default_pipeline_desc);
+		self->static_dirty = true;
+	}
+}
+
+// The queued draws are consumed, the next frame starts from an empty list.
+static void reset_draws(vulkan_engine *self)
+{
+	self->draw_count = 0;
+	self->instance_count = 0;
+	self->draw_pipeline = self->graphics_pipeline;
+	self->draw_translucent = desc_translucent(&self->default_pipeline_desc);
+}
+
+static void record_frame_timings(vulkan_engine *self, double t_start,
+				 double t_housekeeping, double t_acquire,
+				 double t_record, double t_submit, double t_present,
+				 double t_end)
+{
+	static const frame_stat stages[] = { FRAME_STAT_WAIT, FRAME_STAT_HOUSEKEEPING,
+					     FRAME_STAT_ACQUIRE, FRAME_STAT_RECORD,
+					     FRAME_STAT_SUBMIT, FRAME_STAT_PRESENT };
+	double bounds[] = { t_start,  t_housekeeping, t_acquire, t_record,
+			    t_submit, t_present,      t_end };
+
+	for (Uint32 i = 0; i < sizeof(stages) / sizeof(stages[0]); i++) {
+		frame_stats_add(&self->stats, stages[i], (bounds[i + 1] - bounds[i]) / 1000.0);
+		vk_profiler_cpu_scope(&self->profiler, frame_stat_name(stages[i]),
+				      bounds[i], bounds[i + 1], self->frame_num);
+	}
+	frame_stats_add(&self->stats, FRAME_STAT_CPU, (t_end - t_start) / 1000.0);
+	frame_stats_end_frame(&self->stats, t_end / 1000.0);
+}
+
+// The acquired image was never presented, so it stays held and its semaphore
+// stays signaled; the next acquire on this slot must not wait on it. The
+// swapchain is recreated to give the image back and the semaphore replaced.
+// Nothing ever waited on the old one, so the frame timeline says nothing
+// about it: this rare path idles the device before destroying it.
+static void replace_acquire_semaphore(vulkan_engine *self)
+{
+	vulkan_engine_recreate_swap_chain(self);
+
+	VkSemaphoreCreateInfo sem_info;
+	memset(&sem_info, 0, sizeof(VkSemaphoreCreateInfo));
+	sem_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	VkSemaphore sem;
+	VkResult result = vkCreateSemaphore(self->log_dev, &sem_info, NULL, &sem);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error creating image available semaphore, err: %s\n",
+			string_VkResult(result));
+		return;
+	}
+	vkDeviceWaitIdle(self->log_dev);
+	vkDestroySemaphore(self->log_dev, self->image_avail_sems[self->current_frame], NULL);
+	self->image_avail_sems[self->current_frame] = sem;
 }
 
 void vulkan_engine_draw_frame(vulkan_engine *self)
 {
 	VkResult result;
 
-	vkWaitForFences(self->log_dev, 1, &self->in_flight_fences[self->current_frame],
-			VK_TRUE, UINT64_MAX);
+	// stage boundaries on the profiler's clock, in microseconds
+	double t_start = vk_profiler_now_us(&self->profiler);
+	if (self->last_frame_start_us > 0.0) {
+		frame_stats_add(&self->stats, FRAME_STAT_FRAME,
+				(t_start - self->last_frame_start_us) / 1000.0);
+	}
+	self->last_frame_start_us = t_start;
 
-	Uint32 image_idx;
-	result = vkAcquireNextImageKHR(self->log_dev, self->swap_chain, UINT64_MAX,
-				       self->image_avail_sems[self->current_frame],
-				       NULL, &image_idx);
+	// the frame that last used this slot is frames_in_flight behind
+	if (self->frame_num >= self->frames_in_flight) {
+		wait_for_frame(self, self->frame_num - self->frames_in_flight);
+	}
+	double t_housekeeping = vk_profiler_now_us(&self->profiler);
+	vk_profiler_collect(&self->profiler, self->current_frame);
+	if (self->deletions.count > 0) {
+		vk_deletion_queue_flush(&self->deletions,
+					vulkan_engine_frames_completed(self));
+	}
+	if (vk_capture_pending(&self->capture) > 0) {
+		vk_capture_poll(&self->capture, vulkan_engine_frames_completed(self));
+	}
+	// may block on a compile when the default pipeline was swapped
+	reload_shaders(self);
+
+	double t_acquire = vk_profiler_now_us(&self->profiler);
+	Uint32 image_idx = self->current_frame;
+	result = self->headless ? VK_SUCCESS
+				: vkAcquireNextImageKHR(
+					  self->log_dev, self->swap_chain, UINT64_MAX,
+					  self->image_avail_sems[self->current_frame], NULL,
+					  &image_idx);
 	if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+		// nothing was acquired, so the semaphore is unsignaled; skip the
+		// frame, and its draws with it so they aren't drawn twice
+		reset_draws(self);
 		vulkan_engine_recreate_swap_chain(self);
+		return;
 	} else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
 		fprintf(stderr, "Error acquiring next image from swap chain, err: %s\n",
 			string_VkResult(result));
 	}
 
-	vkResetFences(self->log_dev, 1, &self->in_flight_fences[self->current_frame]);
+	double t_record = vk_profiler_now_us(&self->profiler);
+
+	// the timeline wait above guarantees the GPU is done with this slice
+	vk_frame_ring_begin(&self->frame_ring, self->current_frame);
 
-	vkResetCommandBuffer(self->command_buffers[self->current_frame], 0);
+	// sorted first so static frames compare the order they'd record
+	if (self->sort_draws && self->draw_count > 1) {
+		sort_draws(self);
+	}
+	VkCommandBuffer cmd = self->command_buffers[self->current_frame];
+	if (self->static_frames) {
+		cmd = static_command_buffer(self, image_idx);
+	} else {
+		draw_recorder frame;
+		init_frame(self, &frame, image_idx);
+		write_frame_data(self, &frame);
+		vkResetCommandBuffer(cmd, 0);
+		record_command_buffer(self, cmd, &frame, true);
+	}
+	reset_draws(self);
 
-	record_command_buffer(self, self->command_buffers[self->current_frame],
-			      image_idx);
+	// pending uploads go first on the same queue so this frame can read them
+	double t_submit = vk_profiler_now_us(&self->profiler);
+	vk_upload_flush(&self->upload);
 
 	VkSubmitInfo submit_info;
 	memset(&submit_info, 0, sizeof(VkSubmitInfo));
@@ -1023,22 +1632,69 @@ void vulkan_engine_draw_frame(vulkan_engine *self)
 	VkPipelineStageFlags wait_stages[] = {
 		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
 	};
-	submit_info.waitSemaphoreCount = 1;
+	submit_info.waitSemaphoreCount = self->headless ? 0 : 1;
 	submit_info.pWaitSemaphores = wait_sems;
 	submit_info.pWaitDstStageMask = wait_stages;
-	submit_info.commandBufferCount = 1;
-	submit_info.pCommandBuffers = &self->command_buffers[self->current_frame];
-
-	VkSemaphore signal_sems[] = { self->rend_finished_sems[self->current_frame] };
-	submit_info.signalSemaphoreCount = 1;
-	submit_info.pSignalSemaphores = signal_sems;
-
-	result = vkQueueSubmit(self->graphics_queue, 1, &submit_info,
-			       self->in_flight_fences[self->current_frame]);
-	if (result != VK_SUCCESS) {
+	// a capture copies the image right after the frame, in the same submit
+	VkCommandBuffer cmds[] = { cmd, VK_NULL_HANDLE };
+	if (self->capture_supported) {
+		cmds[1] = vk_capture_record(
+			&self->capture, self->current_frame,
+			self->swap_chain_images[image_idx], self->swap_chain_image_format,
+			self->swap_chain_extent,
+			self->headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+				       : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+			self->frame_num);
+	}
+	submit_info.commandBufferCount = cmds[1] != VK_NULL_HANDLE ? 2 : 1;
+	submit_info.pCommandBuffers = cmds;
+
+	// headless only signals the timeline, there is no present to wait
+	Uint32 first_signal = self->headless ? 1 : 0;
+	VkSemaphore signal_sems[] = { self->rend_finished_sems[self->current_frame],
+				      self->frame_timeline };
+	submit_info.signalSemaphoreCount = 2 - first_signal;
+	submit_info.pSignalSemaphores = &signal_sems[first_signal];
+
+	// binary semaphores ignore their values
+	Uint64 wait_values[] = { 0 };
+	Uint64 signal_values[] = { 0, self->frame_num + 1 };
+	VkTimelineSemaphoreSubmitInfo timeline_info;
+	memset(&timeline_info, 0, sizeof(VkTimelineSemaphoreSubmitInfo));
+	timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timeline_info.waitSemaphoreValueCount = submit_info.waitSemaphoreCount;
+	timeline_info.pWaitSemaphoreValues = wait_values;
+	timeline_info.signalSemaphoreValueCount = submit_info.signalSemaphoreCount;
+	timeline_info.pSignalSemaphoreValues = &signal_values[first_signal];
+	submit_info.pNext = &timeline_info;
+
+	vk_profiler_submit(&self->profiler, self->current_frame, self->frame_num);
+	result = vkQueueSubmit(self->graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
+	bool submitted = result == VK_SUCCESS;
+	if (!submitted) {
 		fprintf(stderr,
 			"Error submitting command buffer to graphics queue, err: %s\n",
 			string_VkResult(result));
+		// nothing will signal this frame's value, and every later wait
+		// for it would block forever. A host signal must stay below the
+		// pending ones, and the value marks every earlier frame done too,
+		// so the previous frame has to really finish first.
+		if (self->frame_num > 0) {
+			wait_for_frame(self, self->frame_num - 1);
+		}
+		// the frame's capture slot would otherwise be encoded uncopied
+		if (cmds[1] != VK_NULL_HANDLE) {
+			vk_capture_cancel(&self->capture, self->frame_num);
+		}
+		VkSemaphoreSignalInfo signal_info;
+		memset(&signal_info, 0, sizeof(VkSemaphoreSignalInfo));
+		signal_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO;
+		signal_info.semaphore = self->frame_timeline;
+		signal_info.value = self->frame_num + 1;
+		vkSignalSemaphore(self->log_dev, &signal_info);
+		if (!self->headless) {
+			replace_acquire_semaphore(self);
+		}
 	}
 
 	VkPresentInfoKHR present_info;
@@ -1052,9 +1708,13 @@ void vulkan_engine_draw_frame(vulkan_engine *self)
 	present_info.pSwapchains = swap_chains;
 	present_info.pImageIndices = &image_idx;
 
-	result = vkQueuePresentKHR(self->present_queue, &present_info);
-	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
-	    self->fb_resized_flag) {
+	// the render finished semaphore is never signaled without the submit
+	double t_present = vk_profiler_now_us(&self->profiler);
+	result = self->headless || !submitted
+			 ? VK_SUCCESS
+			 : vkQueuePresentKHR(self->present_queue, &present_info);
+	if (!self->headless && (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
+	    self->fb_resized_flag)) {
 		self->fb_resized_flag = false;
 		vulkan_engine_recreate_swap_chain(self);
 	} else if (result != VK_SUCCESS) {
@@ -1062,100 +1722,625 @@ void vulkan_engine_draw_frame(vulkan_engine *self)
 			string_VkResult(result));
 	}
 
-	self->current_frame = (self->current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+	double t_end = vk_profiler_now_us(&self->profiler);
+	record_frame_timings(self, t_start, t_housekeeping, t_acquire, t_record,
+			     t_submit, t_present, t_end);
+
+	self->current_frame = (self->current_frame + 1) % self->frames_in_flight;
+	self->frame_num++;
 }
 
-static void create_vertex_buffer(vulkan_engine *self)
+static void create_upload_ring(vulkan_engine *self)
 {
-	VkBufferCreateInfo buf_info;
-	memset(&buf_info, 1, sizeof(VkBufferCreateInfo));
+	queue_family_indices queue_family_indices;
+	queue_family_indices_init(self->phy_dev, self->sdl_surface,
+				  &queue_family_indices);
 
-	buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	buf_info.size = sizeof(VERTICES[0]) * 3; // TODO hardcoded again baby
-	buf_info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-	buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	vk_upload_ring_init(&self->upload, &self->allocator, self->phy_dev,
+			    self->log_dev, self->graphics_queue,
+			    queue_family_indices.graphics_family);
+}
 
-	VkResult result =
-		vkCreateBuffer(self->log_dev, &buf_info, NULL, &self->vertex_buffer);
+static void create_frame_ring(vulkan_engine *self)
+{
+	vk_frame_ring_init(&self->frame_ring, &self->allocator, self->phy_dev,
+			   MAX_FRAMES_IN_FLIGHT);
+	glm_mat4_identity(self->camera.view_proj);
+}
+
+// One set serves every frame: the ring slice and the allocation inside it
+// are selected with dynamic offsets at bind time.
+static void create_descriptor_sets(vulkan_engine *self)
+{
+	VkDescriptorPoolSize pool_size = {
+		.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+		.descriptorCount = 1,
+	};
+
+	VkDescriptorPoolCreateInfo pool_ci;
+	memset(&pool_ci, 0, sizeof(VkDescriptorPoolCreateInfo));
+	pool_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_ci.maxSets = 1;
+	pool_ci.poolSizeCount = 1;
+	pool_ci.pPoolSizes = &pool_size;
+
+	VkResult result = vkCreateDescriptorPool(self->log_dev, &pool_ci, NULL,
+						 &self->descriptor_pool);
 	if (result != VK_SUCCESS) {
-		fprintf(stderr, "Error with queing present, err: %s\n",
+		fprintf(stderr, "Error creating descriptor pool, err: %s\n",
+			string_VkResult(result));
+	}
+
+	VkDescriptorSetAllocateInfo set_info;
+	memset(&set_info, 0, sizeof(VkDescriptorSetAllocateInfo));
+	set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	set_info.descriptorPool = self->descriptor_pool;
+	set_info.descriptorSetCount = 1;
+	set_info.pSetLayouts = &self->descriptor_set_layout;
+
+	result = vkAllocateDescriptorSets(self->log_dev, &set_info,
+					  &self->frame_descriptor_set);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error allocating descriptor set, err: %s\n",
 			string_VkResult(result));
 	}
+
+	VkDescriptorBufferInfo camera_info = {
+		.buffer = self->frame_ring.buffer,
+		.offset = 0,
+		.range = sizeof(camera_data),
+	};
+
+	VkWriteDescriptorSet write;
+	memset(&write, 0, sizeof(VkWriteDescriptorSet));
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = self->frame_descriptor_set;
+	write.dstBinding = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	write.pBufferInfo = &camera_info;
+
+	vkUpdateDescriptorSets(self->log_dev, 1, &write, 0, NULL);
 }
 
-void vulkan_engine_init(vulkan_engine *self, SDL_Window *window)
+static void create_mesh_pool(vulkan_engine *self)
 {
-	self->win = window;
+	vk_mesh_pool_init(&self->meshes, &self->allocator, sizeof(vertex),
+			  MESH_POOL_VERTICES, MESH_POOL_INDICES);
+	self->draw_list = NULL;
+	self->draw_count = 0;
+	self->draw_cap = 0;
+	self->instance_list = NULL;
+	self->instance_count = 0;
+	self->instance_cap = 0;
+	self->static_frames = false;
+	self->static_dirty = true;
+	self->static_generation = 0;
+	self->static_draws = NULL;
+	self->static_draw_count = 0;
+	self->static_draw_cap = 0;
+	self->static_instance_count = 0;
+	self->reused_frames = 0;
+	self->sort_draws = true;
+	self->sort_keys = NULL;
+	self->sort_order = NULL;
+	self->sort_tmp_keys = NULL;
+	self->sort_tmp_order = NULL;
+	self->sorted_draws = NULL;
+	self->sort_cap = 0;
+}
+
+static void create_pipelines(vulkan_engine *self)
+{
+	job_system_init(&self->jobs, 0);
+	self->pipeline_cache =
+		vk_pipeline_cache_load(self->phy_dev, self->log_dev, PIPELINE_CACHE_PATH);
+	vk_pipelines_init(&self->pipelines, self->log_dev, self->pipeline_cache,
+			  &self->jobs, &self->assets, &self->deletions);
+	self->shader_reload = enable_shader_reload &&
+			      shader_watch_init(&self->shader_watch, "assets/shaders",
+						shader_sources, shader_sources_size,
+						&self->jobs);
+}
+
+static void create_cull(vulkan_engine *self)
+{
+	vk_cull_init(&self->cull, &self->allocator, self->log_dev,
+		     self->pipeline_cache, &self->assets, sizeof(instance_data),
+		     self->draw_indirect_count);
+}
+
+static void create_profiling(vulkan_engine *self)
+{
+	queue_family_indices queue_family_indices;
+	queue_family_indices_init(self->phy_dev, self->sdl_surface,
+				  &queue_family_indices);
+
+	vk_profiler_init(&self->profiler, self->phy_dev, self->log_dev,
+			 queue_family_indices.graphics_family, MAX_FRAMES_IN_FLIGHT);
+	frame_stats_init(&self->stats);
+	self->last_frame_start_us = 0.0;
+}
+
+static void create_capture(vulkan_engine *self)
+{
+	queue_family_indices queue_family_indices;
+	queue_family_indices_init(self->phy_dev, self->sdl_surface,
+				  &queue_family_indices);
+
+	vk_capture_init(&self->capture, &self->allocator, self->log_dev,
+			queue_family_indices.graphics_family, MAX_FRAMES_IN_FLIGHT);
+}
+
+static void init_engine(vulkan_engine *self)
+{
+	// optional: without a pack every asset is read from its file
+	asset_pack_open(&self->assets, ASSET_PACK_PATH);
 	create_instance(self);
 	setup_debug_messenger(self);
-	create_surface(self);
+	if (self->headless) {
+		self->sdl_surface = VK_NULL_HANDLE;
+	} else {
+		create_surface(self);
+	}
 	pick_phy_device(self);
 	create_logical_device(self);
+	vk_deletion_queue_init(&self->deletions, self->log_dev);
+	vk_mem_allocator_init(&self->allocator, self->phy_dev, self->log_dev);
 	create_swap_chain(self);
 	create_image_views(self);
-	create_render_pass(self);
+	create_render_graph(self);
+	create_descriptor_set_layout(self);
+	create_pipelines(self);
 	create_graphics_pipeline(self);
-	create_frame_buffers(self);
 	create_command_pool(self);
-	create_vertex_buffer(self);
+	create_record_pools(self);
+	create_upload_ring(self);
+	create_frame_ring(self);
+	create_descriptor_sets(self);
+	create_mesh_pool(self);
+	create_cull(self);
 	create_command_buffers(self);
+	create_static_recordings(self);
 	create_sync_objects(self);
+	create_profiling(self);
+	create_capture(self);
+}
+
+void vulkan_engine_init(vulkan_engine *self, SDL_Window *window)
+{
+	self->win = window;
+	self->headless = false;
+	init_engine(self);
+}
+
+void vulkan_engine_init_headless(vulkan_engine *self, Uint32 width, Uint32 height)
+{
+	self->win = NULL;
+	self->headless = true;
+	self->swap_chain = VK_NULL_HANDLE;
+	self->win_extent.width = width;
+	self->win_extent.height = height;
+	init_engine(self);
 }
 
 void cleanup_swap_chain(vulkan_engine *self)
 {
-	for (size_t i = 0; i < self->swap_chain_images_size; i++) {
-		vkDestroyFramebuffer(self->log_dev, self->swap_chain_frame_buffers[i],
-				     NULL);
-	}
-	free(self->swap_chain_frame_buffers);
 	for (Uint32 i = 0; i < self->swap_chain_images_size; i++) {
 		vkDestroyImageView(self->log_dev, self->swap_chain_image_views[i],
 				   NULL);
 	}
 	free(self->swap_chain_image_views);
+	if (self->headless) {
+		for (Uint32 i = 0; i < self->swap_chain_images_size; i++) {
+			vk_mem_destroy_image(&self->allocator, self->swap_chain_images[i],
+					     &self->headless_allocs[i]);
+		}
+		free(self->headless_allocs);
+	} else {
+		vkDestroySwapchainKHR(self->log_dev, self->swap_chain, NULL);
+	}
 	free(self->swap_chain_images);
-	vkDestroySwapchainKHR(self->log_dev, self->swap_chain, NULL);
 }
 
-void vulkan_engine_recreate_swap_chain(vulkan_engine *self)
+// Queue everything that belongs to the current swapchain for destruction
+// after the frame being recorded, which is the last one that may use it. The
+// swapchain handle stays set so it can be passed as oldSwapchain.
+static void retire_swap_chain(vulkan_engine *self)
 {
-	vkDeviceWaitIdle(self->log_dev);
+	for (Uint32 i = 0; i < self->swap_chain_images_size; i++) {
+		vulkan_engine_defer_deletion(
+			self, &(vk_deletion){ .type = VK_DELETE_IMAGE_VIEW,
+					      .image_view = self->swap_chain_image_views[i] });
+	}
+	free(self->swap_chain_image_views);
+	if (self->headless) {
+		for (Uint32 i = 0; i < self->swap_chain_images_size; i++) {
+			vulkan_engine_defer_deletion(
+				self, &(vk_deletion){ .type = VK_DELETE_IMAGE,
+						      .image = { &self->allocator,
+								 self->swap_chain_images[i],
+								 self->headless_allocs[i] } });
+		}
+		free(self->headless_allocs);
+	}
+	free(self->swap_chain_images);
 
-	cleanup_swap_chain(self);
+	Uint32 count = MAX_FRAMES_IN_FLIGHT * self->swap_chain_images_size;
+	for (Uint32 i = 0; i < count; i++) {
+		vulkan_engine_defer_deletion(
+			self, &(vk_deletion){ .type = VK_DELETE_COMMAND_BUFFER,
+					      .command_buffer = {
+						      self->command_pool,
+						      self->static_recordings[i].cmd } });
+	}
+	free(self->static_recordings);
+	self->static_recordings = NULL;
+}
 
-	create_swap_chain(self);
+void vulkan_engine_recreate_swap_chain(vulkan_engine *self)
+{
+	// the current swapchain stays until its replacement exists
+	VkExtent2D extent;
+	VkFormat format;
+	VkSwapchainKHR swap_chain = VK_NULL_HANDLE;
+	if (!self->headless) {
+		swap_chain = new_swap_chain(self, &extent, &format);
+		if (swap_chain == VK_NULL_HANDLE) {
+			// try again after the next frame
+			self->fb_resized_flag = true;
+			return;
+		}
+	}
+
+	retire_swap_chain(self);
+	if (self->headless) {
+		create_headless_targets(self);
+	} else {
+		use_swap_chain(self, swap_chain, extent, format);
+	}
 	create_image_views(self);
-	create_frame_buffers(self);
+	// the graph's framebuffers and depth buffer are retired after this frame too
+	vk_render_graph_bind_images(&self->graph, self->swap_chain_target,
+				    self->swap_chain_images, self->swap_chain_image_views,
+				    self->swap_chain_images_size);
+	vk_render_graph_resize(&self->graph, self->swap_chain_extent, &self->deletions,
+			       self->frame_num);
+	create_static_recordings(self);
 }
 
 void vulkan_engine_cleanup(vulkan_engine *self)
 {
 	if (self->initialized) {
 		vkDeviceWaitIdle(self->log_dev);
+		vk_deletion_queue_destroy(&self->deletions);
+		destroy_static_recordings(self);
+		vk_render_graph_destroy(&self->graph);
 		cleanup_swap_chain(self);
-		vkDestroyBuffer(self->log_dev, self->vertex_buffer, NULL);
-		for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		vk_mesh_pool_destroy(&self->meshes);
+		free(self->draw_list);
+		free(self->instance_list);
+		free(self->static_draws);
+		free(self->sort_keys);
+		free(self->sort_order);
+		free(self->sort_tmp_keys);
+		free(self->sort_tmp_order);
+		free(self->sorted_draws);
+		vk_cull_destroy(&self->cull);
+		vk_profiler_destroy(&self->profiler);
+		// the device is idle, so every copy can go to the encoder
+		vk_capture_poll(&self->capture, UINT64_MAX);
+		vk_capture_destroy(&self->capture);
+		frame_stats_destroy(&self->stats);
+		vk_upload_ring_destroy(&self->upload);
+		vk_frame_ring_destroy(&self->frame_ring);
+		vkDestroyDescriptorPool(self->log_dev, self->descriptor_pool, NULL);
+		vkDestroyDescriptorSetLayout(self->log_dev, self->descriptor_set_layout,
+					     NULL);
+		for (Uint32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
 			vkDestroySemaphore(self->log_dev, self->image_avail_sems[i],
 					   NULL);
 			vkDestroySemaphore(self->log_dev, self->rend_finished_sems[i],
 					   NULL);
-			vkDestroyFence(self->log_dev, self->in_flight_fences[i], NULL);
 		}
 		free(self->image_avail_sems);
 		free(self->rend_finished_sems);
-		free(self->in_flight_fences);
+		vkDestroySemaphore(self->log_dev, self->frame_timeline, NULL);
 		vkDestroyCommandPool(self->log_dev, self->command_pool, NULL);
 		free(self->command_buffers);
-		vkDestroyRenderPass(self->log_dev, self->render_pass, NULL);
-		vkDestroyPipeline(self->log_dev, self->graphics_pipeline, NULL);
+		destroy_record_pools(self);
+		vk_pipelines_destroy(&self->pipelines);
+		if (self->shader_reload) {
+			shader_watch_destroy(&self->shader_watch);
+		}
+		job_system_destroy(&self->jobs);
 		vkDestroyPipelineLayout(self->log_dev, self->pipeline_layout, NULL);
+		vk_pipeline_cache_save(self->log_dev, self->pipeline_cache,
+				       PIPELINE_CACHE_PATH);
+		vkDestroyPipelineCache(self->log_dev, self->pipeline_cache, NULL);
+		vk_mem_allocator_destroy(&self->allocator);
 		vkDestroyDevice(self->log_dev, NULL);
 		if (enable_validation_layers) {
 			DestroyDebugUtilsMessengerEXT(self->vk_instance,
 						      self->debug_messenger, NULL);
 		}
-		vkDestroySurfaceKHR(self->vk_instance, self->sdl_surface, NULL);
+		if (!self->headless) {
+			vkDestroySurfaceKHR(self->vk_instance, self->sdl_surface, NULL);
+		}
 		vkDestroyInstance(self->vk_instance, NULL);
+		asset_pack_close(&self->assets);
+	}
+}
+
+void vulkan_engine_set_frames_in_flight(vulkan_engine *self, Uint32 count)
+{
+	if (count < 1) {
+		count = 1;
+	} else if (count > MAX_FRAMES_IN_FLIGHT) {
+		count = MAX_FRAMES_IN_FLIGHT;
+	}
+	if (count == self->frames_in_flight) {
+		return;
+	}
+
+	// slots are reassigned, so nothing may still be using the old ones
+	if (self->frame_num > 0) {
+		wait_for_frame(self, self->frame_num - 1);
+	}
+	self->frames_in_flight = count;
+	self->current_frame = 0;
+	self->static_dirty = true;
+}
+
+void vulkan_engine_set_static_frames(vulkan_engine *self, bool enable)
+{
+	self->static_frames = enable;
+	self->static_dirty = true;
+}
+
+void vulkan_engine_set_draw_sorting(vulkan_engine *self, bool enable)
+{
+	self->sort_draws = enable;
+}
+
+Uint64 vulkan_engine_reused_frames(vulkan_engine *self)
+{
+	return self->reused_frames;
+}
+
+void vulkan_engine_defer_deletion(vulkan_engine *self, vk_deletion *deletion)
+{
+	deletion->frame = self->frame_num;
+	vk_deletion_queue_push(&self->deletions, deletion);
+}
+
+Uint64 vulkan_engine_frames_completed(vulkan_engine *self)
+{
+	Uint64 value = 0;
+	VkResult result =
+		vkGetSemaphoreCounterValue(self->log_dev, self->frame_timeline, &value);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error reading frame timeline, err: %s\n",
+			string_VkResult(result));
+	}
+	return value;
+}
+
+void vulkan_engine_get_mem_stats(vulkan_engine *self, vk_mem_stats *rstats)
+{
+	vk_mem_get_stats(&self->allocator, rstats);
+}
+
+void vulkan_engine_set_camera(vulkan_engine *self, mat4 view_proj)
+{
+	glm_mat4_copy(view_proj, self->camera.view_proj);
+}
+
+void *vulkan_engine_frame_alloc(vulkan_engine *self, VkDeviceSize size,
+				VkDeviceSize alignment, VkDeviceSize *roffset)
+{
+	return vk_frame_ring_alloc(&self->frame_ring, size, alignment, roffset);
+}
+
+void *vulkan_engine_frame_alloc_storage(vulkan_engine *self, VkDeviceSize size,
+					VkDeviceSize *roffset)
+{
+	return vk_frame_ring_alloc_storage(&self->frame_ring, size, roffset);
+}
+
+void vulkan_engine_get_frame_ring_stats(vulkan_engine *self, vk_frame_ring_stats *rstats)
+{
+	vk_frame_ring_get_stats(&self->frame_ring, rstats);
+}
+
+Uint32 vulkan_engine_add_mesh(vulkan_engine *self, const vertex *vertices,
+			      Uint32 vertex_count, const Uint32 *indices,
+			      Uint32 index_count)
+{
+	Uint32 id = vk_mesh_pool_add(&self->meshes, &self->upload, vertices,
+				     vertex_count, indices, index_count);
+	if (id != VK_MESH_INVALID) {
+		vk_cull_set_mesh(&self->cull, &self->upload, id,
+				 vk_mesh_pool_get(&self->meshes, id));
 	}
+	// ids are reused, so a recorded draw may now mean a different mesh
+	self->static_dirty = true;
+	return id;
+}
+
+static void release_mesh(void *owner, Uint64 mesh)
+{
+	vk_mesh_pool_release(owner, (Uint32)mesh);
+}
+
+void vulkan_engine_remove_mesh(vulkan_engine *self, Uint32 mesh)
+{
+	vk_mesh_pool_remove(&self->meshes, mesh);
+	// culled objects stop drawing it from the next frame on, before its id
+	// and ranges can be handed out again
+	vk_cull_remove_mesh(&self->cull, &self->upload, mesh);
+	// queued frames may still draw from its ranges
+	vulkan_engine_defer_deletion(
+		self, &(vk_deletion){ .type = VK_DELETE_CALLBACK,
+				      .callback = { release_mesh, &self->meshes, mesh } });
+	self->static_dirty = true;
+}
+
+void vulkan_engine_draw_mesh(vulkan_engine *self, Uint32 mesh)
+{
+	instance_data instance;
+	glm_mat4_identity(instance.model);
+	glm_vec4_one(instance.color);
+	vulkan_engine_draw_mesh_instanced(self, mesh, &instance, 1);
+}
+
+void vulkan_engine_draw_mesh_instanced(vulkan_engine *self, Uint32 mesh,
+				       const instance_data *instances,
+				       Uint32 instance_count)
+{
+	if (instance_count == 0) {
+		return;
+	}
+
+	if (self->draw_count == self->draw_cap) {
+		self->draw_cap = self->draw_cap ? self->draw_cap * 2 : 256;
+		self->draw_list = realloc(self->draw_list, sizeof(draw_cmd) * self->draw_cap);
+	}
+	if (self->instance_count + instance_count > self->instance_cap) {
+		Uint32 cap = self->instance_cap ? self->instance_cap : 256;
+		while (cap < self->instance_count + instance_count) {
+			cap *= 2;
+		}
+		self->instance_cap = cap;
+		self->instance_list =
+			realloc(self->instance_list, sizeof(instance_data) * cap);
+	}
+
+	draw_cmd *draw = &self->draw_list[self->draw_count++];
+	draw->mesh = mesh;
+	draw->translucent = self->draw_translucent;
+	draw->pipeline = self->draw_pipeline;
+	draw->first_instance = self->instance_count;
+	draw->instance_count = instance_count;
+
+	memcpy(&self->instance_list[self->instance_count], instances,
+	       sizeof(instance_data) * instance_count);
+	self->instance_count += instance_count;
+}
+
+Uint32 vulkan_engine_add_object(vulkan_engine *self, Uint32 mesh,
+				const instance_data *instance, float radius)
+{
+	gpu_object object;
+	memset(&object, 0, sizeof(gpu_object));
+	// the bounding sphere follows the model's translation
+	object.sphere[0] = instance->model[3][0];
+	object.sphere[1] = instance->model[3][1];
+	object.sphere[2] = instance->model[3][2];
+	object.sphere[3] = radius;
+	object.mesh = mesh;
+	if (vk_mesh_pool_get(&self->meshes, mesh) == NULL) {
+		fprintf(stderr, "Object added with mesh %u, which isn't live\n", mesh);
+		object.mesh = VK_CULL_NULL_MESH;
+	}
+	// the object count is recorded into the indirect draw
+	self->static_dirty = true;
+	return vk_cull_add_object(&self->cull, &self->upload, &object, instance);
+}
+
+void vulkan_engine_clear_objects(vulkan_engine *self)
+{
+	vk_cull_clear_objects(&self->cull);
+	self->static_dirty = true;
+}
+
+void vulkan_engine_default_pipeline_desc(vulkan_engine *self, vk_pipeline_desc *rdesc)
+{
+	memcpy(rdesc, &self->default_pipeline_desc, sizeof(vk_pipeline_desc));
+}
+
+void vulkan_engine_use_pipeline(vulkan_engine *self, const vk_pipeline_desc *desc)
+{
+	if (desc == NULL) {
+		self->draw_pipeline = self->graphics_pipeline;
+		self->draw_translucent = desc_translucent(&self->default_pipeline_desc);
+		return;
+	}
+	self->draw_pipeline =
+		vk_pipelines_get(&self->pipelines, desc, self->graphics_pipeline);
+	// classified by what is bound: variants still compiling draw with the
+	// default pipeline
+	bool fallback = self->draw_pipeline == self->graphics_pipeline;
+	self->draw_translucent =
+		desc_translucent(fallback ? &self->default_pipeline_desc : desc);
+}
+
+void vulkan_engine_get_pipeline_stats(vulkan_engine *self, vk_pipeline_stats *rstats)
+{
+	vk_pipelines_get_stats(&self->pipelines, rstats);
+}
+
+Uint32 vulkan_engine_get_gpu_timings(vulkan_engine *self,
+				     const vk_profiler_result **rresults)
+{
+	*rresults = self->profiler.results;
+	return self->profiler.result_count;
+}
+
+void vulkan_engine_start_trace(vulkan_engine *self)
+{
+	vk_profiler_start_capture(&self->profiler);
+}
+
+bool vulkan_engine_write_trace(vulkan_engine *self, const char *path)
+{
+	vk_profiler_stop_capture(&self->profiler);
+	return vk_profiler_write_trace(&self->profiler, path);
+}
+
+void vulkan_engine_get_frame_stats(vulkan_engine *self, frame_stat stat,
+				   frame_stat_summary *rsummary)
+{
+	frame_stats_summary(&self->stats, stat, rsummary);
+}
+
+bool vulkan_engine_dump_frame_stats(vulkan_engine *self, const char *path,
+				    double interval_ms)
+{
+	return frame_stats_dump_to(&self->stats, path, interval_ms);
+}
+
+bool vulkan_engine_capture(vulkan_engine *self, const char *path)
+{
+	if (!self->capture_supported) {
+		fprintf(stderr, "Error: the swapchain images can't be captured\n");
+		return false;
+	}
+	vk_capture_request(&self->capture, path);
+	return true;
+}
+
+bool vulkan_engine_capture_sequence(vulkan_engine *self, const char *pattern)
+{
+	if (pattern != NULL && !self->capture_supported) {
+		fprintf(stderr, "Error: the swapchain images can't be captured\n");
+		return false;
+	}
+	return vk_capture_sequence(&self->capture, pattern);
+}
+
+void vulkan_engine_set_capture_callback(vulkan_engine *self, vk_capture_fn fn,
+					void *user)
+{
+	vk_capture_set_callback(&self->capture, fn, user);
+}
+
+Uint32 vulkan_engine_captures_pending(vulkan_engine *self)
+{
+	return vk_capture_pending(&self->capture);
+}
+
+void vulkan_engine_get_capture_stats(vulkan_engine *self, vk_capture_stats *rstats)
+{
+	vk_capture_get_stats(&self->capture, rstats);
 }
@@ -0,0 +1,98 @@
+#include "vk/vk_frame_ring.h"
+#include <vulkan/vk_enum_string_helper.h>
+#include <stdio.h>
+#include <string.h>
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+void vk_frame_ring_init(vk_frame_ring *self, vk_mem_allocator *allocator,
+			VkPhysicalDevice phy_dev, Uint32 slice_count)
+{
+	memset(self, 0, sizeof(vk_frame_ring));
+	self->allocator = allocator;
+	self->slice_count = slice_count;
+
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(phy_dev, &props);
+	self->uniform_alignment = props.limits.minUniformBufferOffsetAlignment;
+	self->storage_alignment = props.limits.minStorageBufferOffsetAlignment;
+	if (self->uniform_alignment < 16) {
+		self->uniform_alignment = 16;
+	}
+	if (self->storage_alignment < 16) {
+		self->storage_alignment = 16;
+	}
+	// slices start on an alignment every binding accepts
+	self->slice_size = align_up(VK_FRAME_RING_SLICE_SIZE, 256);
+
+	VkBufferCreateInfo buf_info;
+	memset(&buf_info, 0, sizeof(VkBufferCreateInfo));
+	buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buf_info.size = self->slice_size * slice_count;
+	buf_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+			 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+			 VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+	buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	// device local + host visible (BAR) when the device has it, plain
+	// host memory otherwise
+	VkResult result = vk_mem_create_buffer(
+		allocator, &buf_info,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &self->buffer, &self->alloc);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error creating frame ring buffer, err: %s\n",
+			string_VkResult(result));
+	}
+}
+
+void vk_frame_ring_destroy(vk_frame_ring *self)
+{
+	vk_mem_destroy_buffer(self->allocator, self->buffer, &self->alloc);
+}
+
+void vk_frame_ring_begin(vk_frame_ring *self, Uint32 slice)
+{
+	self->slice = slice;
+	self->cursor = 0;
+}
+
+void *vk_frame_ring_alloc(vk_frame_ring *self, VkDeviceSize size,
+			  VkDeviceSize alignment, VkDeviceSize *roffset)
+{
+	if (alignment == 0) {
+		alignment = self->uniform_alignment;
+	}
+
+	VkDeviceSize cursor = align_up(self->cursor, alignment);
+	if (cursor + size > self->slice_size) {
+		fprintf(stderr, "Frame ring slice exhausted (%llu of %llu bytes)\n",
+			(unsigned long long)(cursor + size),
+			(unsigned long long)self->slice_size);
+		return NULL;
+	}
+	self->cursor = cursor + size;
+	if (self->cursor > self->high_water) {
+		self->high_water = self->cursor;
+	}
+
+	VkDeviceSize offset = self->slice * self->slice_size + cursor;
+	*roffset = offset;
+	return (char *)self->alloc.mapped + offset;
+}
+
+void *vk_frame_ring_alloc_storage(vk_frame_ring *self, VkDeviceSize size,
+				  VkDeviceSize *roffset)
+{
+	return vk_frame_ring_alloc(self, size, self->storage_alignment, roffset);
+}
+
+void vk_frame_ring_get_stats(vk_frame_ring *self, vk_frame_ring_stats *rstats)
+{
+	rstats->slice_size = self->slice_size;
+	rstats->used = self->cursor;
+	rstats->high_water = self->high_water;
+}
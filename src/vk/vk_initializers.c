@@ -1,2 +1,23 @@
 #include "vk/vk_initializers.h"
+#include <vulkan/vk_enum_string_helper.h>
+#include <stdio.h>
+#include <string.h>
 
+VkShaderModule create_shader_module(VkDevice log_dev, loaded_file *lf)
+{
+	VkShaderModuleCreateInfo smci;
+	memset(&smci, 0, sizeof(VkShaderModuleCreateInfo));
+
+	smci.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	smci.codeSize = lf->size;
+	smci.pCode = (Uint32 *)lf->buf;
+
+	VkShaderModule module;
+	VkResult result = vkCreateShaderModule(log_dev, &smci, NULL, &module);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error creating shader module. err: %s\n",
+			string_VkResult(result));
+	}
+
+	return module;
+}
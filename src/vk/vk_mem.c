@@ -0,0 +1,548 @@
+#include "vk/vk_mem.h"
+#include <vulkan/vk_enum_string_helper.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static Uint32 order_for_size(VkDeviceSize size)
+{
+	Uint32 order = VK_MEM_MIN_ORDER;
+	while (((VkDeviceSize)1 << order) < size) {
+		order++;
+	}
+	return order;
+}
+
+static Uint32 block_root_order(vk_mem_block *block)
+{
+	return VK_MEM_MIN_ORDER + block->levels - 1;
+}
+
+static void block_update_parents(vk_mem_block *block, Uint32 node, Uint32 order)
+{
+	while (node > 0) {
+		node = (node - 1) / 2;
+		order++;
+		Uint8 left = block->longest[node * 2 + 1];
+		Uint8 right = block->longest[node * 2 + 2];
+		// two fully free buddies merge back into their parent
+		if (left == order && right == order) {
+			block->longest[node] = order + 1;
+		} else {
+			block->longest[node] = left > right ? left : right;
+		}
+	}
+}
+
+static bool block_alloc(vk_mem_block *block, Uint32 order, VkDeviceSize *roffset)
+{
+	Uint32 root_order = block_root_order(block);
+	if (order > root_order || block->longest[0] < order + 1) {
+		return false;
+	}
+
+	Uint32 node = 0;
+	for (Uint32 node_order = root_order; node_order != order; node_order--) {
+		Uint32 left = node * 2 + 1;
+		Uint32 right = left + 1;
+		bool left_fits = block->longest[left] >= order + 1;
+		bool right_fits = block->longest[right] >= order + 1;
+		// take the tighter fit so large free runs stay intact
+		if (left_fits && (!right_fits || block->longest[left] <= block->longest[right])) {
+			node = left;
+		} else {
+			node = right;
+		}
+	}
+
+	block->longest[node] = 0;
+	block_update_parents(block, node, order);
+
+	Uint32 depth = root_order - order;
+	*roffset = (VkDeviceSize)(node - ((1u << depth) - 1)) << order;
+	return true;
+}
+
+static void block_free(vk_mem_block *block, VkDeviceSize offset, Uint32 order)
+{
+	Uint32 depth = block_root_order(block) - order;
+	Uint32 node = (Uint32)(offset >> order) + (1u << depth) - 1;
+
+	block->longest[node] = order + 1;
+	block_update_parents(block, node, order);
+}
+
+static void free_device_memory(vk_mem_allocator *self, VkDeviceMemory memory)
+{
+	vkFreeMemory(self->log_dev, memory, NULL);
+	self->device_allocations--;
+}
+
+static VkResult allocate_device_memory(vk_mem_allocator *self, Uint32 type_idx,
+				       VkDeviceSize size, const void *next,
+				       VkDeviceMemory *rmemory, void **rmapped)
+{
+	if (self->device_allocations >= self->max_device_allocations) {
+		fprintf(stderr, "Device memory allocation count %u exceeds limit %u\n",
+			self->device_allocations + 1, self->max_device_allocations);
+	}
+
+	VkMemoryAllocateInfo alloc_info = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.pNext = next,
+		.allocationSize = size,
+		.memoryTypeIndex = type_idx,
+	};
+
+	VkResult result = vkAllocateMemory(self->log_dev, &alloc_info, NULL, rmemory);
+	if (result != VK_SUCCESS) {
+		return result;
+	}
+	self->device_allocations++;
+
+	*rmapped = NULL;
+	if (self->mem_props.memoryTypes[type_idx].propertyFlags &
+	    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		result = vkMapMemory(self->log_dev, *rmemory, 0, VK_WHOLE_SIZE, 0,
+				     rmapped);
+		if (result != VK_SUCCESS) {
+			// callers write through the mapping unchecked
+			fprintf(stderr, "Error mapping device memory, err: %s\n",
+				string_VkResult(result));
+			free_device_memory(self, *rmemory);
+			*rmemory = VK_NULL_HANDLE;
+			*rmapped = NULL;
+			return result;
+		}
+	}
+
+	return VK_SUCCESS;
+}
+
+static vk_mem_block *block_create(vk_mem_allocator *self, Uint32 type_idx)
+{
+	VkDeviceSize size = self->block_size[type_idx];
+
+	vk_mem_block *block = malloc(sizeof(vk_mem_block));
+	memset(block, 0, sizeof(vk_mem_block));
+	block->size = size;
+	block->levels = order_for_size(size) - VK_MEM_MIN_ORDER + 1;
+
+	VkResult result = allocate_device_memory(self, type_idx, size, NULL,
+						 &block->memory, &block->mapped);
+	if (result != VK_SUCCESS) {
+		free(block);
+		return NULL;
+	}
+
+	Uint32 root_order = block_root_order(block);
+	block->longest = malloc((1u << block->levels) - 1);
+	for (Uint32 depth = 0; depth < block->levels; depth++) {
+		Uint32 first = (1u << depth) - 1;
+		memset(&block->longest[first], root_order - depth + 1, 1u << depth);
+	}
+
+	return block;
+}
+
+static void block_destroy(vk_mem_allocator *self, vk_mem_block *block)
+{
+	free_device_memory(self, block->memory);
+	free(block->longest);
+	free(block);
+}
+
+static vk_mem_block *pool_add_block(vk_mem_allocator *self, vk_mem_pool *pool,
+				    Uint32 type_idx)
+{
+	vk_mem_block *block = block_create(self, type_idx);
+	if (block == NULL) {
+		return NULL;
+	}
+
+	for (Uint32 i = 0; i < pool->block_count; i++) {
+		if (pool->blocks[i] == NULL) {
+			pool->blocks[i] = block;
+			return block;
+		}
+	}
+
+	if (pool->block_count == pool->block_cap) {
+		pool->block_cap = pool->block_cap ? pool->block_cap * 2 : 4;
+		pool->blocks =
+			realloc(pool->blocks, sizeof(vk_mem_block *) * pool->block_cap);
+	}
+	pool->blocks[pool->block_count++] = block;
+
+	return block;
+}
+
+void vk_mem_allocator_init(vk_mem_allocator *self, VkPhysicalDevice phy_dev,
+			   VkDevice log_dev)
+{
+	memset(self, 0, sizeof(vk_mem_allocator));
+	self->log_dev = log_dev;
+	vkGetPhysicalDeviceMemoryProperties(phy_dev, &self->mem_props);
+
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(phy_dev, &props);
+	self->max_device_allocations = props.limits.maxMemoryAllocationCount;
+
+	// small heaps (e.g. a 256MB BAR window) get proportionally smaller blocks
+	for (Uint32 i = 0; i < self->mem_props.memoryTypeCount; i++) {
+		Uint32 heap = self->mem_props.memoryTypes[i].heapIndex;
+		VkDeviceSize heap_size = self->mem_props.memoryHeaps[heap].size;
+		VkDeviceSize block_size = VK_MEM_BLOCK_SIZE;
+		while (block_size > heap_size / 8 && block_size > 1024 * 1024) {
+			block_size /= 2;
+		}
+		self->block_size[i] = block_size;
+	}
+}
+
+void vk_mem_allocator_destroy(vk_mem_allocator *self)
+{
+	for (Uint32 i = 0; i < VK_MAX_MEMORY_TYPES; i++) {
+		for (Uint32 k = 0; k < VK_MEM_KIND_COUNT; k++) {
+			vk_mem_pool *pool = &self->pools[i][k];
+			for (Uint32 b = 0; b < pool->block_count; b++) {
+				vk_mem_block *block = pool->blocks[b];
+				if (block == NULL) {
+					continue;
+				}
+				if (block->alloc_count != 0) {
+					fprintf(stderr,
+						"Leaked %u allocations in memory type %u\n",
+						block->alloc_count, i);
+				}
+				block_destroy(self, block);
+			}
+			free(pool->blocks);
+		}
+	}
+	memset(self->pools, 0, sizeof(self->pools));
+}
+
+Uint32 vk_mem_find_type(vk_mem_allocator *self, Uint32 type_filter,
+			VkMemoryPropertyFlags props)
+{
+	for (Uint32 i = 0; i < self->mem_props.memoryTypeCount; i++) {
+		if ((type_filter & (1 << i)) &&
+		    (self->mem_props.memoryTypes[i].propertyFlags & props) == props) {
+			return i;
+		}
+	}
+
+	return UINT32_MAX;
+}
+
+static VkResult alloc_dedicated(vk_mem_allocator *self, Uint32 type_idx,
+				VkDeviceSize size, const VkMemoryDedicatedAllocateInfo *ded,
+				vk_mem_allocation *ralloc)
+{
+	VkResult result = allocate_device_memory(self, type_idx, size, ded,
+						 &ralloc->memory, &ralloc->mapped);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error allocating dedicated memory, err: %s\n",
+			string_VkResult(result));
+		return result;
+	}
+
+	Uint32 heap = self->mem_props.memoryTypes[type_idx].heapIndex;
+	self->dedicated_count[heap]++;
+	self->dedicated_bytes[heap] += size;
+
+	ralloc->offset = 0;
+	ralloc->size = size;
+	ralloc->block = NULL;
+	return VK_SUCCESS;
+}
+
+static VkResult mem_alloc(vk_mem_allocator *self, const VkMemoryRequirements *reqs,
+			  VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred,
+			  vk_mem_kind kind, const VkMemoryDedicatedAllocateInfo *ded,
+			  bool dedicated, vk_mem_allocation *ralloc)
+{
+	memset(ralloc, 0, sizeof(vk_mem_allocation));
+
+	Uint32 type_idx =
+		vk_mem_find_type(self, reqs->memoryTypeBits, required | preferred);
+	if (type_idx == UINT32_MAX) {
+		type_idx = vk_mem_find_type(self, reqs->memoryTypeBits, required);
+	}
+	if (type_idx == UINT32_MAX) {
+		fprintf(stderr, "No memory type matches filter %u with flags %u\n",
+			reqs->memoryTypeBits, required);
+		return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+	}
+	ralloc->type_idx = type_idx;
+	ralloc->kind = kind;
+
+	VkDeviceSize size = reqs->size > reqs->alignment ? reqs->size : reqs->alignment;
+	if (dedicated || size > self->block_size[type_idx] / 2) {
+		return alloc_dedicated(self, type_idx, size, ded, ralloc);
+	}
+
+	Uint32 order = order_for_size(size);
+	vk_mem_pool *pool = &self->pools[type_idx][kind];
+	vk_mem_block *block = NULL;
+	VkDeviceSize offset = 0;
+
+	for (Uint32 i = 0; i < pool->block_count; i++) {
+		if (pool->blocks[i] != NULL && block_alloc(pool->blocks[i], order, &offset)) {
+			block = pool->blocks[i];
+			break;
+		}
+	}
+
+	if (block == NULL) {
+		block = pool_add_block(self, pool, type_idx);
+		if (block == NULL || !block_alloc(block, order, &offset)) {
+			// the heap may still fit an exact-size allocation
+			return alloc_dedicated(self, type_idx, size, NULL, ralloc);
+		}
+	}
+
+	block->used += (VkDeviceSize)1 << order;
+	block->alloc_count++;
+
+	ralloc->memory = block->memory;
+	ralloc->offset = offset;
+	ralloc->size = (VkDeviceSize)1 << order;
+	ralloc->mapped = block->mapped ? (char *)block->mapped + offset : NULL;
+	ralloc->block = block;
+	ralloc->order = order;
+
+	return VK_SUCCESS;
+}
+
+VkResult vk_mem_alloc(vk_mem_allocator *self, const VkMemoryRequirements *reqs,
+		      VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred,
+		      vk_mem_kind kind, bool dedicated, vk_mem_allocation *ralloc)
+{
+	return mem_alloc(self, reqs, required, preferred, kind, NULL, dedicated, ralloc);
+}
+
+void vk_mem_free(vk_mem_allocator *self, vk_mem_allocation *alloc)
+{
+	if (alloc->memory == VK_NULL_HANDLE) {
+		return;
+	}
+
+	if (alloc->block == NULL) {
+		Uint32 heap = self->mem_props.memoryTypes[alloc->type_idx].heapIndex;
+		self->dedicated_count[heap]--;
+		self->dedicated_bytes[heap] -= alloc->size;
+		free_device_memory(self, alloc->memory);
+		memset(alloc, 0, sizeof(vk_mem_allocation));
+		return;
+	}
+
+	vk_mem_block *block = alloc->block;
+	block_free(block, alloc->offset, alloc->order);
+	block->used -= alloc->size;
+	block->alloc_count--;
+
+	// release empty blocks, but keep one around per pool to avoid churn
+	if (block->alloc_count == 0) {
+		vk_mem_pool *pool = &self->pools[alloc->type_idx][alloc->kind];
+		Uint32 live = 0;
+		Uint32 slot = 0;
+		for (Uint32 i = 0; i < pool->block_count; i++) {
+			if (pool->blocks[i] != NULL) {
+				live++;
+			}
+			if (pool->blocks[i] == block) {
+				slot = i;
+			}
+		}
+		if (live > 1) {
+			block_destroy(self, block);
+			pool->blocks[slot] = NULL;
+		}
+	}
+
+	memset(alloc, 0, sizeof(vk_mem_allocation));
+}
+
+VkResult vk_mem_create_buffer(vk_mem_allocator *self, const VkBufferCreateInfo *info,
+			      VkMemoryPropertyFlags required,
+			      VkMemoryPropertyFlags preferred, VkBuffer *rbuffer,
+			      vk_mem_allocation *ralloc)
+{
+	VkResult result = vkCreateBuffer(self->log_dev, info, NULL, rbuffer);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error creating buffer, err: %s\n",
+			string_VkResult(result));
+		return result;
+	}
+
+	VkBufferMemoryRequirementsInfo2 req_info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2,
+		.pNext = NULL,
+		.buffer = *rbuffer,
+	};
+	VkMemoryDedicatedRequirements ded_reqs = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS,
+		.pNext = NULL,
+	};
+	VkMemoryRequirements2 reqs = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+		.pNext = &ded_reqs,
+	};
+	vkGetBufferMemoryRequirements2(self->log_dev, &req_info, &reqs);
+
+	VkMemoryDedicatedAllocateInfo ded_info = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+		.pNext = NULL,
+		.image = VK_NULL_HANDLE,
+		.buffer = *rbuffer,
+	};
+	bool dedicated = ded_reqs.prefersDedicatedAllocation ||
+			 ded_reqs.requiresDedicatedAllocation;
+
+	result = mem_alloc(self, &reqs.memoryRequirements, required, preferred,
+			   VK_MEM_KIND_LINEAR, dedicated ? &ded_info : NULL, dedicated,
+			   ralloc);
+	if (result != VK_SUCCESS) {
+		vkDestroyBuffer(self->log_dev, *rbuffer, NULL);
+		*rbuffer = VK_NULL_HANDLE;
+		return result;
+	}
+
+	result = vkBindBufferMemory(self->log_dev, *rbuffer, ralloc->memory,
+				    ralloc->offset);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error binding buffer memory, err: %s\n",
+			string_VkResult(result));
+		vk_mem_destroy_buffer(self, *rbuffer, ralloc);
+		*rbuffer = VK_NULL_HANDLE;
+	}
+
+	return result;
+}
+
+void vk_mem_destroy_buffer(vk_mem_allocator *self, VkBuffer buffer,
+			   vk_mem_allocation *alloc)
+{
+	vkDestroyBuffer(self->log_dev, buffer, NULL);
+	vk_mem_free(self, alloc);
+}
+
+VkResult vk_mem_create_image(vk_mem_allocator *self, const VkImageCreateInfo *info,
+			     VkMemoryPropertyFlags required, VkImage *rimage,
+			     vk_mem_allocation *ralloc)
+{
+	VkResult result = vkCreateImage(self->log_dev, info, NULL, rimage);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error creating image, err: %s\n",
+			string_VkResult(result));
+		return result;
+	}
+
+	VkImageMemoryRequirementsInfo2 req_info = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2,
+		.pNext = NULL,
+		.image = *rimage,
+	};
+	VkMemoryDedicatedRequirements ded_reqs = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS,
+		.pNext = NULL,
+	};
+	VkMemoryRequirements2 reqs = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+		.pNext = &ded_reqs,
+	};
+	vkGetImageMemoryRequirements2(self->log_dev, &req_info, &reqs);
+
+	VkMemoryDedicatedAllocateInfo ded_info = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+		.pNext = NULL,
+		.image = *rimage,
+		.buffer = VK_NULL_HANDLE,
+	};
+	bool dedicated = ded_reqs.prefersDedicatedAllocation ||
+			 ded_reqs.requiresDedicatedAllocation;
+	vk_mem_kind kind = info->tiling == VK_IMAGE_TILING_LINEAR ? VK_MEM_KIND_LINEAR :
+								   VK_MEM_KIND_OPTIMAL;
+
+	result = mem_alloc(self, &reqs.memoryRequirements, required, 0, kind,
+			   dedicated ? &ded_info : NULL, dedicated, ralloc);
+	if (result != VK_SUCCESS) {
+		vkDestroyImage(self->log_dev, *rimage, NULL);
+		*rimage = VK_NULL_HANDLE;
+		return result;
+	}
+
+	result = vkBindImageMemory(self->log_dev, *rimage, ralloc->memory, ralloc->offset);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error binding image memory, err: %s\n",
+			string_VkResult(result));
+		vk_mem_destroy_image(self, *rimage, ralloc);
+		*rimage = VK_NULL_HANDLE;
+	}
+
+	return result;
+}
+
+void vk_mem_destroy_image(vk_mem_allocator *self, VkImage image,
+			  vk_mem_allocation *alloc)
+{
+	vkDestroyImage(self->log_dev, image, NULL);
+	vk_mem_free(self, alloc);
+}
+
+void vk_mem_get_stats(vk_mem_allocator *self, vk_mem_stats *rstats)
+{
+	memset(rstats, 0, sizeof(vk_mem_stats));
+	rstats->heap_count = self->mem_props.memoryHeapCount;
+	rstats->device_allocations = self->device_allocations;
+	rstats->max_device_allocations = self->max_device_allocations;
+
+	VkDeviceSize free_bytes[VK_MAX_MEMORY_HEAPS] = { 0 };
+	VkDeviceSize largest_runs[VK_MAX_MEMORY_HEAPS] = { 0 };
+
+	for (Uint32 i = 0; i < self->mem_props.memoryHeapCount; i++) {
+		vk_mem_heap_stats *heap = &rstats->heaps[i];
+		heap->heap_size = self->mem_props.memoryHeaps[i].size;
+		heap->dedicated_count = self->dedicated_count[i];
+		heap->allocation_count = self->dedicated_count[i];
+		heap->reserved_bytes = self->dedicated_bytes[i];
+		heap->used_bytes = self->dedicated_bytes[i];
+	}
+
+	for (Uint32 t = 0; t < self->mem_props.memoryTypeCount; t++) {
+		Uint32 heap_idx = self->mem_props.memoryTypes[t].heapIndex;
+		vk_mem_heap_stats *heap = &rstats->heaps[heap_idx];
+
+		for (Uint32 k = 0; k < VK_MEM_KIND_COUNT; k++) {
+			vk_mem_pool *pool = &self->pools[t][k];
+			for (Uint32 b = 0; b < pool->block_count; b++) {
+				vk_mem_block *block = pool->blocks[b];
+				if (block == NULL) {
+					continue;
+				}
+				VkDeviceSize largest =
+					block->longest[0] ?
+						(VkDeviceSize)1 << (block->longest[0] - 1) :
+						0;
+				heap->block_count++;
+				heap->allocation_count += block->alloc_count;
+				heap->reserved_bytes += block->size;
+				heap->used_bytes += block->used;
+				if (largest > heap->largest_free) {
+					heap->largest_free = largest;
+				}
+				free_bytes[heap_idx] += block->size - block->used;
+				largest_runs[heap_idx] += largest;
+			}
+		}
+	}
+
+	for (Uint32 i = 0; i < self->mem_props.memoryHeapCount; i++) {
+		if (free_bytes[i] != 0) {
+			rstats->heaps[i].fragmentation =
+				1.0f - (float)largest_runs[i] / (float)free_bytes[i];
+		}
+	}
+}
@@ -0,0 +1,213 @@
+#include "vk/vk_mesh.h"
+#include <vulkan/vk_enum_string_helper.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void free_list_insert_at(vk_mesh_free_list *self, Uint32 idx, vk_mesh_range range)
+{
+	if (self->count == self->cap) {
+		self->cap = self->cap ? self->cap * 2 : 16;
+		self->ranges = realloc(self->ranges, sizeof(vk_mesh_range) * self->cap);
+	}
+	memmove(&self->ranges[idx + 1], &self->ranges[idx],
+		sizeof(vk_mesh_range) * (self->count - idx));
+	self->ranges[idx] = range;
+	self->count++;
+}
+
+static void free_list_remove_at(vk_mesh_free_list *self, Uint32 idx)
+{
+	memmove(&self->ranges[idx], &self->ranges[idx + 1],
+		sizeof(vk_mesh_range) * (self->count - idx - 1));
+	self->count--;
+}
+
+static void free_list_init(vk_mesh_free_list *self, Uint32 capacity)
+{
+	memset(self, 0, sizeof(vk_mesh_free_list));
+	vk_mesh_range all = { .offset = 0, .count = capacity };
+	free_list_insert_at(self, 0, all);
+}
+
+// first fit; meshes are long lived so this stays short in practice
+static bool free_list_alloc(vk_mesh_free_list *self, Uint32 count, Uint32 *roffset)
+{
+	for (Uint32 i = 0; i < self->count; i++) {
+		vk_mesh_range *range = &self->ranges[i];
+		if (range->count < count) {
+			continue;
+		}
+		*roffset = range->offset;
+		range->offset += count;
+		range->count -= count;
+		if (range->count == 0) {
+			free_list_remove_at(self, i);
+		}
+		return true;
+	}
+
+	return false;
+}
+
+static void free_list_free(vk_mesh_free_list *self, Uint32 offset, Uint32 count)
+{
+	if (count == 0) {
+		return;
+	}
+
+	Uint32 idx = 0;
+	while (idx < self->count && self->ranges[idx].offset < offset) {
+		idx++;
+	}
+
+	bool merge_prev = idx > 0 && self->ranges[idx - 1].offset +
+						     self->ranges[idx - 1].count ==
+					     offset;
+	bool merge_next = idx < self->count && offset + count == self->ranges[idx].offset;
+
+	if (merge_prev && merge_next) {
+		self->ranges[idx - 1].count += count + self->ranges[idx].count;
+		free_list_remove_at(self, idx);
+	} else if (merge_prev) {
+		self->ranges[idx - 1].count += count;
+	} else if (merge_next) {
+		self->ranges[idx].offset = offset;
+		self->ranges[idx].count += count;
+	} else {
+		vk_mesh_range range = { .offset = offset, .count = count };
+		free_list_insert_at(self, idx, range);
+	}
+}
+
+static void create_pool_buffer(vk_mesh_pool *self, VkDeviceSize size,
+			       VkBufferUsageFlags usage, VkBuffer *rbuffer,
+			       vk_mem_allocation *ralloc)
+{
+	VkBufferCreateInfo buf_info;
+	memset(&buf_info, 0, sizeof(VkBufferCreateInfo));
+	buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buf_info.size = size;
+	buf_info.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VkResult result = vk_mem_create_buffer(self->allocator, &buf_info,
+					       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0,
+					       rbuffer, ralloc);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error creating mesh pool buffer, err: %s\n",
+			string_VkResult(result));
+	}
+}
+
+void vk_mesh_pool_init(vk_mesh_pool *self, vk_mem_allocator *allocator,
+		       Uint32 vertex_stride, Uint32 vertex_capacity,
+		       Uint32 index_capacity)
+{
+	memset(self, 0, sizeof(vk_mesh_pool));
+	self->allocator = allocator;
+	self->vertex_stride = vertex_stride;
+
+	create_pool_buffer(self, (VkDeviceSize)vertex_stride * vertex_capacity,
+			   VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &self->vertex_buffer,
+			   &self->vertex_alloc);
+	create_pool_buffer(self, sizeof(Uint32) * (VkDeviceSize)index_capacity,
+			   VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &self->index_buffer,
+			   &self->index_alloc);
+
+	free_list_init(&self->free_vertices, vertex_capacity);
+	free_list_init(&self->free_indices, index_capacity);
+}
+
+void vk_mesh_pool_destroy(vk_mesh_pool *self)
+{
+	vk_mem_destroy_buffer(self->allocator, self->vertex_buffer, &self->vertex_alloc);
+	vk_mem_destroy_buffer(self->allocator, self->index_buffer, &self->index_alloc);
+	free(self->free_vertices.ranges);
+	free(self->free_indices.ranges);
+	free(self->meshes);
+}
+
+Uint32 vk_mesh_pool_add(vk_mesh_pool *self, vk_upload_ring *upload,
+			const void *vertices, Uint32 vertex_count,
+			const Uint32 *indices, Uint32 index_count)
+{
+	Uint32 first_vertex;
+	Uint32 first_index;
+	if (!free_list_alloc(&self->free_vertices, vertex_count, &first_vertex)) {
+		fprintf(stderr, "Mesh pool is out of vertex space\n");
+		return VK_MESH_INVALID;
+	}
+	if (!free_list_alloc(&self->free_indices, index_count, &first_index)) {
+		fprintf(stderr, "Mesh pool is out of index space\n");
+		free_list_free(&self->free_vertices, first_vertex, vertex_count);
+		return VK_MESH_INVALID;
+	}
+
+	vk_upload_buffer(upload, self->vertex_buffer,
+			 (VkDeviceSize)first_vertex * self->vertex_stride, vertices,
+			 (VkDeviceSize)vertex_count * self->vertex_stride);
+	vk_upload_buffer(upload, self->index_buffer,
+			 (VkDeviceSize)first_index * sizeof(Uint32), indices,
+			 (VkDeviceSize)index_count * sizeof(Uint32));
+
+	Uint32 id = 0;
+	while (id < self->mesh_count &&
+	       (self->meshes[id].live || self->meshes[id].removed)) {
+		id++;
+	}
+	if (id == self->mesh_count) {
+		if (self->mesh_count == self->mesh_cap) {
+			self->mesh_cap = self->mesh_cap ? self->mesh_cap * 2 : 64;
+			self->meshes = realloc(self->meshes, sizeof(vk_mesh) * self->mesh_cap);
+		}
+		self->mesh_count++;
+	}
+
+	vk_mesh *mesh = &self->meshes[id];
+	mesh->first_index = first_index;
+	mesh->index_count = index_count;
+	mesh->vertex_offset = (Sint32)first_vertex;
+	mesh->vertex_count = vertex_count;
+	mesh->live = true;
+	mesh->removed = false;
+
+	return id;
+}
+
+void vk_mesh_pool_remove(vk_mesh_pool *self, Uint32 mesh)
+{
+	vk_mesh *m = vk_mesh_pool_get(self, mesh);
+	if (m == NULL) {
+		return;
+	}
+	m->live = false;
+	m->removed = true;
+}
+
+void vk_mesh_pool_release(vk_mesh_pool *self, Uint32 mesh)
+{
+	if (mesh >= self->mesh_count || !self->meshes[mesh].removed) {
+		return;
+	}
+
+	vk_mesh *m = &self->meshes[mesh];
+	free_list_free(&self->free_vertices, (Uint32)m->vertex_offset, m->vertex_count);
+	free_list_free(&self->free_indices, m->first_index, m->index_count);
+	m->removed = false;
+}
+
+vk_mesh *vk_mesh_pool_get(vk_mesh_pool *self, Uint32 mesh)
+{
+	if (mesh >= self->mesh_count || !self->meshes[mesh].live) {
+		return NULL;
+	}
+	return &self->meshes[mesh];
+}
+
+void vk_mesh_pool_bind(vk_mesh_pool *self, VkCommandBuffer cmd)
+{
+	VkDeviceSize offsets[] = { 0 };
+	vkCmdBindVertexBuffers(cmd, 0, 1, &self->vertex_buffer, offsets);
+	vkCmdBindIndexBuffer(cmd, self->index_buffer, 0, VK_INDEX_TYPE_UINT32);
+}
@@ -0,0 +1,137 @@
+#include "vk/vk_pipeline_cache.h"
+#include <vulkan/vk_enum_string_helper.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static bool read_cache_file(const char *path, void **rdata, size_t *rsize)
+{
+	FILE *file = fopen(path, "rb");
+	if (file == NULL) {
+		// first run, nothing cached yet
+		return false;
+	}
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	rewind(file);
+	if (size <= 0) {
+		fclose(file);
+		return false;
+	}
+
+	void *data = malloc(size);
+	if (fread(data, size, 1, file) != 1) {
+		fprintf(stderr, "Error reading pipeline cache %s\n", path);
+		free(data);
+		fclose(file);
+		return false;
+	}
+	fclose(file);
+
+	*rdata = data;
+	*rsize = size;
+	return true;
+}
+
+static bool header_matches(VkPhysicalDevice phy_dev, const void *data, size_t size)
+{
+	VkPipelineCacheHeaderVersionOne header;
+	if (size < sizeof(VkPipelineCacheHeaderVersionOne)) {
+		return false;
+	}
+	memcpy(&header, data, sizeof(VkPipelineCacheHeaderVersionOne));
+
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(phy_dev, &props);
+
+	return header.headerSize >= sizeof(VkPipelineCacheHeaderVersionOne) &&
+	       header.headerSize <= size &&
+	       header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+	       header.vendorID == props.vendorID && header.deviceID == props.deviceID &&
+	       memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+VkPipelineCache vk_pipeline_cache_load(VkPhysicalDevice phy_dev, VkDevice log_dev,
+				       const char *path)
+{
+	void *data = NULL;
+	size_t size = 0;
+	if (read_cache_file(path, &data, &size) && !header_matches(phy_dev, data, size)) {
+		// another GPU or driver version wrote it
+		fprintf(stderr, "Ignoring stale pipeline cache %s\n", path);
+		free(data);
+		data = NULL;
+		size = 0;
+	}
+
+	VkPipelineCacheCreateInfo cache_info;
+	memset(&cache_info, 0, sizeof(VkPipelineCacheCreateInfo));
+	cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cache_info.initialDataSize = size;
+	cache_info.pInitialData = data;
+
+	VkPipelineCache cache = VK_NULL_HANDLE;
+	VkResult result = vkCreatePipelineCache(log_dev, &cache_info, NULL, &cache);
+	if (result != VK_SUCCESS && data != NULL) {
+		fprintf(stderr, "Error seeding pipeline cache, starting empty, err: %s\n",
+			string_VkResult(result));
+		cache_info.initialDataSize = 0;
+		cache_info.pInitialData = NULL;
+		result = vkCreatePipelineCache(log_dev, &cache_info, NULL, &cache);
+	}
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error creating pipeline cache, err: %s\n",
+			string_VkResult(result));
+	}
+
+	free(data);
+	return cache;
+}
+
+void vk_pipeline_cache_save(VkDevice log_dev, VkPipelineCache cache,
+			    const char *path)
+{
+	if (cache == VK_NULL_HANDLE) {
+		return;
+	}
+
+	size_t size = 0;
+	VkResult result = vkGetPipelineCacheData(log_dev, cache, &size, NULL);
+	if (result != VK_SUCCESS || size == 0) {
+		return;
+	}
+	void *data = malloc(size);
+	result = vkGetPipelineCacheData(log_dev, cache, &size, data);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error getting pipeline cache data, err: %s\n",
+			string_VkResult(result));
+		free(data);
+		return;
+	}
+
+	// write next to the target and rename over it
+	size_t path_len = strlen(path);
+	char tmp_path[path_len + 5];
+	memcpy(tmp_path, path, path_len);
+	memcpy(tmp_path + path_len, ".tmp", 5);
+
+	FILE *file = fopen(tmp_path, "wb");
+	if (file == NULL) {
+		fprintf(stderr, "Error opening %s for writing\n", tmp_path);
+		free(data);
+		return;
+	}
+	bool ok = fwrite(data, size, 1, file) == 1;
+	ok = fflush(file) == 0 && ok;
+	ok = fsync(fileno(file)) == 0 && ok;
+	ok = fclose(file) == 0 && ok;
+	free(data);
+
+	if (!ok || rename(tmp_path, path) != 0) {
+		fprintf(stderr, "Error writing pipeline cache %s\n", path);
+		remove(tmp_path);
+	}
+}
@@ -0,0 +1,537 @@
+#include "vk/vk_pipelines.h"
+#include <vulkan/vk_enum_string_helper.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "asset_pack.h"
+#include "vk/vk_initializers.h"
+
+void vk_pipeline_desc_init(vk_pipeline_desc *desc)
+{
+	memset(desc, 0, sizeof(vk_pipeline_desc));
+	vk_pipeline_desc_set_shaders(desc, "build/vert.spv", "build/frag.spv");
+	desc->topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	desc->polygon_mode = VK_POLYGON_MODE_FILL;
+	desc->cull_mode = VK_CULL_MODE_BACK_BIT;
+	desc->front_face = VK_FRONT_FACE_CLOCKWISE;
+	// opaque draws sort front to back and grouped by pipeline; 2D and
+	// overlay content asks for VK_BLEND_MODE_ALPHA and is drawn last
+	desc->blend = VK_BLEND_MODE_OPAQUE;
+	// equal depths keep the later draw, as without a depth buffer
+	desc->depth_test = VK_TRUE;
+	desc->depth_write = VK_TRUE;
+	desc->depth_compare = VK_COMPARE_OP_LESS_OR_EQUAL;
+}
+
+void vk_pipeline_desc_set_shaders(vk_pipeline_desc *desc, const char *vert_path,
+				  const char *frag_path)
+{
+	// strncpy zero fills the tail, which keeps the hash stable
+	strncpy(desc->vert_path, vert_path, VK_PIPELINE_PATH_LEN - 1);
+	strncpy(desc->frag_path, frag_path, VK_PIPELINE_PATH_LEN - 1);
+}
+
+// FNV-1a
+Uint64 vk_pipeline_desc_hash(const vk_pipeline_desc *desc)
+{
+	const Uint8 *bytes = (const Uint8 *)desc;
+	Uint64 hash = 14695981039346656037ull;
+	for (size_t i = 0; i < sizeof(vk_pipeline_desc); i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+static void blend_attachment(vk_blend_mode mode,
+			     VkPipelineColorBlendAttachmentState *ratt)
+{
+	memset(ratt, 0, sizeof(VkPipelineColorBlendAttachmentState));
+	ratt->colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+			       VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	ratt->colorBlendOp = VK_BLEND_OP_ADD;
+	ratt->srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	ratt->dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	ratt->alphaBlendOp = VK_BLEND_OP_ADD;
+
+	switch (mode) {
+	case VK_BLEND_MODE_OPAQUE:
+		ratt->blendEnable = VK_FALSE;
+		ratt->srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		ratt->dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+		break;
+	case VK_BLEND_MODE_ALPHA:
+		ratt->blendEnable = VK_TRUE;
+		ratt->srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+		ratt->dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		break;
+	case VK_BLEND_MODE_ADDITIVE:
+		ratt->blendEnable = VK_TRUE;
+		ratt->srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+		ratt->dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		break;
+	}
+}
+
+// Reloaded shaders come from the freshly compiled files rather than the pack,
+// for reloads and for every build after one. Called from workers.
+static loaded_file load_shader(vk_pipelines *self, const char *path)
+{
+	bool reloaded = false;
+	SDL_LockMutex(self->reloaded_lock);
+	for (Uint32 i = 0; i < self->reloaded_count && !reloaded; i++) {
+		reloaded = strncmp(self->reloaded[i], path, VK_PIPELINE_PATH_LEN) == 0;
+	}
+	SDL_UnlockMutex(self->reloaded_lock);
+	return asset_pack_load(reloaded ? NULL : self->assets, path);
+}
+
+static void mark_reloaded(vk_pipelines *self, const char *path)
+{
+	SDL_LockMutex(self->reloaded_lock);
+	Uint32 i = 0;
+	while (i < self->reloaded_count &&
+	       strncmp(self->reloaded[i], path, VK_PIPELINE_PATH_LEN) != 0) {
+		i++;
+	}
+	if (i == self->reloaded_count) {
+		if (i < VK_PIPELINE_MAX_RELOADED) {
+			strncpy(self->reloaded[i], path, VK_PIPELINE_PATH_LEN - 1);
+			self->reloaded_count++;
+		} else {
+			fprintf(stderr, "Too many reloaded shaders, %s stays packed\n",
+				path);
+		}
+	}
+	SDL_UnlockMutex(self->reloaded_lock);
+}
+
+static VkPipeline build_pipeline(vk_pipelines *self, const vk_pipeline_desc *desc)
+{
+	VkDevice log_dev = self->log_dev;
+	loaded_file vert_code = load_shader(self, desc->vert_path);
+	loaded_file frag_code = load_shader(self, desc->frag_path);
+	if (vert_code.buf == NULL || frag_code.buf == NULL) {
+		loaded_file_destroy(&vert_code);
+		loaded_file_destroy(&frag_code);
+		return VK_NULL_HANDLE;
+	}
+
+	VkShaderModule vert_mod = create_shader_module(log_dev, &vert_code);
+	VkShaderModule frag_mod = create_shader_module(log_dev, &frag_code);
+
+	VkPipelineShaderStageCreateInfo shader_stages[2];
+	memset(shader_stages, 0, sizeof(shader_stages));
+	shader_stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shader_stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shader_stages[0].module = vert_mod;
+	shader_stages[0].pName = "main";
+	shader_stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shader_stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shader_stages[1].module = frag_mod;
+	shader_stages[1].pName = "main";
+
+	VkDynamicState dynamic_states[] = {
+		VK_DYNAMIC_STATE_VIEWPORT,
+		VK_DYNAMIC_STATE_SCISSOR,
+	};
+
+	VkPipelineDynamicStateCreateInfo dsci;
+	memset(&dsci, 0, sizeof(VkPipelineDynamicStateCreateInfo));
+	dsci.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dsci.dynamicStateCount = 2;
+	dsci.pDynamicStates = dynamic_states;
+
+	VkPipelineVertexInputStateCreateInfo visci;
+	memset(&visci, 0, sizeof(VkPipelineVertexInputStateCreateInfo));
+	visci.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	visci.vertexBindingDescriptionCount = desc->binding_count;
+	visci.pVertexBindingDescriptions = desc->bindings;
+	visci.vertexAttributeDescriptionCount = desc->attribute_count;
+	visci.pVertexAttributeDescriptions = desc->attributes;
+
+	VkPipelineInputAssemblyStateCreateInfo iaci;
+	memset(&iaci, 0, sizeof(VkPipelineInputAssemblyStateCreateInfo));
+	iaci.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	iaci.topology = desc->topology;
+	iaci.primitiveRestartEnable = VK_FALSE;
+
+	// viewport and scissor are dynamic
+	VkPipelineViewportStateCreateInfo vsci;
+	memset(&vsci, 0, sizeof(VkPipelineViewportStateCreateInfo));
+	vsci.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	vsci.viewportCount = 1;
+	vsci.scissorCount = 1;
+
+	VkPipelineRasterizationStateCreateInfo rastci;
+	memset(&rastci, 0, sizeof(VkPipelineRasterizationStateCreateInfo));
+	rastci.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rastci.lineWidth = 1.0f;
+	rastci.depthClampEnable = VK_FALSE;
+	rastci.polygonMode = desc->polygon_mode;
+	rastci.cullMode = desc->cull_mode;
+	rastci.frontFace = desc->front_face;
+	rastci.depthBiasEnable = VK_FALSE;
+
+	VkPipelineMultisampleStateCreateInfo multisci;
+	memset(&multisci, 0, sizeof(VkPipelineMultisampleStateCreateInfo));
+	multisci.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisci.sampleShadingEnable = VK_FALSE;
+	multisci.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+	multisci.minSampleShading = 1.0f;
+
+	VkPipelineColorBlendAttachmentState color_blend_att;
+	blend_attachment(desc->blend, &color_blend_att);
+
+	VkPipelineColorBlendStateCreateInfo color_blend_ci;
+	memset(&color_blend_ci, 0, sizeof(VkPipelineColorBlendStateCreateInfo));
+	color_blend_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	color_blend_ci.logicOpEnable = VK_FALSE;
+	color_blend_ci.logicOp = VK_LOGIC_OP_COPY;
+	color_blend_ci.attachmentCount = 1;
+	color_blend_ci.pAttachments = &color_blend_att;
+
+	VkPipelineDepthStencilStateCreateInfo depth_ci;
+	memset(&depth_ci, 0, sizeof(VkPipelineDepthStencilStateCreateInfo));
+	depth_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depth_ci.depthTestEnable = desc->depth_test;
+	depth_ci.depthWriteEnable = desc->depth_write;
+	depth_ci.depthCompareOp = desc->depth_compare;
+	depth_ci.depthBoundsTestEnable = VK_FALSE;
+	depth_ci.stencilTestEnable = VK_FALSE;
+
+	VkPipelineRenderingCreateInfo rendering_ci;
+	memset(&rendering_ci, 0, sizeof(VkPipelineRenderingCreateInfo));
+	rendering_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+	rendering_ci.colorAttachmentCount = 1;
+	rendering_ci.pColorAttachmentFormats = &desc->color_format;
+	rendering_ci.depthAttachmentFormat = desc->depth_format;
+	rendering_ci.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+
+	VkGraphicsPipelineCreateInfo pipeline_ci;
+	memset(&pipeline_ci, 0, sizeof(VkGraphicsPipelineCreateInfo));
+	pipeline_ci.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	// the attachment formats stand in for the render pass
+	pipeline_ci.pNext = desc->render_pass == VK_NULL_HANDLE ? &rendering_ci : NULL;
+	pipeline_ci.stageCount = 2;
+	pipeline_ci.pStages = shader_stages;
+	pipeline_ci.pVertexInputState = &visci;
+	pipeline_ci.pInputAssemblyState = &iaci;
+	pipeline_ci.pViewportState = &vsci;
+	pipeline_ci.pRasterizationState = &rastci;
+	pipeline_ci.pMultisampleState = &multisci;
+	pipeline_ci.pDepthStencilState = &depth_ci;
+	pipeline_ci.pColorBlendState = &color_blend_ci;
+	pipeline_ci.pDynamicState = &dsci;
+	pipeline_ci.layout = desc->layout;
+	pipeline_ci.renderPass = desc->render_pass;
+	pipeline_ci.subpass = desc->subpass;
+	pipeline_ci.basePipelineHandle = VK_NULL_HANDLE;
+	pipeline_ci.basePipelineIndex = -1;
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkResult result = vkCreateGraphicsPipelines(log_dev, self->cache, 1, &pipeline_ci,
+						    NULL, &pipeline);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error creating graphics pipeline . err: %s\n",
+			string_VkResult(result));
+		pipeline = VK_NULL_HANDLE;
+	}
+
+	vkDestroyShaderModule(log_dev, vert_mod, NULL);
+	vkDestroyShaderModule(log_dev, frag_mod, NULL);
+	loaded_file_destroy(&vert_code);
+	loaded_file_destroy(&frag_code);
+
+	return pipeline;
+}
+
+static void compile_entry(vk_pipeline_entry *entry)
+{
+	vk_pipelines *self = entry->owner;
+
+	Uint64 start = SDL_GetPerformanceCounter();
+	entry->pipeline = build_pipeline(self, &entry->desc);
+	entry->compile_ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 /
+			    SDL_GetPerformanceFrequency();
+
+	SDL_LockMutex(self->stats_lock);
+	if (entry->pipeline != VK_NULL_HANDLE) {
+		self->stats.compiled++;
+	} else {
+		self->stats.failed++;
+	}
+	self->stats.total_compile_ms += entry->compile_ms;
+	if (entry->compile_ms > self->stats.max_compile_ms) {
+		self->stats.max_compile_ms = entry->compile_ms;
+	}
+	SDL_UnlockMutex(self->stats_lock);
+
+	// the handle is written before the state that publishes it
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&entry->state, entry->pipeline != VK_NULL_HANDLE ?
+					     VK_PIPELINE_READY :
+					     VK_PIPELINE_FAILED);
+}
+
+static void compile_job(void *data)
+{
+	compile_entry(data);
+}
+
+static void reload_job(void *data)
+{
+	vk_pipeline_entry *entry = data;
+	vk_pipelines *self = entry->owner;
+
+	Uint64 start = SDL_GetPerformanceCounter();
+	entry->next_pipeline = build_pipeline(self, &entry->desc);
+	double ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 /
+		    SDL_GetPerformanceFrequency();
+
+	SDL_LockMutex(self->stats_lock);
+	if (entry->next_pipeline != VK_NULL_HANDLE) {
+		self->stats.compiled++;
+	} else {
+		self->stats.failed++;
+	}
+	self->stats.total_compile_ms += ms;
+	if (ms > self->stats.max_compile_ms) {
+		self->stats.max_compile_ms = ms;
+	}
+	SDL_UnlockMutex(self->stats_lock);
+
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&entry->reload, VK_RELOAD_DONE);
+}
+
+static vk_pipeline_entry *find_entry(vk_pipelines *self, const vk_pipeline_desc *desc,
+				     Uint64 hash)
+{
+	Uint32 mask = self->slot_cap - 1;
+	for (Uint32 i = hash & mask;; i = (i + 1) & mask) {
+		vk_pipeline_entry *entry = self->slots[i];
+		if (entry == NULL) {
+			return NULL;
+		}
+		if (entry->hash == hash &&
+		    memcmp(&entry->desc, desc, sizeof(vk_pipeline_desc)) == 0) {
+			return entry;
+		}
+	}
+}
+
+static void place_entry(vk_pipeline_entry **slots, Uint32 cap, vk_pipeline_entry *entry)
+{
+	Uint32 mask = cap - 1;
+	Uint32 i = entry->hash & mask;
+	while (slots[i] != NULL) {
+		i = (i + 1) & mask;
+	}
+	slots[i] = entry;
+}
+
+static vk_pipeline_entry *insert_entry(vk_pipelines *self, const vk_pipeline_desc *desc,
+				       Uint64 hash)
+{
+	// keep the load under 3/4; entries are heap allocated so workers'
+	// pointers survive the rehash
+	if ((self->entry_count + 1) * 4 > self->slot_cap * 3) {
+		Uint32 cap = self->slot_cap * 2;
+		vk_pipeline_entry **slots = calloc(cap, sizeof(vk_pipeline_entry *));
+		for (Uint32 i = 0; i < self->slot_cap; i++) {
+			if (self->slots[i] != NULL) {
+				place_entry(slots, cap, self->slots[i]);
+			}
+		}
+		free(self->slots);
+		self->slots = slots;
+		self->slot_cap = cap;
+	}
+
+	vk_pipeline_entry *entry = calloc(1, sizeof(vk_pipeline_entry));
+	memcpy(&entry->desc, desc, sizeof(vk_pipeline_desc));
+	entry->hash = hash;
+	entry->owner = self;
+	SDL_AtomicSet(&entry->state, VK_PIPELINE_PENDING);
+
+	place_entry(self->slots, self->slot_cap, entry);
+	self->entry_count++;
+	return entry;
+}
+
+void vk_pipelines_init(vk_pipelines *self, VkDevice log_dev, VkPipelineCache cache,
+		       job_system *jobs, const asset_pack *assets,
+		       vk_deletion_queue *deletions)
+{
+	memset(self, 0, sizeof(vk_pipelines));
+	self->log_dev = log_dev;
+	self->deletions = deletions;
+	self->assets = assets;
+	self->cache = cache;
+	self->jobs = jobs;
+	self->slot_cap = 64;
+	self->slots = calloc(self->slot_cap, sizeof(vk_pipeline_entry *));
+	self->stats_lock = SDL_CreateMutex();
+	self->reloaded_lock = SDL_CreateMutex();
+}
+
+void vk_pipelines_destroy(vk_pipelines *self)
+{
+	job_system_wait(self->jobs);
+
+	for (Uint32 i = 0; i < self->slot_cap; i++) {
+		vk_pipeline_entry *entry = self->slots[i];
+		if (entry == NULL) {
+			continue;
+		}
+		vkDestroyPipeline(self->log_dev, entry->pipeline, NULL);
+		vkDestroyPipeline(self->log_dev, entry->next_pipeline, NULL);
+		free(entry);
+	}
+	free(self->slots);
+	SDL_DestroyMutex(self->stats_lock);
+	SDL_DestroyMutex(self->reloaded_lock);
+}
+
+VkPipeline vk_pipelines_get(vk_pipelines *self, const vk_pipeline_desc *desc,
+			    VkPipeline fallback)
+{
+	Uint64 hash = vk_pipeline_desc_hash(desc);
+	vk_pipeline_entry *entry = find_entry(self, desc, hash);
+	if (entry == NULL) {
+		entry = insert_entry(self, desc, hash);
+		self->stats.misses++;
+		self->stats.fallbacks++;
+		job_system_push(self->jobs, compile_job, entry);
+		return fallback;
+	}
+
+	if (SDL_AtomicGet(&entry->state) == VK_PIPELINE_READY) {
+		// pairs with the release in compile_entry
+		SDL_MemoryBarrierAcquire();
+		self->stats.hits++;
+		return entry->pipeline;
+	}
+	self->stats.fallbacks++;
+	return fallback;
+}
+
+VkPipeline vk_pipelines_get_blocking(vk_pipelines *self, const vk_pipeline_desc *desc)
+{
+	Uint64 hash = vk_pipeline_desc_hash(desc);
+	vk_pipeline_entry *entry = find_entry(self, desc, hash);
+	if (entry == NULL) {
+		entry = insert_entry(self, desc, hash);
+		self->stats.misses++;
+		compile_entry(entry);
+	} else if (SDL_AtomicGet(&entry->state) == VK_PIPELINE_PENDING) {
+		job_system_wait(self->jobs);
+	} else {
+		SDL_MemoryBarrierAcquire();
+		self->stats.hits++;
+	}
+
+	return entry->pipeline;
+}
+
+void vk_pipelines_get_stats(vk_pipelines *self, vk_pipeline_stats *rstats)
+{
+	SDL_LockMutex(self->stats_lock);
+	memcpy(rstats, &self->stats, sizeof(vk_pipeline_stats));
+	SDL_UnlockMutex(self->stats_lock);
+
+	rstats->pending = 0;
+	for (Uint32 i = 0; i < self->slot_cap; i++) {
+		vk_pipeline_entry *entry = self->slots[i];
+		if (entry != NULL && SDL_AtomicGet(&entry->state) == VK_PIPELINE_PENDING) {
+			rstats->pending++;
+		}
+	}
+}
+
+static bool uses_shader(const vk_pipeline_desc *desc, const char *spv_path)
+{
+	return strncmp(desc->vert_path, spv_path, VK_PIPELINE_PATH_LEN) == 0 ||
+	       strncmp(desc->frag_path, spv_path, VK_PIPELINE_PATH_LEN) == 0;
+}
+
+static void start_reload(vk_pipelines *self, vk_pipeline_entry *entry)
+{
+	if (SDL_AtomicGet(&entry->reload) != VK_RELOAD_IDLE ||
+	    SDL_AtomicGet(&entry->state) == VK_PIPELINE_PENDING) {
+		// the compile in progress may have read the old file
+		entry->reload_again = true;
+		self->reload_again = true;
+		return;
+	}
+
+	entry->reload_again = false;
+	if (SDL_AtomicGet(&entry->state) == VK_PIPELINE_FAILED) {
+		// never built: compile it like a first miss
+		SDL_AtomicSet(&entry->state, VK_PIPELINE_PENDING);
+		job_system_push(self->jobs, compile_job, entry);
+		return;
+	}
+
+	entry->next_pipeline = VK_NULL_HANDLE;
+	SDL_AtomicSet(&entry->reload, VK_RELOAD_COMPILING);
+	self->reloads++;
+	job_system_push(self->jobs, reload_job, entry);
+}
+
+void vk_pipelines_reload_shader(vk_pipelines *self, const char *spv_path)
+{
+	// before any job is queued, so they all see the new file
+	mark_reloaded(self, spv_path);
+	for (Uint32 i = 0; i < self->slot_cap; i++) {
+		vk_pipeline_entry *entry = self->slots[i];
+		if (entry != NULL && uses_shader(&entry->desc, spv_path)) {
+			start_reload(self, entry);
+		}
+	}
+}
+
+Uint32 vk_pipelines_update(vk_pipelines *self, Uint64 frame)
+{
+	Uint32 swapped = 0;
+	if (self->reloads == 0 && !self->reload_again) {
+		return 0;
+	}
+
+	bool again = self->reload_again;
+	self->reload_again = false;
+	for (Uint32 i = 0; i < self->slot_cap; i++) {
+		vk_pipeline_entry *entry = self->slots[i];
+		if (entry == NULL || SDL_AtomicGet(&entry->reload) != VK_RELOAD_DONE) {
+			continue;
+		}
+		// pairs with the release in reload_job
+		SDL_MemoryBarrierAcquire();
+
+		if (entry->next_pipeline != VK_NULL_HANDLE) {
+			vk_deletion_queue_push(self->deletions,
+					       &(vk_deletion){ .type = VK_DELETE_PIPELINE,
+							       .frame = frame,
+							       .pipeline = entry->pipeline });
+			entry->pipeline = entry->next_pipeline;
+			entry->next_pipeline = VK_NULL_HANDLE;
+			swapped++;
+		} else {
+			fprintf(stderr, "Shader reload failed, keeping %s + %s\n",
+				entry->desc.vert_path, entry->desc.frag_path);
+		}
+		SDL_AtomicSet(&entry->reload, VK_RELOAD_IDLE);
+		self->reloads--;
+	}
+
+	for (Uint32 i = 0; i < self->slot_cap && again; i++) {
+		vk_pipeline_entry *entry = self->slots[i];
+		if (entry != NULL && entry->reload_again) {
+			start_reload(self, entry);
+		}
+	}
+
+	return swapped;
+}
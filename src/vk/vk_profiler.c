@@ -0,0 +1,219 @@
+#include "vk/vk_profiler.h"
+#include <vulkan/vk_enum_string_helper.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void vk_profiler_init(vk_profiler *self, VkPhysicalDevice phy_dev, VkDevice log_dev,
+		      Uint32 queue_family, Uint32 slot_count)
+{
+	memset(self, 0, sizeof(vk_profiler));
+	self->log_dev = log_dev;
+	self->slot_count = slot_count;
+	self->slots = calloc(slot_count, sizeof(vk_profiler_slot));
+	self->cpu_origin = SDL_GetPerformanceCounter();
+	self->cpu_freq = SDL_GetPerformanceFrequency();
+
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(phy_dev, &props);
+	self->period_ns = props.limits.timestampPeriod;
+
+	Uint32 family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(phy_dev, &family_count, NULL);
+	VkQueueFamilyProperties families[family_count];
+	vkGetPhysicalDeviceQueueFamilyProperties(phy_dev, &family_count, families);
+	Uint32 valid_bits = queue_family < family_count
+				    ? families[queue_family].timestampValidBits
+				    : 0;
+	if (valid_bits == 0 || self->period_ns <= 0.0) {
+		fprintf(stderr, "Timestamps are not supported, GPU profiling is off\n");
+		return;
+	}
+	self->valid_mask = valid_bits >= 64 ? UINT64_MAX : (1ull << valid_bits) - 1;
+
+	VkQueryPoolCreateInfo pool_info;
+	memset(&pool_info, 0, sizeof(VkQueryPoolCreateInfo));
+	pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	pool_info.queryCount = slot_count * VK_PROFILER_MAX_SCOPES * 2;
+
+	VkResult result =
+		vkCreateQueryPool(log_dev, &pool_info, NULL, &self->query_pool);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error creating timestamp query pool, err: %s\n",
+			string_VkResult(result));
+		return;
+	}
+	self->enabled = true;
+}
+
+void vk_profiler_destroy(vk_profiler *self)
+{
+	if (self->enabled) {
+		vkDestroyQueryPool(self->log_dev, self->query_pool, NULL);
+	}
+	free(self->slots);
+	free(self->events);
+}
+
+static void add_event(vk_profiler *self, const char *name, double ts_us,
+		      double dur_us, Uint32 tid, Uint64 frame)
+{
+	if (!self->capturing || self->event_count == VK_PROFILER_MAX_TRACE_EVENTS) {
+		return;
+	}
+	vk_trace_event *event = &self->events[self->event_count++];
+	event->name = name;
+	event->ts_us = ts_us;
+	event->dur_us = dur_us;
+	event->tid = tid;
+	event->frame = frame;
+}
+
+void vk_profiler_collect(vk_profiler *self, Uint32 slot)
+{
+	vk_profiler_slot *s = &self->slots[slot];
+	if (!self->enabled || !s->submitted || s->scope_count == 0) {
+		return;
+	}
+
+	Uint64 ticks[VK_PROFILER_MAX_SCOPES * 2];
+	VkResult result = vkGetQueryPoolResults(
+		self->log_dev, self->query_pool, slot * VK_PROFILER_MAX_SCOPES * 2,
+		s->scope_count * 2, sizeof(ticks), ticks, sizeof(Uint64),
+		VK_QUERY_RESULT_64_BIT);
+	// VK_NOT_READY means a scope was never ended; never wait for it
+	if (result != VK_SUCCESS) {
+		return;
+	}
+	s->submitted = false;
+
+	Uint64 origin = ticks[0] & self->valid_mask;
+	self->result_count = s->scope_count;
+	self->result_frame = s->frame;
+	for (Uint32 i = 0; i < s->scope_count; i++) {
+		Uint64 begin = ticks[i * 2] & self->valid_mask;
+		Uint64 end = ticks[i * 2 + 1] & self->valid_mask;
+		double dur_us =
+			(double)((end - begin) & self->valid_mask) * self->period_ns / 1000.0;
+		self->results[i].name = s->names[i];
+		self->results[i].ms = dur_us / 1000.0;
+
+		double offset_us = (double)((begin - origin) & self->valid_mask) *
+				   self->period_ns / 1000.0;
+		add_event(self, s->names[i], s->submit_us + offset_us, dur_us, 1, s->frame);
+	}
+}
+
+void vk_profiler_reset(vk_profiler *self, VkCommandBuffer cmd, Uint32 slot)
+{
+	self->slot = slot;
+	self->slots[slot].scope_count = 0;
+	if (self->enabled) {
+		vkCmdResetQueryPool(cmd, self->query_pool,
+				    slot * VK_PROFILER_MAX_SCOPES * 2,
+				    VK_PROFILER_MAX_SCOPES * 2);
+	}
+}
+
+Uint32 vk_profiler_begin(vk_profiler *self, VkCommandBuffer cmd, const char *name)
+{
+	vk_profiler_slot *s = &self->slots[self->slot];
+	if (!self->enabled || s->scope_count == VK_PROFILER_MAX_SCOPES) {
+		return UINT32_MAX;
+	}
+
+	Uint32 scope = s->scope_count++;
+	s->names[scope] = name;
+	vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, self->query_pool,
+			    (self->slot * VK_PROFILER_MAX_SCOPES + scope) * 2);
+	return scope;
+}
+
+void vk_profiler_end(vk_profiler *self, VkCommandBuffer cmd, Uint32 scope)
+{
+	if (scope == UINT32_MAX) {
+		return;
+	}
+	vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, self->query_pool,
+			    (self->slot * VK_PROFILER_MAX_SCOPES + scope) * 2 + 1);
+}
+
+void vk_profiler_submit(vk_profiler *self, Uint32 slot, Uint64 frame)
+{
+	vk_profiler_slot *s = &self->slots[slot];
+	s->frame = frame;
+	s->submit_us = vk_profiler_now_us(self);
+	s->submitted = true;
+}
+
+double vk_profiler_now_us(vk_profiler *self)
+{
+	Uint64 elapsed = SDL_GetPerformanceCounter() - self->cpu_origin;
+	return (double)elapsed * 1000000.0 / (double)self->cpu_freq;
+}
+
+void vk_profiler_cpu_scope(vk_profiler *self, const char *name, double start_us,
+			   double end_us, Uint64 frame)
+{
+	add_event(self, name, start_us, end_us - start_us, 0, frame);
+}
+
+void vk_profiler_start_capture(vk_profiler *self)
+{
+	if (self->events == NULL) {
+		self->events = malloc(sizeof(vk_trace_event) * VK_PROFILER_MAX_TRACE_EVENTS);
+	}
+	self->event_count = 0;
+	self->capturing = true;
+}
+
+void vk_profiler_stop_capture(vk_profiler *self)
+{
+	self->capturing = false;
+}
+
+static void write_json_string(FILE *file, const char *str)
+{
+	fputc('"', file);
+	for (const char *c = str; *c != '\0'; c++) {
+		if (*c == '"' || *c == '\\') {
+			fputc('\\', file);
+		}
+		fputc(*c, file);
+	}
+	fputc('"', file);
+}
+
+bool vk_profiler_write_trace(vk_profiler *self, const char *path)
+{
+	FILE *file = fopen(path, "w");
+	if (file == NULL) {
+		fprintf(stderr, "Error opening trace file %s\n", path);
+		return false;
+	}
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+		      "\"args\":{\"name\":\"CPU\"}},\n");
+	fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,"
+		      "\"args\":{\"name\":\"GPU\"}}");
+	for (Uint32 i = 0; i < self->event_count; i++) {
+		vk_trace_event *event = &self->events[i];
+		fprintf(file, ",\n{\"name\":");
+		write_json_string(file, event->name);
+		fprintf(file,
+			",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+			"\"pid\":1,\"tid\":%u,\"args\":{\"frame\":%llu}}",
+			event->tid == 0 ? "cpu" : "gpu", event->ts_us, event->dur_us,
+			event->tid, (unsigned long long)event->frame);
+	}
+	fprintf(file, "\n]}\n");
+
+	bool ok = ferror(file) == 0;
+	if (fclose(file) != 0 || !ok) {
+		fprintf(stderr, "Error writing trace file %s\n", path);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,1113 @@
+#include "vk/vk_render_graph.h"
+#include <vulkan/vk_enum_string_helper.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+	VkImageLayout layout;
+	VkPipelineStageFlags stages;
+	VkAccessFlags access;
+	VkAccessFlags writes; // the part of access that writes
+	VkImageUsageFlags image_usage;
+} usage_info;
+
+static usage_info get_usage_info(vk_rg_usage usage, vk_rg_pass_type type)
+{
+	VkPipelineStageFlags shader_stages =
+		type == VK_RG_PASS_COMPUTE ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+					   : VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+						     VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	usage_info info;
+	memset(&info, 0, sizeof(usage_info));
+	switch (usage) {
+	case VK_RG_COLOR_ATTACHMENT:
+		info.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		info.stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		info.access = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+			      VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		info.writes = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		info.image_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		break;
+	case VK_RG_DEPTH_ATTACHMENT:
+		info.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		info.stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+			      VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		info.access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+			      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		info.writes = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		info.image_usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		break;
+	case VK_RG_SAMPLED:
+		info.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		info.stages = shader_stages;
+		info.access = VK_ACCESS_SHADER_READ_BIT;
+		info.image_usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+		break;
+	case VK_RG_STORAGE_READ:
+		info.layout = VK_IMAGE_LAYOUT_GENERAL;
+		info.stages = shader_stages;
+		info.access = VK_ACCESS_SHADER_READ_BIT;
+		info.image_usage = VK_IMAGE_USAGE_STORAGE_BIT;
+		break;
+	case VK_RG_STORAGE_WRITE:
+		info.layout = VK_IMAGE_LAYOUT_GENERAL;
+		info.stages = shader_stages;
+		info.access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		info.writes = VK_ACCESS_SHADER_WRITE_BIT;
+		info.image_usage = VK_IMAGE_USAGE_STORAGE_BIT;
+		break;
+	case VK_RG_TRANSFER_SRC:
+		info.layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		info.stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		info.access = VK_ACCESS_TRANSFER_READ_BIT;
+		info.image_usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		break;
+	case VK_RG_TRANSFER_DST:
+		info.layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		info.stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		info.access = VK_ACCESS_TRANSFER_WRITE_BIT;
+		info.writes = VK_ACCESS_TRANSFER_WRITE_BIT;
+		info.image_usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		break;
+	}
+	return info;
+}
+
+static bool is_attachment(const vk_rg_use *use)
+{
+	return use->usage == VK_RG_COLOR_ATTACHMENT || use->usage == VK_RG_DEPTH_ATTACHMENT;
+}
+
+// Attachments not loaded are cleared or left undefined, so whatever was
+// there before doesn't matter.
+static bool overwrites(const vk_rg_use *use)
+{
+	return is_attachment(use) && use->load != VK_ATTACHMENT_LOAD_OP_LOAD;
+}
+
+// Storage and transfer writes may only touch part of the image.
+static bool reads_contents(const vk_rg_use *use)
+{
+	return is_attachment(use) ? use->load == VK_ATTACHMENT_LOAD_OP_LOAD : true;
+}
+
+static VkImageAspectFlags format_aspect(VkFormat format)
+{
+	switch (format) {
+	case VK_FORMAT_D16_UNORM:
+	case VK_FORMAT_X8_D24_UNORM_PACK32:
+	case VK_FORMAT_D32_SFLOAT:
+		return VK_IMAGE_ASPECT_DEPTH_BIT;
+	case VK_FORMAT_D16_UNORM_S8_UINT:
+	case VK_FORMAT_D24_UNORM_S8_UINT:
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+	case VK_FORMAT_S8_UINT:
+		return VK_IMAGE_ASPECT_STENCIL_BIT;
+	default:
+		return VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+}
+
+static VkExtent2D resource_extent(vk_render_graph *self, const vk_rg_resource *res)
+{
+	if (res->width == 0 || res->height == 0) {
+		return self->extent;
+	}
+	return (VkExtent2D){ res->width, res->height };
+}
+
+static VkImage resource_image(vk_render_graph *self, Uint32 resource, Uint32 image_idx)
+{
+	vk_rg_resource *res = &self->resources[resource];
+	if (res->imported) {
+		return res->images[image_idx % res->image_count];
+	}
+	return self->targets->images[resource];
+}
+
+static VkImageView resource_view(vk_render_graph *self, Uint32 resource,
+				 Uint32 image_idx)
+{
+	vk_rg_resource *res = &self->resources[resource];
+	if (res->imported) {
+		return res->views[image_idx % res->image_count];
+	}
+	return self->targets->views[resource];
+}
+
+void vk_render_graph_init(vk_render_graph *self, vk_mem_allocator *allocator,
+			  VkDevice log_dev, bool dynamic_rendering)
+{
+	memset(self, 0, sizeof(vk_render_graph));
+	self->log_dev = log_dev;
+	self->allocator = allocator;
+	self->dynamic_rendering = dynamic_rendering;
+}
+
+static void destroy_targets(void *owner, Uint64 arg)
+{
+	(void)arg;
+	vk_rg_targets *targets = owner;
+	for (Uint32 i = 0; i < VK_RG_MAX_PASSES; i++) {
+		for (Uint32 j = 0; j < targets->framebuffer_counts[i]; j++) {
+			vkDestroyFramebuffer(targets->log_dev, targets->framebuffers[i][j],
+					     NULL);
+		}
+		free(targets->framebuffers[i]);
+	}
+	for (Uint32 i = 0; i < VK_RG_MAX_RESOURCES; i++) {
+		if (targets->views[i] != VK_NULL_HANDLE) {
+			vkDestroyImageView(targets->log_dev, targets->views[i], NULL);
+		}
+		if (targets->images[i] != VK_NULL_HANDLE) {
+			vkDestroyImage(targets->log_dev, targets->images[i], NULL);
+		}
+	}
+	for (Uint32 i = 0; i < targets->slot_count; i++) {
+		vk_mem_free(targets->allocator, &targets->slots[i]);
+	}
+	free(targets);
+}
+
+void vk_render_graph_destroy(vk_render_graph *self)
+{
+	if (self->targets != NULL) {
+		destroy_targets(self->targets, 0);
+	}
+	for (Uint32 i = 0; i < self->pass_count; i++) {
+		if (self->passes[i].render_pass != VK_NULL_HANDLE) {
+			vkDestroyRenderPass(self->log_dev, self->passes[i].render_pass, NULL);
+		}
+	}
+	for (Uint32 i = 0; i < self->resource_count; i++) {
+		free(self->resources[i].images);
+		free(self->resources[i].views);
+	}
+	free(self->barriers);
+}
+
+static Uint32 add_resource(vk_render_graph *self, const char *name, VkFormat format)
+{
+	if (self->resource_count == VK_RG_MAX_RESOURCES) {
+		fprintf(stderr, "Error: render graph resource %s over the limit\n", name);
+		return UINT32_MAX;
+	}
+	Uint32 idx = self->resource_count++;
+	vk_rg_resource *res = &self->resources[idx];
+	memset(res, 0, sizeof(vk_rg_resource));
+	SDL_strlcpy(res->name, name, VK_RG_NAME_LEN);
+	res->format = format;
+	res->first_pass = -1;
+	res->last_pass = -1;
+	return idx;
+}
+
+Uint32 vk_render_graph_image(vk_render_graph *self, const char *name, VkFormat format,
+			     Uint32 width, Uint32 height)
+{
+	Uint32 idx = add_resource(self, name, format);
+	if (idx != UINT32_MAX) {
+		self->resources[idx].width = width;
+		self->resources[idx].height = height;
+	}
+	return idx;
+}
+
+Uint32 vk_render_graph_import(vk_render_graph *self, const char *name,
+			      VkFormat format, VkImageLayout initial_layout,
+			      VkImageLayout final_layout, VkPipelineStageFlags stages)
+{
+	Uint32 idx = add_resource(self, name, format);
+	if (idx != UINT32_MAX) {
+		vk_rg_resource *res = &self->resources[idx];
+		res->imported = true;
+		res->initial_layout = initial_layout;
+		res->final_layout = final_layout;
+		res->initial_stages = stages;
+	}
+	return idx;
+}
+
+void vk_render_graph_bind_images(vk_render_graph *self, Uint32 resource,
+				 const VkImage *images, const VkImageView *views,
+				 Uint32 count)
+{
+	vk_rg_resource *res = &self->resources[resource];
+	free(res->images);
+	free(res->views);
+	res->images = malloc(sizeof(VkImage) * count);
+	res->views = malloc(sizeof(VkImageView) * count);
+	memcpy(res->images, images, sizeof(VkImage) * count);
+	memcpy(res->views, views, sizeof(VkImageView) * count);
+	res->image_count = count;
+}
+
+Uint32 vk_render_graph_add_pass(vk_render_graph *self, const char *name,
+				vk_rg_pass_type type, vk_rg_record_fn fn, void *data)
+{
+	if (self->pass_count == VK_RG_MAX_PASSES) {
+		fprintf(stderr, "Error: render graph pass %s over the limit\n", name);
+		return UINT32_MAX;
+	}
+	Uint32 idx = self->pass_count++;
+	vk_rg_pass *pass = &self->passes[idx];
+	memset(pass, 0, sizeof(vk_rg_pass));
+	SDL_strlcpy(pass->name, name, VK_RG_NAME_LEN);
+	pass->type = type;
+	pass->fn = fn;
+	pass->data = data;
+	return idx;
+}
+
+void vk_render_graph_keep(vk_render_graph *self, Uint32 pass)
+{
+	self->passes[pass].keep = true;
+}
+
+static vk_rg_use *add_use(vk_render_graph *self, Uint32 pass, Uint32 resource,
+			  vk_rg_usage usage)
+{
+	vk_rg_pass *p = &self->passes[pass];
+	if (p->use_count == VK_RG_MAX_USES) {
+		fprintf(stderr, "Error: render graph pass %s uses too many images\n",
+			p->name);
+		return NULL;
+	}
+	vk_rg_use *use = &p->uses[p->use_count++];
+	memset(use, 0, sizeof(vk_rg_use));
+	use->resource = resource;
+	use->usage = usage;
+	use->load = VK_ATTACHMENT_LOAD_OP_LOAD;
+	return use;
+}
+
+void vk_render_graph_color(vk_render_graph *self, Uint32 pass, Uint32 resource,
+			   VkAttachmentLoadOp load, const VkClearColorValue *clear)
+{
+	vk_rg_use *use = add_use(self, pass, resource, VK_RG_COLOR_ATTACHMENT);
+	if (use == NULL) {
+		return;
+	}
+	use->load = load;
+	if (clear != NULL) {
+		use->clear.color = *clear;
+	}
+}
+
+void vk_render_graph_depth(vk_render_graph *self, Uint32 pass, Uint32 resource,
+			   VkAttachmentLoadOp load, float clear)
+{
+	vk_rg_use *use = add_use(self, pass, resource, VK_RG_DEPTH_ATTACHMENT);
+	if (use == NULL) {
+		return;
+	}
+	use->load = load;
+	use->clear.depthStencil.depth = clear;
+}
+
+void vk_render_graph_use(vk_render_graph *self, Uint32 pass, Uint32 resource,
+			 vk_rg_usage usage)
+{
+	add_use(self, pass, resource, usage);
+}
+
+// Walks back from the imported images, which the caller reads afterwards: a
+// pass is live when it writes something a live pass after it, or the caller,
+// reads. Also marks the writes whose results are read later, which decides
+// attachment store ops.
+static void cull_passes(vk_render_graph *self)
+{
+	bool needed[VK_RG_MAX_RESOURCES];
+	for (Uint32 i = 0; i < self->resource_count; i++) {
+		needed[i] = self->resources[i].imported;
+	}
+
+	for (Uint32 i = self->pass_count; i-- > 0;) {
+		vk_rg_pass *pass = &self->passes[i];
+		pass->live = pass->keep;
+		for (Uint32 j = 0; j < pass->use_count; j++) {
+			vk_rg_use *use = &pass->uses[j];
+			usage_info info = get_usage_info(use->usage, pass->type);
+			if (info.writes != 0 && needed[use->resource]) {
+				pass->live = true;
+			}
+		}
+		if (!pass->live) {
+			continue;
+		}
+
+		for (Uint32 j = 0; j < pass->use_count; j++) {
+			vk_rg_use *use = &pass->uses[j];
+			use->stored = needed[use->resource];
+			if (overwrites(use)) {
+				needed[use->resource] = false;
+			}
+		}
+		for (Uint32 j = 0; j < pass->use_count; j++) {
+			vk_rg_use *use = &pass->uses[j];
+			if (reads_contents(use)) {
+				needed[use->resource] = true;
+			}
+		}
+	}
+}
+
+static void find_lifetimes(vk_render_graph *self)
+{
+	for (Uint32 i = 0; i < self->resource_count; i++) {
+		self->resources[i].first_pass = -1;
+		self->resources[i].last_pass = -1;
+		self->resources[i].usage = 0;
+	}
+	for (Uint32 i = 0; i < self->pass_count; i++) {
+		vk_rg_pass *pass = &self->passes[i];
+		if (!pass->live) {
+			continue;
+		}
+		for (Uint32 j = 0; j < pass->use_count; j++) {
+			vk_rg_use *use = &pass->uses[j];
+			vk_rg_resource *res = &self->resources[use->resource];
+			if (res->first_pass < 0) {
+				res->first_pass = (Sint32)i;
+				if (!res->imported && reads_contents(use)) {
+					fprintf(stderr,
+						"Warning: pass %s reads transient image %s "
+						"before anything writes it\n",
+						pass->name, res->name);
+				}
+			}
+			res->last_pass = (Sint32)i;
+			res->usage |= get_usage_info(use->usage, pass->type).image_usage;
+		}
+	}
+}
+
+// Attachments stay in their attachment layouts through the render pass;
+// barriers outside it do every transition, so passes can be added or
+// culled without touching the others.
+static void create_render_pass(vk_render_graph *self, vk_rg_pass *pass)
+{
+	VkAttachmentDescription attachments[VK_RG_MAX_USES];
+	VkAttachmentReference color_refs[VK_RG_MAX_USES];
+	VkAttachmentReference depth_ref;
+	Uint32 attachment_count = 0;
+	Uint32 color_count = 0;
+	bool has_depth = false;
+
+	for (Uint32 i = 0; i < pass->use_count; i++) {
+		vk_rg_use *use = &pass->uses[i];
+		if (!is_attachment(use)) {
+			continue;
+		}
+		VkImageLayout layout = get_usage_info(use->usage, pass->type).layout;
+
+		VkAttachmentDescription *att = &attachments[attachment_count];
+		memset(att, 0, sizeof(VkAttachmentDescription));
+		att->format = self->resources[use->resource].format;
+		att->samples = VK_SAMPLE_COUNT_1_BIT;
+		att->loadOp = use->load;
+		att->storeOp = use->stored ? VK_ATTACHMENT_STORE_OP_STORE
+					   : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		att->stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		att->stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		att->initialLayout = layout;
+		att->finalLayout = layout;
+
+		if (use->usage == VK_RG_DEPTH_ATTACHMENT) {
+			depth_ref.attachment = attachment_count;
+			depth_ref.layout = layout;
+			has_depth = true;
+		} else {
+			color_refs[color_count].attachment = attachment_count;
+			color_refs[color_count].layout = layout;
+			color_count++;
+		}
+		attachment_count++;
+	}
+
+	VkSubpassDescription subpass;
+	memset(&subpass, 0, sizeof(VkSubpassDescription));
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = color_count;
+	subpass.pColorAttachments = color_refs;
+	subpass.pDepthStencilAttachment = has_depth ? &depth_ref : NULL;
+
+	VkRenderPassCreateInfo rend_pass_ci;
+	memset(&rend_pass_ci, 0, sizeof(VkRenderPassCreateInfo));
+	rend_pass_ci.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	rend_pass_ci.attachmentCount = attachment_count;
+	rend_pass_ci.pAttachments = attachments;
+	rend_pass_ci.subpassCount = 1;
+	rend_pass_ci.pSubpasses = &subpass;
+
+	VkResult result = vkCreateRenderPass(self->log_dev, &rend_pass_ci, NULL,
+					     &pass->render_pass);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error creating render pass %s. err: %s\n", pass->name,
+			string_VkResult(result));
+	}
+}
+
+static bool lifetimes_overlap(const vk_rg_resource *a, const vk_rg_resource *b)
+{
+	return a->first_pass <= b->last_pass && b->first_pass <= a->last_pass;
+}
+
+// Biggest images first, each into the first slot whose images are all dead
+// while it is alive. A slot is one allocation as big as its biggest image.
+static Uint32 assign_slots(vk_render_graph *self, const VkMemoryRequirements *reqs,
+			   VkMemoryRequirements *rslots)
+{
+	Uint32 order[VK_RG_MAX_RESOURCES];
+	Uint32 count = 0;
+	for (Uint32 i = 0; i < self->resource_count; i++) {
+		vk_rg_resource *res = &self->resources[i];
+		if (res->imported || res->first_pass < 0) {
+			continue;
+		}
+		Uint32 j = count++;
+		while (j > 0 && reqs[order[j - 1]].size < reqs[i].size) {
+			order[j] = order[j - 1];
+			j--;
+		}
+		order[j] = i;
+	}
+
+	Uint32 slot_count = 0;
+	for (Uint32 i = 0; i < count; i++) {
+		vk_rg_resource *res = &self->resources[order[i]];
+		const VkMemoryRequirements *req = &reqs[order[i]];
+		Uint32 slot = slot_count;
+		for (Uint32 s = 0; s < slot_count && slot == slot_count; s++) {
+			if ((rslots[s].memoryTypeBits & req->memoryTypeBits) == 0) {
+				continue;
+			}
+			bool fits = true;
+			for (Uint32 j = 0; j < i && fits; j++) {
+				vk_rg_resource *other = &self->resources[order[j]];
+				fits = other->slot != s || !lifetimes_overlap(res, other);
+			}
+			if (fits) {
+				slot = s;
+			}
+		}
+
+		if (slot == slot_count) {
+			rslots[slot_count++] = *req;
+		} else {
+			VkMemoryRequirements *s = &rslots[slot];
+			s->size = req->size > s->size ? req->size : s->size;
+			s->alignment = req->alignment > s->alignment ? req->alignment
+								      : s->alignment;
+			s->memoryTypeBits &= req->memoryTypeBits;
+		}
+		res->slot = slot;
+	}
+	return slot_count;
+}
+
+static void create_transient_images(vk_render_graph *self, vk_rg_targets *targets)
+{
+	VkMemoryRequirements reqs[VK_RG_MAX_RESOURCES];
+	for (Uint32 i = 0; i < self->resource_count; i++) {
+		vk_rg_resource *res = &self->resources[i];
+		if (res->imported || res->first_pass < 0) {
+			continue;
+		}
+		VkExtent2D extent = resource_extent(self, res);
+
+		VkImageCreateInfo image_info;
+		memset(&image_info, 0, sizeof(VkImageCreateInfo));
+		image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		image_info.imageType = VK_IMAGE_TYPE_2D;
+		image_info.format = res->format;
+		image_info.extent.width = extent.width;
+		image_info.extent.height = extent.height;
+		image_info.extent.depth = 1;
+		image_info.mipLevels = 1;
+		image_info.arrayLayers = 1;
+		image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+		image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image_info.usage = res->usage;
+		image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		VkResult result = vkCreateImage(self->log_dev, &image_info, NULL,
+						&targets->images[i]);
+		if (result != VK_SUCCESS) {
+			fprintf(stderr, "Error creating render graph image %s. err: %s\n",
+				res->name, string_VkResult(result));
+		}
+		vkGetImageMemoryRequirements(self->log_dev, targets->images[i], &reqs[i]);
+		res->size = reqs[i].size;
+		self->stats.transient_images++;
+		self->stats.transient_bytes += reqs[i].size;
+	}
+
+	VkMemoryRequirements slots[VK_RG_MAX_RESOURCES];
+	targets->slot_count = assign_slots(self, reqs, slots);
+	for (Uint32 i = 0; i < targets->slot_count; i++) {
+		VkResult result = vk_mem_alloc(self->allocator, &slots[i],
+					       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0,
+					       VK_MEM_KIND_OPTIMAL, false,
+					       &targets->slots[i]);
+		if (result != VK_SUCCESS) {
+			fprintf(stderr, "Error allocating render graph memory. err: %s\n",
+				string_VkResult(result));
+		}
+		self->stats.allocated_bytes += slots[i].size;
+	}
+
+	for (Uint32 i = 0; i < self->resource_count; i++) {
+		vk_rg_resource *res = &self->resources[i];
+		if (targets->images[i] == VK_NULL_HANDLE) {
+			continue;
+		}
+		vk_mem_allocation *slot = &targets->slots[res->slot];
+		VkResult result = vkBindImageMemory(self->log_dev, targets->images[i],
+						    slot->memory, slot->offset);
+		if (result != VK_SUCCESS) {
+			fprintf(stderr, "Error binding render graph image %s. err: %s\n",
+				res->name, string_VkResult(result));
+		}
+
+		VkImageViewCreateInfo iv_creat;
+		memset(&iv_creat, 0, sizeof(VkImageViewCreateInfo));
+		iv_creat.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		iv_creat.image = targets->images[i];
+		iv_creat.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		iv_creat.format = res->format;
+		iv_creat.subresourceRange.aspectMask = format_aspect(res->format);
+		iv_creat.subresourceRange.baseMipLevel = 0;
+		iv_creat.subresourceRange.levelCount = 1;
+		iv_creat.subresourceRange.baseArrayLayer = 0;
+		iv_creat.subresourceRange.layerCount = 1;
+
+		result = vkCreateImageView(self->log_dev, &iv_creat, NULL,
+					   &targets->views[i]);
+		if (result != VK_SUCCESS) {
+			fprintf(stderr, "Error creating render graph view %s. err: %s\n",
+				res->name, string_VkResult(result));
+		}
+	}
+}
+
+// One framebuffer per image of the imported attachments, e.g. per swapchain
+// image. Dynamic rendering only needs the pass extents.
+static void create_framebuffers(vk_render_graph *self, vk_rg_targets *targets)
+{
+	for (Uint32 i = 0; i < self->pass_count; i++) {
+		vk_rg_pass *pass = &self->passes[i];
+		pass->extent = self->extent;
+		if (!pass->live || pass->type != VK_RG_PASS_GRAPHICS) {
+			continue;
+		}
+
+		Uint32 count = 1;
+		bool sized = false;
+		for (Uint32 j = 0; j < pass->use_count; j++) {
+			vk_rg_use *use = &pass->uses[j];
+			vk_rg_resource *res = &self->resources[use->resource];
+			if (!is_attachment(use)) {
+				continue;
+			}
+			if (!sized) {
+				pass->extent = resource_extent(self, res);
+				sized = true;
+			}
+			if (res->imported && res->image_count > count) {
+				count = res->image_count;
+			}
+		}
+		if (self->dynamic_rendering) {
+			continue;
+		}
+
+		targets->framebuffers[i] = malloc(sizeof(VkFramebuffer) * count);
+		targets->framebuffer_counts[i] = count;
+		for (Uint32 j = 0; j < count; j++) {
+			VkImageView attachments[VK_RG_MAX_USES];
+			Uint32 attachment_count = 0;
+			for (Uint32 k = 0; k < pass->use_count; k++) {
+				if (is_attachment(&pass->uses[k])) {
+					attachments[attachment_count++] =
+						resource_view(self, pass->uses[k].resource, j);
+				}
+			}
+
+			VkFramebufferCreateInfo fb_ci;
+			memset(&fb_ci, 0, sizeof(VkFramebufferCreateInfo));
+			fb_ci.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			fb_ci.renderPass = pass->render_pass;
+			fb_ci.attachmentCount = attachment_count;
+			fb_ci.pAttachments = attachments;
+			fb_ci.width = pass->extent.width;
+			fb_ci.height = pass->extent.height;
+			fb_ci.layers = 1;
+			VkResult result = vkCreateFramebuffer(self->log_dev, &fb_ci, NULL,
+							      &targets->framebuffers[i][j]);
+			if (result != VK_SUCCESS) {
+				fprintf(stderr, "Error creating frame buffer for %s. err: %s\n",
+					pass->name, string_VkResult(result));
+			}
+		}
+	}
+}
+
+static void build_targets(vk_render_graph *self)
+{
+	self->targets = malloc(sizeof(vk_rg_targets));
+	memset(self->targets, 0, sizeof(vk_rg_targets));
+	self->targets->log_dev = self->log_dev;
+	self->targets->allocator = self->allocator;
+	self->stats.transient_images = 0;
+	self->stats.transient_bytes = 0;
+	self->stats.allocated_bytes = 0;
+	create_transient_images(self, self->targets);
+	create_framebuffers(self, self->targets);
+}
+
+// What an image has seen since the last barrier that covered it.
+typedef struct {
+	VkImageLayout layout;
+	VkPipelineStageFlags stages; // used in since the last barrier
+	VkAccessFlags writes; // of the last write
+	VkPipelineStageFlags visible; // stages a barrier made the last write visible to
+	bool pending; // a write or transition some stages haven't waited for
+} resource_state;
+
+static void push_barrier(vk_render_graph *self, const vk_rg_barrier *barrier)
+{
+	if (self->barrier_count == self->barrier_cap) {
+		self->barrier_cap = self->barrier_cap ? self->barrier_cap * 2 : 32;
+		self->barriers =
+			realloc(self->barriers, sizeof(vk_rg_barrier) * self->barrier_cap);
+	}
+	self->barriers[self->barrier_count++] = *barrier;
+}
+
+// A barrier goes before a use that changes the layout, writes, or reads in a
+// stage the last write wasn't made visible to. Reads of the same layout
+// share a barrier-free stretch. Only emits barriers with `emit` set, the
+// states are updated either way.
+static void plan(vk_render_graph *self, resource_state *states, bool emit)
+{
+	self->barrier_count = 0;
+	for (Uint32 i = 0; i < self->pass_count; i++) {
+		vk_rg_pass *pass = &self->passes[i];
+		pass->first_barrier = self->barrier_count;
+		pass->barrier_count = 0;
+		pass->src_stages = 0;
+		pass->dst_stages = 0;
+		if (!pass->live) {
+			continue;
+		}
+
+		for (Uint32 j = 0; j < pass->use_count; j++) {
+			vk_rg_use *use = &pass->uses[j];
+			vk_rg_resource *res = &self->resources[use->resource];
+			resource_state *state = &states[use->resource];
+			usage_info info = get_usage_info(use->usage, pass->type);
+
+			bool changed = state->layout != info.layout;
+			if (!changed && info.writes == 0 &&
+			    (!state->pending || (info.stages & ~state->visible) == 0)) {
+				state->stages |= info.stages;
+				continue;
+			}
+
+			// transient images start every frame undefined
+			bool discard = overwrites(use) ||
+				       (!res->imported && res->first_pass == (Sint32)i);
+			if (emit) {
+				vk_rg_barrier barrier;
+				barrier.resource = use->resource;
+				barrier.old_layout = discard ? VK_IMAGE_LAYOUT_UNDEFINED
+							     : state->layout;
+				barrier.new_layout = info.layout;
+				barrier.src_access = state->writes;
+				barrier.dst_access = info.access;
+				push_barrier(self, &barrier);
+				pass->barrier_count++;
+			}
+			pass->src_stages |= state->stages;
+			pass->dst_stages |= info.stages;
+
+			if (info.writes != 0) {
+				state->writes = info.writes;
+				state->visible = 0;
+				state->pending = true;
+			} else {
+				state->visible = changed ? info.stages
+							 : state->visible | info.stages;
+				state->pending = state->pending || changed;
+			}
+			state->layout = info.layout;
+			state->stages = info.stages;
+		}
+	}
+
+	self->first_final = self->barrier_count;
+	self->final_count = 0;
+	self->final_stages = 0;
+	for (Uint32 i = 0; i < self->resource_count; i++) {
+		vk_rg_resource *res = &self->resources[i];
+		resource_state *state = &states[i];
+		if (!res->imported || state->layout == res->final_layout) {
+			continue;
+		}
+		if (emit) {
+			vk_rg_barrier barrier;
+			barrier.resource = i;
+			barrier.old_layout = state->layout;
+			barrier.new_layout = res->final_layout;
+			barrier.src_access = state->writes;
+			// see vk_render_graph_execute
+			barrier.dst_access = VK_ACCESS_TRANSFER_READ_BIT;
+			push_barrier(self, &barrier);
+			self->final_count++;
+		}
+		self->final_stages |= state->stages;
+	}
+}
+
+// The transient image using a slot's memory before `resource` does, in this
+// frame or, for the first one, in the previous frame.
+static Uint32 slot_predecessor(vk_render_graph *self, Uint32 resource)
+{
+	vk_rg_resource *res = &self->resources[resource];
+	Sint32 before = -1;
+	Sint32 last = -1;
+	for (Uint32 i = 0; i < self->resource_count; i++) {
+		vk_rg_resource *other = &self->resources[i];
+		if (other->imported || other->first_pass < 0 || other->slot != res->slot) {
+			continue;
+		}
+		bool earlier = other->first_pass < res->first_pass;
+		if (earlier &&
+		    (before < 0 || other->first_pass > self->resources[before].first_pass)) {
+			before = (Sint32)i;
+		}
+		if (last < 0 || other->first_pass > self->resources[last].first_pass) {
+			last = (Sint32)i;
+		}
+	}
+	return (Uint32)(before >= 0 ? before : last);
+}
+
+static void init_states(vk_render_graph *self, resource_state *states,
+			const resource_state *finals)
+{
+	memset(states, 0, sizeof(resource_state) * VK_RG_MAX_RESOURCES);
+	for (Uint32 i = 0; i < self->resource_count; i++) {
+		vk_rg_resource *res = &self->resources[i];
+		resource_state *state = &states[i];
+		if (res->imported) {
+			state->layout = res->initial_layout;
+			state->stages = res->initial_stages;
+		} else if (finals != NULL && res->first_pass >= 0) {
+			// wait for the last use of whatever had the memory before
+			const resource_state *prev = &finals[slot_predecessor(self, i)];
+			state->layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			state->stages = prev->stages;
+			state->writes = prev->writes;
+		} else {
+			state->layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		}
+	}
+}
+
+// The first use of every transient image transitions it from undefined, so
+// how each one ends the frame doesn't depend on how it starts: a dry run
+// finds that, then the real one waits on it where memory is shared.
+static void plan_barriers(vk_render_graph *self)
+{
+	resource_state finals[VK_RG_MAX_RESOURCES];
+	init_states(self, finals, NULL);
+	plan(self, finals, false);
+
+	resource_state states[VK_RG_MAX_RESOURCES];
+	init_states(self, states, finals);
+	plan(self, states, true);
+	self->stats.barriers = self->barrier_count;
+}
+
+bool vk_render_graph_compile(vk_render_graph *self, VkExtent2D extent)
+{
+	for (Uint32 i = 0; i < self->resource_count; i++) {
+		vk_rg_resource *res = &self->resources[i];
+		if (res->imported && res->image_count == 0) {
+			fprintf(stderr, "Error: render graph image %s was never bound\n",
+				res->name);
+			return false;
+		}
+	}
+
+	cull_passes(self);
+	find_lifetimes(self);
+	self->stats.passes = self->pass_count;
+	self->stats.culled_passes = 0;
+	for (Uint32 i = 0; i < self->pass_count; i++) {
+		vk_rg_pass *pass = &self->passes[i];
+		if (!pass->live) {
+			self->stats.culled_passes++;
+		} else if (pass->type == VK_RG_PASS_GRAPHICS &&
+			   !self->dynamic_rendering) {
+			create_render_pass(self, pass);
+		}
+	}
+
+	self->extent = extent;
+	build_targets(self);
+	plan_barriers(self);
+	self->compiled = true;
+	return true;
+}
+
+void vk_render_graph_resize(vk_render_graph *self, VkExtent2D extent,
+			    vk_deletion_queue *deletions, Uint64 frame)
+{
+	vk_deletion_queue_push(deletions,
+			       &(vk_deletion){ .type = VK_DELETE_CALLBACK,
+					       .frame = frame,
+					       .callback = { destroy_targets, self->targets,
+							     0 } });
+	self->extent = extent;
+	build_targets(self);
+	// slots are assigned by size, which may have changed order
+	plan_barriers(self);
+}
+
+static void record_barriers(vk_render_graph *self, VkCommandBuffer cmd, Uint32 first,
+			    Uint32 count, VkPipelineStageFlags src_stages,
+			    VkPipelineStageFlags dst_stages, Uint32 image_idx)
+{
+	if (count == 0) {
+		return;
+	}
+
+	VkImageMemoryBarrier barriers[count];
+	for (Uint32 i = 0; i < count; i++) {
+		const vk_rg_barrier *planned = &self->barriers[first + i];
+		VkImageMemoryBarrier *barrier = &barriers[i];
+		memset(barrier, 0, sizeof(VkImageMemoryBarrier));
+		barrier->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier->srcAccessMask = planned->src_access;
+		barrier->dstAccessMask = planned->dst_access;
+		barrier->oldLayout = planned->old_layout;
+		barrier->newLayout = planned->new_layout;
+		barrier->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier->image = resource_image(self, planned->resource, image_idx);
+		barrier->subresourceRange.aspectMask =
+			format_aspect(self->resources[planned->resource].format);
+		barrier->subresourceRange.baseMipLevel = 0;
+		barrier->subresourceRange.levelCount = 1;
+		barrier->subresourceRange.baseArrayLayer = 0;
+		barrier->subresourceRange.layerCount = 1;
+	}
+
+	vkCmdPipelineBarrier(cmd,
+			     src_stages != 0 ? src_stages
+					     : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			     dst_stages, 0, 0, NULL, 0, NULL, count, barriers);
+}
+
+void vk_render_graph_execute(vk_render_graph *self, VkCommandBuffer cmd,
+			     Uint32 image_idx, void *frame)
+{
+	for (Uint32 i = 0; i < self->pass_count; i++) {
+		vk_rg_pass *pass = &self->passes[i];
+		if (!pass->live) {
+			continue;
+		}
+		record_barriers(self, cmd, pass->first_barrier, pass->barrier_count,
+				pass->src_stages, pass->dst_stages, image_idx);
+
+		vk_rg_context ctx = { .graph = self,
+				      .pass = i,
+				      .cmd = cmd,
+				      .image_idx = image_idx,
+				      .extent = pass->extent,
+				      .frame = frame };
+		pass->fn(pass->data, &ctx);
+	}
+
+	// presenting or handing the image on is ordered by semaphores; copies
+	// recorded after the graph in the same submit, like a frame capture,
+	// chain their own barriers to the transfer stage
+	record_barriers(self, cmd, self->first_final, self->final_count,
+			self->final_stages, VK_PIPELINE_STAGE_TRANSFER_BIT, image_idx);
+}
+
+// The one scan of a pass's attachments for dynamic rendering, so the color
+// order of vkCmdBeginRendering and of the inheritance info can't differ.
+// Returns the color count; `rdepth` is NULL without a depth attachment.
+static Uint32 pass_attachments(vk_rg_pass *pass, const vk_rg_use **rcolors,
+			       const vk_rg_use **rdepth)
+{
+	Uint32 color_count = 0;
+	*rdepth = NULL;
+	for (Uint32 i = 0; i < pass->use_count; i++) {
+		vk_rg_use *use = &pass->uses[i];
+		if (use->usage == VK_RG_COLOR_ATTACHMENT) {
+			rcolors[color_count++] = use;
+		} else if (use->usage == VK_RG_DEPTH_ATTACHMENT) {
+			*rdepth = use;
+		}
+	}
+	return color_count;
+}
+
+static void rendering_attachment(vk_render_graph *self, vk_rg_pass *pass,
+				 const vk_rg_use *use, Uint32 image_idx,
+				 VkRenderingAttachmentInfo *att)
+{
+	memset(att, 0, sizeof(VkRenderingAttachmentInfo));
+	att->sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+	att->imageView = resource_view(self, use->resource, image_idx);
+	att->imageLayout = get_usage_info(use->usage, pass->type).layout;
+	att->resolveMode = VK_RESOLVE_MODE_NONE;
+	att->loadOp = use->load;
+	att->storeOp = use->stored ? VK_ATTACHMENT_STORE_OP_STORE
+				   : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	att->clearValue = use->clear;
+}
+
+// Attachments are already in their layouts, the barriers before the pass
+// moved them there.
+static void begin_rendering(const vk_rg_context *ctx, VkSubpassContents contents)
+{
+	vk_render_graph *self = ctx->graph;
+	vk_rg_pass *pass = &self->passes[ctx->pass];
+
+	const vk_rg_use *color_uses[VK_RG_MAX_USES];
+	const vk_rg_use *depth_use;
+	Uint32 color_count = pass_attachments(pass, color_uses, &depth_use);
+
+	VkRenderingAttachmentInfo colors[VK_RG_MAX_USES];
+	VkRenderingAttachmentInfo depth;
+	for (Uint32 i = 0; i < color_count; i++) {
+		rendering_attachment(self, pass, color_uses[i], ctx->image_idx,
+				     &colors[i]);
+	}
+	if (depth_use != NULL) {
+		rendering_attachment(self, pass, depth_use, ctx->image_idx, &depth);
+	}
+
+	VkRenderingInfo rendering_info;
+	memset(&rendering_info, 0, sizeof(VkRenderingInfo));
+	rendering_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+	bool secondary = contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS;
+	rendering_info.flags =
+		secondary ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0;
+	rendering_info.renderArea.extent = pass->extent;
+	rendering_info.renderArea.offset.x = 0;
+	rendering_info.renderArea.offset.y = 0;
+	rendering_info.layerCount = 1;
+	rendering_info.colorAttachmentCount = color_count;
+	rendering_info.pColorAttachments = colors;
+	rendering_info.pDepthAttachment = depth_use != NULL ? &depth : NULL;
+
+	vkCmdBeginRendering(ctx->cmd, &rendering_info);
+}
+
+void vk_render_graph_begin_pass(const vk_rg_context *ctx, VkSubpassContents contents)
+{
+	vk_render_graph *self = ctx->graph;
+	vk_rg_pass *pass = &self->passes[ctx->pass];
+	if (self->dynamic_rendering) {
+		begin_rendering(ctx, contents);
+		return;
+	}
+
+	VkClearValue clears[VK_RG_MAX_USES];
+	Uint32 clear_count = 0;
+	for (Uint32 i = 0; i < pass->use_count; i++) {
+		if (is_attachment(&pass->uses[i])) {
+			clears[clear_count++] = pass->uses[i].clear;
+		}
+	}
+
+	VkRenderPassBeginInfo rend_info;
+	memset(&rend_info, 0, sizeof(VkRenderPassBeginInfo));
+	rend_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	rend_info.renderPass = pass->render_pass;
+	rend_info.framebuffer =
+		vk_render_graph_framebuffer(self, ctx->pass, ctx->image_idx);
+	rend_info.renderArea.extent = pass->extent;
+	rend_info.renderArea.offset.x = 0;
+	rend_info.renderArea.offset.y = 0;
+	rend_info.clearValueCount = clear_count;
+	rend_info.pClearValues = clears;
+
+	vkCmdBeginRenderPass(ctx->cmd, &rend_info, contents);
+}
+
+void vk_render_graph_end_pass(const vk_rg_context *ctx)
+{
+	if (ctx->graph->dynamic_rendering) {
+		vkCmdEndRendering(ctx->cmd);
+	} else {
+		vkCmdEndRenderPass(ctx->cmd);
+	}
+}
+
+VkRenderPass vk_render_graph_render_pass(vk_render_graph *self, Uint32 pass)
+{
+	return self->passes[pass].render_pass;
+}
+
+VkFramebuffer vk_render_graph_framebuffer(vk_render_graph *self, Uint32 pass,
+					  Uint32 image_idx)
+{
+	Uint32 count = self->targets->framebuffer_counts[pass];
+	if (count == 0) {
+		return VK_NULL_HANDLE;
+	}
+	return self->targets->framebuffers[pass][image_idx % count];
+}
+
+void vk_render_graph_inheritance(vk_render_graph *self, Uint32 pass, Uint32 image_idx,
+				 vk_rg_inheritance *rinherit)
+{
+	vk_rg_pass *p = &self->passes[pass];
+	memset(rinherit, 0, sizeof(vk_rg_inheritance));
+	rinherit->info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	if (!self->dynamic_rendering) {
+		rinherit->info.renderPass = p->render_pass;
+		rinherit->info.subpass = 0;
+		rinherit->info.framebuffer =
+			vk_render_graph_framebuffer(self, pass, image_idx);
+		return;
+	}
+
+	const vk_rg_use *color_uses[VK_RG_MAX_USES];
+	const vk_rg_use *depth_use;
+	Uint32 color_count = pass_attachments(p, color_uses, &depth_use);
+
+	VkCommandBufferInheritanceRenderingInfo *rendering = &rinherit->rendering;
+	rendering->sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+	// begin_rendering's flags minus the secondary contents bit, which is
+	// not allowed here
+	rendering->flags = 0;
+	rendering->rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+	for (Uint32 i = 0; i < color_count; i++) {
+		vk_rg_resource *res = &self->resources[color_uses[i]->resource];
+		rinherit->color_formats[i] = res->format;
+	}
+	rendering->colorAttachmentCount = color_count;
+	rendering->pColorAttachmentFormats = rinherit->color_formats;
+	if (depth_use != NULL) {
+		vk_rg_resource *res = &self->resources[depth_use->resource];
+		rendering->depthAttachmentFormat = res->format;
+	}
+	rinherit->info.pNext = rendering;
+}
+
+void vk_render_graph_get_stats(vk_render_graph *self, vk_rg_stats *rstats)
+{
+	*rstats = self->stats;
+}
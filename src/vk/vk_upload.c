@@ -0,0 +1,520 @@
+#include "vk/vk_upload.h"
+#include <vulkan/vk_enum_string_helper.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static Uint64 align_up(Uint64 value, Uint64 alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static void batch_retire(vk_upload_ring *self, vk_upload_batch *batch)
+{
+	batch->pending = false;
+	self->tail = batch->ring_end;
+	self->completed_serial = batch->serial;
+}
+
+// Batches are submitted round robin, so walking from the slot being filled
+// visits them oldest first. Stop at the first unfinished one so the tail never
+// jumps over staging space that is still being read.
+static void poll_batches(vk_upload_ring *self)
+{
+	for (Uint32 i = 0; i < VK_UPLOAD_MAX_BATCHES; i++) {
+		vk_upload_batch *batch =
+			&self->batches[(self->batch_idx + i) % VK_UPLOAD_MAX_BATCHES];
+		if (!batch->pending) {
+			continue;
+		}
+		if (vkGetFenceStatus(self->log_dev, batch->fence) != VK_SUCCESS) {
+			return;
+		}
+		batch_retire(self, batch);
+	}
+}
+
+static bool wait_oldest_batch(vk_upload_ring *self)
+{
+	for (Uint32 i = 0; i < VK_UPLOAD_MAX_BATCHES; i++) {
+		vk_upload_batch *batch =
+			&self->batches[(self->batch_idx + i) % VK_UPLOAD_MAX_BATCHES];
+		if (batch->pending) {
+			vkWaitForFences(self->log_dev, 1, &batch->fence, VK_TRUE,
+					UINT64_MAX);
+			batch_retire(self, batch);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void ring_reserve(vk_upload_ring *self, VkDeviceSize size, VkDeviceSize *roffset)
+{
+	for (;;) {
+		// nothing queued or in flight: start over at the front of the
+		// ring, so an empty ring always fits a reservation
+		if (self->head == self->tail) {
+			self->tail -= self->tail % self->size;
+			self->head = self->tail;
+		}
+		Uint64 head = align_up(self->head, self->alignment);
+		VkDeviceSize pos = head % self->size;
+		// allocations never straddle the end of the ring
+		if (pos + size > self->size) {
+			head += self->size - pos;
+			pos = 0;
+		}
+		if (head + size - self->tail <= self->size) {
+			self->head = head + size;
+			*roffset = pos;
+			return;
+		}
+
+		// the ring is full: reclaim the oldest batch, or submit the one
+		// being filled when it alone is holding all the space
+		poll_batches(self);
+		if (head + size - self->tail <= self->size) {
+			continue;
+		}
+		if (!wait_oldest_batch(self)) {
+			vk_upload_flush(self);
+		}
+	}
+}
+
+static void push_buffer_copy(vk_upload_ring *self, VkBuffer dst, VkBufferCopy *region)
+{
+	if (self->buffer_copy_count == self->buffer_copy_cap) {
+		self->buffer_copy_cap = self->buffer_copy_cap ? self->buffer_copy_cap * 2 : 64;
+		self->buffer_copies =
+			realloc(self->buffer_copies,
+				sizeof(vk_upload_buffer_copy) * self->buffer_copy_cap);
+	}
+
+	vk_upload_buffer_copy *copy = &self->buffer_copies[self->buffer_copy_count++];
+	copy->dst = dst;
+	copy->region = *region;
+	copy->order = self->buffer_copy_count - 1;
+}
+
+static void push_image_copy(vk_upload_ring *self, VkImage dst, VkImageLayout layout,
+			    VkBufferImageCopy *region, bool first)
+{
+	if (self->image_copy_count == self->image_copy_cap) {
+		self->image_copy_cap = self->image_copy_cap ? self->image_copy_cap * 2 : 16;
+		self->image_copies =
+			realloc(self->image_copies,
+				sizeof(vk_upload_image_copy) * self->image_copy_cap);
+	}
+
+	// chunks after the first keep the layout the image already has; only the
+	// first chunk of an image in a batch records the transitions
+	bool continued = self->image_copy_count > 0 &&
+			 self->image_copies[self->image_copy_count - 1].dst == dst;
+	vk_upload_image_copy *copy = &self->image_copies[self->image_copy_count++];
+	copy->dst = dst;
+	copy->old_layout = first ? VK_IMAGE_LAYOUT_UNDEFINED : layout;
+	copy->final_layout = layout;
+	copy->region = *region;
+	copy->barrier = !continued;
+}
+
+void vk_upload_ring_init(vk_upload_ring *self, vk_mem_allocator *allocator,
+			 VkPhysicalDevice phy_dev, VkDevice log_dev, VkQueue queue,
+			 Uint32 queue_family)
+{
+	memset(self, 0, sizeof(vk_upload_ring));
+	self->log_dev = log_dev;
+	self->queue = queue;
+	self->allocator = allocator;
+	self->size = VK_UPLOAD_RING_SIZE;
+	self->next_serial = 1;
+
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(phy_dev, &props);
+	self->alignment = props.limits.optimalBufferCopyOffsetAlignment;
+	if (self->alignment < 16) {
+		self->alignment = 16;
+	}
+
+	VkBufferCreateInfo buf_info;
+	memset(&buf_info, 0, sizeof(VkBufferCreateInfo));
+	buf_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buf_info.size = self->size;
+	buf_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	buf_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VkResult result = vk_mem_create_buffer(
+		allocator, &buf_info,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		0, &self->staging, &self->staging_alloc);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error creating upload staging ring, err: %s\n",
+			string_VkResult(result));
+	}
+
+	VkCommandPoolCreateInfo cp_ci;
+	memset(&cp_ci, 0, sizeof(VkCommandPoolCreateInfo));
+	cp_ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	cp_ci.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT |
+		      VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	cp_ci.queueFamilyIndex = queue_family;
+
+	result = vkCreateCommandPool(log_dev, &cp_ci, NULL, &self->command_pool);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error creating upload command pool, err: %s\n",
+			string_VkResult(result));
+	}
+
+	VkCommandBuffer cmds[VK_UPLOAD_MAX_BATCHES];
+	VkCommandBufferAllocateInfo buf_alloc;
+	memset(&buf_alloc, 0, sizeof(VkCommandBufferAllocateInfo));
+	buf_alloc.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	buf_alloc.commandPool = self->command_pool;
+	buf_alloc.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	buf_alloc.commandBufferCount = VK_UPLOAD_MAX_BATCHES;
+
+	result = vkAllocateCommandBuffers(log_dev, &buf_alloc, cmds);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error allocating upload command buffers, err: %s\n",
+			string_VkResult(result));
+	}
+
+	VkFenceCreateInfo fen_info;
+	memset(&fen_info, 0, sizeof(VkFenceCreateInfo));
+	fen_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	for (Uint32 i = 0; i < VK_UPLOAD_MAX_BATCHES; i++) {
+		self->batches[i].cmd = cmds[i];
+		if (vkCreateFence(log_dev, &fen_info, NULL, &self->batches[i].fence) !=
+		    VK_SUCCESS) {
+			fprintf(stderr, "Error creating upload fence\n");
+		}
+	}
+}
+
+void vk_upload_ring_destroy(vk_upload_ring *self)
+{
+	while (wait_oldest_batch(self))
+		;
+
+	for (Uint32 i = 0; i < VK_UPLOAD_MAX_BATCHES; i++) {
+		vkDestroyFence(self->log_dev, self->batches[i].fence, NULL);
+	}
+	vkDestroyCommandPool(self->log_dev, self->command_pool, NULL);
+	vk_mem_destroy_buffer(self->allocator, self->staging, &self->staging_alloc);
+	free(self->buffer_copies);
+	free(self->image_copies);
+}
+
+Uint64 vk_upload_buffer(vk_upload_ring *self, VkBuffer dst, VkDeviceSize dst_offset,
+			const void *data, VkDeviceSize size)
+{
+	const char *src = data;
+	// big uploads are streamed in halves of the ring so they never need
+	// the whole ring to be idle at once
+	VkDeviceSize chunk_max = self->size / 2;
+
+	while (size > 0) {
+		VkDeviceSize chunk = size < chunk_max ? size : chunk_max;
+		VkDeviceSize offset;
+		ring_reserve(self, chunk, &offset);
+		memcpy((char *)self->staging_alloc.mapped + offset, src, chunk);
+
+		VkBufferCopy region = {
+			.srcOffset = offset,
+			.dstOffset = dst_offset,
+			.size = chunk,
+		};
+		push_buffer_copy(self, dst, &region);
+
+		src += chunk;
+		dst_offset += chunk;
+		size -= chunk;
+	}
+
+	return self->next_serial;
+}
+
+Uint64 vk_upload_image(vk_upload_ring *self, VkImage dst, VkImageAspectFlags aspect,
+		       VkExtent3D extent, VkImageLayout final_layout, const void *data,
+		       VkDeviceSize size)
+{
+	// streamed in runs of whole rows, each at most half the ring like
+	// buffer chunks; rows never span depth slices
+	VkDeviceSize row_size = size / ((VkDeviceSize)extent.height * extent.depth);
+	VkDeviceSize chunk_max = self->size / 2;
+	if (row_size == 0 || row_size > chunk_max) {
+		fprintf(stderr, "Image upload with %llu byte rows exceeds the staging ring\n",
+			(unsigned long long)row_size);
+		return 0;
+	}
+	Uint32 rows_max = (Uint32)(chunk_max / row_size);
+
+	const char *src = data;
+	bool first = true;
+	for (Uint32 z = 0; z < extent.depth; z++) {
+		for (Uint32 y = 0; y < extent.height;) {
+			Uint32 rows = extent.height - y;
+			if (rows > rows_max) {
+				rows = rows_max;
+			}
+			VkDeviceSize chunk = row_size * rows;
+			VkDeviceSize offset;
+			ring_reserve(self, chunk, &offset);
+			memcpy((char *)self->staging_alloc.mapped + offset, src, chunk);
+
+			VkBufferImageCopy region;
+			memset(&region, 0, sizeof(VkBufferImageCopy));
+			region.bufferOffset = offset;
+			region.imageSubresource.aspectMask = aspect;
+			region.imageSubresource.mipLevel = 0;
+			region.imageSubresource.baseArrayLayer = 0;
+			region.imageSubresource.layerCount = 1;
+			region.imageOffset = (VkOffset3D){ 0, (Sint32)y, (Sint32)z };
+			region.imageExtent = (VkExtent3D){ extent.width, rows, 1 };
+			push_image_copy(self, dst, final_layout, &region, first);
+
+			first = false;
+			src += chunk;
+			y += rows;
+		}
+	}
+
+	return self->next_serial;
+}
+
+static int compare_buffer_copy(const void *a, const void *b)
+{
+	const vk_upload_buffer_copy *ca = a;
+	const vk_upload_buffer_copy *cb = b;
+	if (ca->dst != cb->dst) {
+		return ca->dst < cb->dst ? -1 : 1;
+	}
+	// qsort isn't stable, the queue order is the tie break
+	return ca->order < cb->order ? -1 : ca->order > cb->order;
+}
+
+static bool regions_overlap(const VkBufferCopy *a, const VkBufferCopy *b)
+{
+	return a->dstOffset < b->dstOffset + b->size &&
+	       b->dstOffset < a->dstOffset + a->size;
+}
+
+// Regions of one vkCmdCopyBuffer must not overlap. Most batches are written
+// front to back, so the bounds usually settle it without a scan.
+static bool batch_overlaps(const VkBufferCopy *regions, Uint32 count,
+			   VkDeviceSize lo, VkDeviceSize hi, const VkBufferCopy *region)
+{
+	if (count == 0 || region->dstOffset >= hi ||
+	    region->dstOffset + region->size <= lo) {
+		return false;
+	}
+	for (Uint32 i = 0; i < count; i++) {
+		if (regions_overlap(&regions[i], region)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void transfer_barrier(VkCommandBuffer cmd)
+{
+	VkMemoryBarrier barrier;
+	memset(&barrier, 0, sizeof(VkMemoryBarrier));
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			     VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, NULL, 0,
+			     NULL);
+}
+
+static void record_image_barriers(vk_upload_ring *self, VkCommandBuffer cmd,
+				  bool before_copy)
+{
+	if (self->image_copy_count == 0) {
+		return;
+	}
+
+	VkImageMemoryBarrier *barriers =
+		malloc(sizeof(VkImageMemoryBarrier) * self->image_copy_count);
+	Uint32 count = 0;
+	for (Uint32 i = 0; i < self->image_copy_count; i++) {
+		vk_upload_image_copy *copy = &self->image_copies[i];
+		if (!copy->barrier) {
+			continue;
+		}
+		VkImageMemoryBarrier *barrier = &barriers[count++];
+		memset(barrier, 0, sizeof(VkImageMemoryBarrier));
+		barrier->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier->image = copy->dst;
+		barrier->subresourceRange.aspectMask =
+			copy->region.imageSubresource.aspectMask;
+		barrier->subresourceRange.baseMipLevel = 0;
+		barrier->subresourceRange.levelCount = 1;
+		barrier->subresourceRange.baseArrayLayer = 0;
+		barrier->subresourceRange.layerCount = 1;
+		if (before_copy) {
+			barrier->srcAccessMask = 0;
+			barrier->dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier->oldLayout = copy->old_layout;
+			barrier->newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		} else {
+			barrier->srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier->dstAccessMask =
+				VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+			barrier->oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier->newLayout = copy->final_layout;
+		}
+	}
+
+	if (before_copy) {
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+				     VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL,
+				     count, barriers);
+	} else {
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				     VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, NULL, 0,
+				     NULL, count, barriers);
+	}
+
+	free(barriers);
+}
+
+static void record_buffer_copies(vk_upload_ring *self, VkCommandBuffer cmd)
+{
+	if (self->buffer_copy_count == 0) {
+		return;
+	}
+
+	// destinations may still be read by frames submitted earlier (reused
+	// mesh ranges, rewritten object records), so the copies wait for them
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			     VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 0,
+			     NULL);
+
+	// one vkCmdCopyBuffer per destination, carrying all of its regions in
+	// queue order, split where a region rewrites bytes already in the batch
+	qsort(self->buffer_copies, self->buffer_copy_count,
+	      sizeof(vk_upload_buffer_copy), compare_buffer_copy);
+
+	VkBufferCopy *regions = malloc(sizeof(VkBufferCopy) * self->buffer_copy_count);
+	Uint32 start = 0;
+	while (start < self->buffer_copy_count) {
+		VkBuffer dst = self->buffer_copies[start].dst;
+		Uint32 count = 0;
+		VkDeviceSize lo = 0;
+		VkDeviceSize hi = 0;
+		while (start < self->buffer_copy_count &&
+		       self->buffer_copies[start].dst == dst) {
+			VkBufferCopy *region = &self->buffer_copies[start].region;
+			if (batch_overlaps(regions, count, lo, hi, region)) {
+				// the older write has to land first
+				vkCmdCopyBuffer(cmd, self->staging, dst, count, regions);
+				transfer_barrier(cmd);
+				count = 0;
+			}
+			if (count == 0 || region->dstOffset < lo) {
+				lo = region->dstOffset;
+			}
+			if (count == 0 || region->dstOffset + region->size > hi) {
+				hi = region->dstOffset + region->size;
+			}
+			regions[count++] = *region;
+			start++;
+		}
+		vkCmdCopyBuffer(cmd, self->staging, dst, count, regions);
+	}
+	free(regions);
+
+	VkMemoryBarrier barrier;
+	memset(&barrier, 0, sizeof(VkMemoryBarrier));
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			     VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, NULL,
+			     0, NULL);
+}
+
+void vk_upload_flush(vk_upload_ring *self)
+{
+	poll_batches(self);
+	if (self->buffer_copy_count == 0 && self->image_copy_count == 0) {
+		return;
+	}
+
+	vk_upload_batch *batch = &self->batches[self->batch_idx];
+	if (batch->pending) {
+		vkWaitForFences(self->log_dev, 1, &batch->fence, VK_TRUE, UINT64_MAX);
+		batch_retire(self, batch);
+	}
+	vkResetFences(self->log_dev, 1, &batch->fence);
+	vkResetCommandBuffer(batch->cmd, 0);
+
+	VkCommandBufferBeginInfo begin_info;
+	memset(&begin_info, 0, sizeof(VkCommandBufferBeginInfo));
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	VkResult result = vkBeginCommandBuffer(batch->cmd, &begin_info);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error begin upload command buffer, err: %s\n",
+			string_VkResult(result));
+	}
+
+	record_image_barriers(self, batch->cmd, true);
+	record_buffer_copies(self, batch->cmd);
+	for (Uint32 i = 0; i < self->image_copy_count; i++) {
+		vk_upload_image_copy *copy = &self->image_copies[i];
+		vkCmdCopyBufferToImage(batch->cmd, self->staging, copy->dst,
+				       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+				       &copy->region);
+	}
+	record_image_barriers(self, batch->cmd, false);
+
+	result = vkEndCommandBuffer(batch->cmd);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error recording upload command buffer, err: %s\n",
+			string_VkResult(result));
+	}
+
+	VkSubmitInfo submit_info;
+	memset(&submit_info, 0, sizeof(VkSubmitInfo));
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &batch->cmd;
+
+	result = vkQueueSubmit(self->queue, 1, &submit_info, batch->fence);
+	if (result != VK_SUCCESS) {
+		fprintf(stderr, "Error submitting uploads, err: %s\n",
+			string_VkResult(result));
+	}
+
+	batch->serial = self->next_serial++;
+	batch->ring_end = self->head;
+	batch->pending = true;
+	self->batch_idx = (self->batch_idx + 1) % VK_UPLOAD_MAX_BATCHES;
+	self->buffer_copy_count = 0;
+	self->image_copy_count = 0;
+}
+
+bool vk_upload_is_complete(vk_upload_ring *self, Uint64 serial)
+{
+	poll_batches(self);
+	return serial <= self->completed_serial;
+}
+
+void vk_upload_wait(vk_upload_ring *self, Uint64 serial)
+{
+	if (serial >= self->next_serial) {
+		vk_upload_flush(self);
+	}
+	while (self->completed_serial < serial && wait_oldest_batch(self))
+		;
+}
@@ -0,0 +1,128 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "asset_pack.h"
+
+// Builds an asset pack: pack <output> <file>...
+// Each file is stored under the path it was given on the command line.
+
+typedef struct {
+	const char *path;
+	asset_pack_entry entry;
+} pack_item;
+
+static asset_type type_from_path(const char *path)
+{
+	const char *ext = strrchr(path, '.');
+	if (ext == NULL) {
+		return ASSET_TYPE_RAW;
+	}
+	if (strcmp(ext, ".spv") == 0) {
+		return ASSET_TYPE_SPIRV;
+	}
+	if (strcmp(ext, ".mesh") == 0) {
+		return ASSET_TYPE_MESH;
+	}
+	if (strcmp(ext, ".png") == 0 || strcmp(ext, ".ktx") == 0 ||
+	    strcmp(ext, ".ktx2") == 0) {
+		return ASSET_TYPE_TEXTURE;
+	}
+	return ASSET_TYPE_RAW;
+}
+
+static int compare_item(const void *a, const void *b)
+{
+	const pack_item *ia = a;
+	const pack_item *ib = b;
+	if (ia->entry.hash == ib->entry.hash) {
+		return 0;
+	}
+	return ia->entry.hash < ib->entry.hash ? -1 : 1;
+}
+
+static bool write_padding(FILE *out, Uint64 *offset, Uint64 alignment)
+{
+	static const Uint8 zeros[ASSET_PACK_ALIGN] = { 0 };
+	Uint64 pad = (alignment - *offset % alignment) % alignment;
+	*offset += pad;
+	return pad == 0 || fwrite(zeros, pad, 1, out) == 1;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <output> <file>...\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	const char *output = argv[1];
+	Uint32 count = argc - 2;
+	pack_item *items = calloc(count ? count : 1, sizeof(pack_item));
+	for (Uint32 i = 0; i < count; i++) {
+		items[i].path = argv[i + 2];
+		items[i].entry.hash = asset_pack_hash(items[i].path);
+		items[i].entry.type = type_from_path(items[i].path);
+	}
+
+	qsort(items, count, sizeof(pack_item), compare_item);
+	for (Uint32 i = 1; i < count; i++) {
+		if (items[i].entry.hash == items[i - 1].entry.hash) {
+			fprintf(stderr, "Hash collision between %s and %s\n",
+				items[i - 1].path, items[i].path);
+			return EXIT_FAILURE;
+		}
+	}
+
+	char tmp_path[strlen(output) + 5];
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", output);
+	FILE *out = fopen(tmp_path, "wb");
+	if (out == NULL) {
+		fprintf(stderr, "Error opening %s for writing\n", tmp_path);
+		return EXIT_FAILURE;
+	}
+
+	asset_pack_header header;
+	memset(&header, 0, sizeof(asset_pack_header));
+	bool ok = fwrite(&header, sizeof(asset_pack_header), 1, out) == 1;
+	Uint64 offset = sizeof(asset_pack_header);
+
+	for (Uint32 i = 0; i < count && ok; i++) {
+		loaded_file lf = read_file(items[i].path);
+		if (lf.buf == NULL) {
+			ok = false;
+			break;
+		}
+		ok = write_padding(out, &offset, ASSET_PACK_ALIGN);
+		items[i].entry.offset = offset;
+		items[i].entry.size = lf.size;
+		ok = ok && (lf.size == 0 || fwrite(lf.buf, lf.size, 1, out) == 1);
+		offset += lf.size;
+		loaded_file_destroy(&lf);
+	}
+
+	ok = ok && write_padding(out, &offset, sizeof(Uint64));
+	header.magic = ASSET_PACK_MAGIC;
+	header.version = ASSET_PACK_VERSION;
+	header.entry_count = count;
+	header.toc_offset = offset;
+	for (Uint32 i = 0; i < count && ok; i++) {
+		ok = fwrite(&items[i].entry, sizeof(asset_pack_entry), 1, out) == 1;
+		offset += sizeof(asset_pack_entry);
+	}
+	header.file_size = offset;
+
+	ok = ok && fseek(out, 0, SEEK_SET) == 0;
+	ok = ok && fwrite(&header, sizeof(asset_pack_header), 1, out) == 1;
+	ok = fclose(out) == 0 && ok;
+	if (!ok || rename(tmp_path, output) != 0) {
+		fprintf(stderr, "Error writing asset pack %s\n", output);
+		remove(tmp_path);
+		return EXIT_FAILURE;
+	}
+
+	printf("Packed %u assets into %s (%llu bytes)\n", count, output,
+	       (unsigned long long)offset);
+	free(items);
+	return EXIT_SUCCESS;
+}